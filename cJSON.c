@@ -560,6 +560,9 @@ static cJSON_bool compare_double(double a, double b)
     return (fabs(a - b) <= maxVal * DBL_EPSILON);
 }
 
+/* Shortest decimal text that reads back to exactly d, NUL-terminated (zhaoba_config_number.c). */
+int config_format_double(double d, char* buffer);
+
 /* Render the number nicely from the given item into a string. */
 static cJSON_bool print_number(const cJSON* const item, printbuffer* const output_buffer)
 {
@@ -567,9 +570,8 @@ static cJSON_bool print_number(const cJSON* const item, printbuffer* const outpu
     double d = item->valuedouble;
     int length = 0;
     size_t i = 0;
-    unsigned char number_buffer[26] = { 0 }; /* temporary buffer to print the number into */
+    unsigned char number_buffer[32] = { 0 }; /* temporary buffer to print the number into */
     unsigned char decimal_point = get_decimal_point();
-    double test = 0.0;
 
     if (output_buffer == NULL)
     {
@@ -587,15 +589,8 @@ static cJSON_bool print_number(const cJSON* const item, printbuffer* const outpu
     }
     else
     {
-        /* Try 15 decimal places of precision to avoid nonsignificant nonzero digits */
-        length = sprintf((char*)number_buffer, "%1.15g", d);
-
-        /* Check whether the original double can be recovered */
-        if ((sscanf((char*)number_buffer, "%lg", &test) != 1) || !compare_double((double)test, d))
-        {
-            /* If not, print with 17 decimal places of precision */
-            length = sprintf((char*)number_buffer, "%1.17g", d);
-        }
+        /* The fewest digits that read back to exactly d, without a sprintf/sscanf round trip */
+        length = config_format_double(d, (char*)number_buffer);
     }
 
     /* sprintf failed or buffer overrun occurred */
@@ -1111,15 +1106,18 @@ CJSON_PUBLIC(cJSON*) cJSON_ParseWithOpts(const char* value, const char** return_
     return cJSON_ParseWithLengthOpts(value, buffer_length, return_parse_end, require_null_terminated);
 }
 
-/* Parse an object - create a new root, and populate. */
-CJSON_PUBLIC(cJSON*) cJSON_ParseWithLengthOpts(const char* value, size_t buffer_length, const char** return_parse_end, cJSON_bool require_null_terminated)
+/* Parse an object - create a new root, and populate. The error position goes to *error_out, which may be NULL. */
+static cJSON* parse_with_length(const char* value, size_t buffer_length, const char** return_parse_end, cJSON_bool require_null_terminated, error* error_out)
 {
     parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 } };
     cJSON* item = NULL;
 
     /* reset error position */
-    global_error.json = NULL;
-    global_error.position = 0;
+    if (error_out != NULL)
+    {
+        error_out->json = NULL;
+        error_out->position = 0;
+    }
 
     if (value == NULL || 0 == buffer_length)
     {
@@ -1185,12 +1183,25 @@ fail:
             *return_parse_end = (const char*)local_error.json + local_error.position;
         }
 
-        global_error = local_error;
+        if (error_out != NULL)
+        {
+            *error_out = local_error;
+        }
     }
 
     return NULL;
 }
 
+CJSON_PUBLIC(cJSON*) cJSON_ParseWithLengthOpts(const char* value, size_t buffer_length, const char** return_parse_end, cJSON_bool require_null_terminated)
+{
+    return parse_with_length(value, buffer_length, return_parse_end, require_null_terminated, &global_error);
+}
+
+CJSON_PUBLIC(cJSON*) cJSON_ParseWithLengthOptsReentrant(const char* value, size_t buffer_length, const char** return_parse_end, cJSON_bool require_null_terminated)
+{
+    return parse_with_length(value, buffer_length, return_parse_end, require_null_terminated, NULL);
+}
+
 /* Default options for cJSON_Parse */
 CJSON_PUBLIC(cJSON*) cJSON_Parse(const char* value)
 {
@@ -157,6 +157,8 @@ extern "C"
     /* If you supply a ptr in return_parse_end and parsing fails, then return_parse_end will contain a pointer to the error so will match cJSON_GetErrorPtr(). */
     CJSON_PUBLIC(cJSON*) cJSON_ParseWithOpts(const char* value, const char** return_parse_end, cJSON_bool require_null_terminated);
     CJSON_PUBLIC(cJSON*) cJSON_ParseWithLengthOpts(const char* value, size_t buffer_length, const char** return_parse_end, cJSON_bool require_null_terminated);
+    /* Same as cJSON_ParseWithLengthOpts, but leaves cJSON_GetErrorPtr untouched, so several threads may parse at once. The error position is only reported through return_parse_end. */
+    CJSON_PUBLIC(cJSON*) cJSON_ParseWithLengthOptsReentrant(const char* value, size_t buffer_length, const char** return_parse_end, cJSON_bool require_null_terminated);
 
     /* Render a cJSON entity to text for transfer/storage. */
     CJSON_PUBLIC(char*) cJSON_Print(const cJSON* item);
@@ -0,0 +1,157 @@
+#include "zhaoba_config_internal.h"
+#include "zhaoba_config_thread.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Background saves.
+//
+// The caller only takes a snapshot (a deep copy of the records); serialization and I/O run on a worker
+// thread that drains a process-wide queue and exits when it is empty. A save requested while an earlier
+// one for the same file is still queued replaces that job's snapshot instead of queueing another write,
+// and both callers wait on the same handle.
+struct ConfigSaveHandle {
+    char* filename;
+    unsigned int flags;
+    ConfigManager* snapshot;
+    int done;
+    int result;
+    size_t refCount;   // one per caller holding the handle, plus one while queued or running
+    struct ConfigSaveHandle* next;
+};
+
+static config_mutex_t asyncLock = CONFIG_MUTEX_INITIALIZER;
+static config_cond_t asyncDone = CONFIG_COND_INITIALIZER;
+static ConfigSaveHandle* asyncQueue = NULL;
+static ConfigSaveHandle** asyncQueueTail = &asyncQueue;
+static int workerActive = 0;
+
+
+static void free_job(ConfigSaveHandle* job) {
+    free_config_manager(job->snapshot);
+    free(job->filename);
+    free(job);
+}
+
+
+// Drain the queue, one job at a time in request order
+static void save_worker(void* arg) {
+    (void)arg;
+    config_mutex_lock(&asyncLock);
+    while (asyncQueue) {
+        ConfigSaveHandle* job = asyncQueue;
+        asyncQueue = job->next;
+        if (!asyncQueue) {
+            asyncQueueTail = &asyncQueue;
+        }
+        ConfigManager* snapshot = job->snapshot;
+        job->snapshot = NULL;
+        config_mutex_unlock(&asyncLock);
+
+        int result = save_config_to_file_with_flags(snapshot, job->filename, job->flags);
+        free_config_manager(snapshot);
+
+        config_mutex_lock(&asyncLock);
+        job->result = result;
+        job->done = 1;
+        config_cond_broadcast(&asyncDone);
+        if (--job->refCount == 0) {
+            free_job(job);
+        }
+    }
+    workerActive = 0;
+    config_mutex_unlock(&asyncLock);
+}
+
+
+// Start saving a snapshot of cm in the background
+ConfigSaveHandle* save_config_to_file_async(ConfigManager* cm, const char* filename, unsigned int flags) {
+    if (!cm || !filename) {
+        return NULL;
+    }
+    ConfigManager* snapshot = config_clone(cm);
+    if (!snapshot) {
+        printf("Memory allocation for save snapshot failed.\n");
+        return NULL;
+    }
+
+    config_mutex_lock(&asyncLock);
+    for (ConfigSaveHandle* queued = asyncQueue; queued; queued = queued->next) {
+        if (strcmp(queued->filename, filename) == 0) {
+            // coalesce: the queued write will now carry the newest content
+            ConfigManager* stale = queued->snapshot;
+            queued->snapshot = snapshot;
+            queued->flags = flags;
+            queued->refCount++;
+            config_mutex_unlock(&asyncLock);
+            free_config_manager(stale);
+            return queued;
+        }
+    }
+    config_mutex_unlock(&asyncLock);
+
+    ConfigSaveHandle* job = (ConfigSaveHandle*)calloc(1, sizeof(ConfigSaveHandle));
+    if (job) {
+        job->filename = _strdup(filename);
+    }
+    if (!job || !job->filename) {
+        printf("Memory allocation for save job failed.\n");
+        free(job);
+        free_config_manager(snapshot);
+        return NULL;
+    }
+    job->flags = flags;
+    job->snapshot = snapshot;
+    job->result = -1;
+    job->refCount = 2;
+
+    config_mutex_lock(&asyncLock);
+    *asyncQueueTail = job;
+    asyncQueueTail = &job->next;
+    int startWorker = !workerActive;
+    workerActive = 1;
+    config_mutex_unlock(&asyncLock);
+
+    if (startWorker) {
+        config_thread_t thread;
+        if (config_thread_create(&thread, save_worker, NULL) == 0) {
+            config_thread_detach(thread);
+        }
+        else {
+            // no thread available, save on the caller instead
+            save_worker(NULL);
+        }
+    }
+    return job;
+}
+
+
+// Whether a background save has finished
+int config_save_done(ConfigSaveHandle* handle) {
+    if (!handle) {
+        return 1;
+    }
+    config_mutex_lock(&asyncLock);
+    int done = handle->done;
+    config_mutex_unlock(&asyncLock);
+    return done;
+}
+
+
+// Wait for a background save and release the handle
+int config_save_wait(ConfigSaveHandle* handle) {
+    if (!handle) {
+        return -1;
+    }
+    config_mutex_lock(&asyncLock);
+    while (!handle->done) {
+        config_cond_wait(&asyncDone, &asyncLock);
+    }
+    int result = handle->result;
+    int unused = --handle->refCount == 0;
+    config_mutex_unlock(&asyncLock);
+
+    if (unused) {
+        free_job(handle);
+    }
+    return result;
+}
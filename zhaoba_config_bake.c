@@ -0,0 +1,517 @@
+#include "zhaoba_config_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Baked configurations: a manager written out as C source holding a const ConfigBakedTable, compiled
+// into the program, so reading it costs no parsing and no heap.
+//
+// Lookup is a perfect hash (hash and displace): keyHash % bucketCount picks a bucket and its seed,
+// slot_hash(key, seed) % slotCount picks the only slot the key can be in, one compare confirms it.
+// The generator searches, largest bucket first, for the smallest seed sending every key of a bucket to
+// free slots. FLOAT values are stored as their IEEE-754 bits so NaN and infinities need no math.h.
+
+// average keys per bucket and free slots per key: each bucket finds its seed within a few tries
+#define BAKED_KEYS_PER_BUCKET 4
+#define BAKED_SEED_LIMIT (1u << 20)
+
+
+// FNV-1a seeded by seed, finished with a murmur mix so the remainder uses every bit
+static unsigned int slot_hash(const char* key, unsigned int seed) {
+    unsigned int hash = 2166136261u ^ (seed * 0x9E3779B9u);
+    for (const unsigned char* p = (const unsigned char*)key; *p; ++p) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6Bu;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+
+// ---- reading ----
+
+static const ConfigBakedRecord* find_baked_record(const ConfigBakedTable* table, const char* key) {
+    if (table->recordCount == 0) {
+        return NULL;
+    }
+    unsigned int hash = config_hash_key(key);
+    unsigned int seed = table->seeds[hash % table->bucketCount];
+    unsigned int slot = table->slots[slot_hash(key, seed) % table->slotCount];
+    if (slot == 0 || slot > table->recordCount) {
+        return NULL;
+    }
+    const ConfigBakedRecord* record = &table->records[slot - 1];
+    return record->keyHash == hash && strcmp(record->key, key) == 0 ? record : NULL;
+}
+
+
+// Fetch a value from a baked table
+int fetch_baked_value(const ConfigBakedTable* table, const char* key, void* valueOut, ValueType expectedType) {
+    if (!table || !key || !valueOut) {
+        return -1;
+    }
+
+    const ConfigBakedRecord* r = find_baked_record(table, key);
+    if (!r) {
+        printf("Key '%s' not found.\n", key);
+        return -1;
+    }
+    if (r->type != expectedType) {
+        printf("Type mismatch: Expected type does not match stored type for key '%s'.\n", key);
+        return -1;
+    }
+
+    switch (expectedType) {
+    case INT:
+    case FLOAT:
+        memcpy(valueOut, &r->bits, 4);
+        return 0;
+    case STRING:
+        *(const char**)valueOut = (const char*)r->data;
+        return 0;
+    case INT_ARRAY:
+    case FLOAT_ARRAY:
+        memcpy(valueOut, r->data, r->arraySize * 4);
+        return 0;
+    case STRING_ARRAY:
+        memcpy(valueOut, r->data, r->arraySize * sizeof(const char*));
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+
+// Number of elements of an array value, 0 for scalars
+int config_baked_array_size(const ConfigBakedTable* table, const char* key, size_t* sizeOut) {
+    if (!table || !key || !sizeOut) {
+        return -1;
+    }
+    const ConfigBakedRecord* r = find_baked_record(table, key);
+    if (!r) {
+        return -1;
+    }
+    *sizeOut = r->arraySize;
+    return 0;
+}
+
+
+// Copy every record of a baked table into cm
+int load_config_from_baked(ConfigManager* cm, const ConfigBakedTable* table) {
+    if (!cm || !table) {
+        return -1;
+    }
+
+    int bulk = begin_config_bulk_load(cm) == 0;
+    size_t mark = cm->size;
+    int error = 0;
+    for (size_t i = 0; i < table->recordCount && !error; ++i) {
+        const ConfigBakedRecord* r = &table->records[i];
+        const void* value = r->type == INT || r->type == FLOAT ? (const void*)&r->bits : r->data;
+        KeyValuePair kv = create_key_value_pair(r->key, (void*)value, r->type, r->arraySize);
+        if (!kv.key) {
+            error = 1;
+            break;
+        }
+        config_put_record(cm, &kv);
+    }
+    if (error) {
+        while (cm->size > mark) {
+            free_key_value_pair(&cm->records[--cm->size]);
+        }
+    }
+    int result = bulk ? end_config_bulk_load(cm) : 0;
+    return error ? -1 : result;
+}
+
+
+// ---- generating ----
+
+// Place every key: seedsOut[bucketCount] and slotsOut[slotCount] (record + 1, 0 = empty).
+// return 0 on success, 1 if some bucket found no seed, -1 on allocation failure.
+static int build_perfect_hash(const ConfigManager* cm, size_t bucketCount, size_t slotCount,
+    unsigned int* seedsOut, unsigned int* slotsOut) {
+    size_t n = cm->size;
+    size_t* bucketStart = (size_t*)calloc(bucketCount + 1, sizeof(size_t));
+    size_t* members = (size_t*)malloc((n + 1) * sizeof(size_t));
+    size_t* order = (size_t*)malloc(bucketCount * sizeof(size_t));
+    unsigned int* tried = (unsigned int*)malloc((n + 1) * sizeof(unsigned int));
+    if (!bucketStart || !members || !order || !tried) {
+        free(bucketStart);
+        free(members);
+        free(order);
+        free(tried);
+        return -1;
+    }
+
+    // group the records by bucket (counting sort), then order the buckets by size, largest first
+    size_t largest = 0;
+    for (size_t i = 0; i < n; ++i) {
+        bucketStart[cm->records[i].keyHash % bucketCount + 1]++;
+    }
+    for (size_t b = 0; b < bucketCount; ++b) {
+        if (bucketStart[b + 1] > largest) largest = bucketStart[b + 1];
+        bucketStart[b + 1] += bucketStart[b];
+    }
+    size_t* fill = (size_t*)malloc((bucketCount + largest + 1) * sizeof(size_t));
+    if (!fill) {
+        free(bucketStart);
+        free(members);
+        free(order);
+        free(tried);
+        return -1;
+    }
+    memcpy(fill, bucketStart, bucketCount * sizeof(size_t));
+    for (size_t i = 0; i < n; ++i) {
+        members[fill[cm->records[i].keyHash % bucketCount]++] = i;
+    }
+    size_t* bySize = fill;   // reused: bySize[s] counts buckets of size s, then their start in order
+    memset(bySize, 0, (largest + 1) * sizeof(size_t));
+    for (size_t b = 0; b < bucketCount; ++b) {
+        bySize[largest - (bucketStart[b + 1] - bucketStart[b])]++;
+    }
+    for (size_t s = 0, total = 0; s <= largest; ++s) {
+        size_t count = bySize[s];
+        bySize[s] = total;
+        total += count;
+    }
+    for (size_t b = 0; b < bucketCount; ++b) {
+        order[bySize[largest - (bucketStart[b + 1] - bucketStart[b])]++] = b;
+    }
+
+    memset(seedsOut, 0, bucketCount * sizeof(unsigned int));
+    memset(slotsOut, 0, slotCount * sizeof(unsigned int));
+    int result = 0;
+    for (size_t o = 0; o < bucketCount && result == 0; ++o) {
+        size_t b = order[o];
+        size_t first = bucketStart[b];
+        size_t count = bucketStart[b + 1] - first;
+        if (count == 0) {
+            break;   // the rest are empty too
+        }
+
+        unsigned int seed = 0;
+        for (; seed < BAKED_SEED_LIMIT; ++seed) {
+            size_t k = 0;
+            for (; k < count; ++k) {
+                unsigned int slot = slot_hash(cm->records[members[first + k]].key, seed) % (unsigned int)slotCount;
+                size_t j = 0;
+                while (j < k && tried[j] != slot) ++j;
+                if (slotsOut[slot] != 0 || j < k) break;
+                tried[k] = slot;
+            }
+            if (k == count) break;
+        }
+        if (seed == BAKED_SEED_LIMIT) {
+            result = 1;
+            break;
+        }
+        seedsOut[b] = seed;
+        for (size_t k = 0; k < count; ++k) {
+            slotsOut[tried[k]] = (unsigned int)members[first + k] + 1;
+        }
+    }
+
+    free(fill);
+    free(bucketStart);
+    free(members);
+    free(order);
+    free(tried);
+    return result;
+}
+
+
+static void put_text(ConfigWriter* w, const char* text) {
+    config_writer_put(w, text, strlen(text));
+}
+
+static void put_hex(ConfigWriter* w, unsigned int value) {
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "0x%08Xu", value);
+    put_text(w, buffer);
+}
+
+static void put_size(ConfigWriter* w, size_t value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%zu", value);
+    put_text(w, buffer);
+}
+
+// symbol followed by a suffix and a number, "config_s12"
+static void put_name(ConfigWriter* w, const char* symbol, const char* suffix, size_t number) {
+    put_text(w, symbol);
+    put_text(w, suffix);
+    put_size(w, number);
+}
+
+
+// A C string literal of str; every byte outside printable ASCII becomes a three-digit octal escape
+void config_write_c_string(ConfigWriter* w, const char* str) {
+    put_text(w, "\"");
+    for (const unsigned char* p = (const unsigned char*)str; *p; ++p) {
+        char buffer[8];
+        if (*p == '"' || *p == '\\' || *p == '?') {
+            buffer[0] = '\\';
+            buffer[1] = (char)*p;
+            config_writer_put(w, buffer, 2);
+        }
+        else if (*p < 0x20 || *p >= 0x7F) {
+            snprintf(buffer, sizeof(buffer), "\\%03o", *p);
+            put_text(w, buffer);
+        }
+        else {
+            config_writer_put(w, (const char*)p, 1);
+        }
+    }
+    put_text(w, "\"");
+}
+
+
+// An initializer for a char array holding str and its NUL, 24 bytes per line: "{\n    104,105,0,\n}"
+void config_write_c_bytes(ConfigWriter* w, const char* str) {
+    size_t length = strlen(str);
+    put_text(w, "{");
+    for (size_t i = 0; i <= length; ++i) {
+        char buffer[16];
+        snprintf(buffer, sizeof(buffer), "%s%u,", i % 24 == 0 ? "\n    " : "", (unsigned char)str[i]);
+        put_text(w, buffer);
+    }
+    put_text(w, "\n}");
+}
+
+
+// A string as an expression: a literal, or for a long one the name of a byte array written before
+static void put_string(ConfigWriter* w, const char* symbol, const char* str, size_t* longCount) {
+    if (strlen(str) <= CONFIG_MAX_C_LITERAL) {
+        config_write_c_string(w, str);
+    }
+    else {
+        put_name(w, symbol, "_t", (*longCount)++);
+    }
+}
+
+
+// Byte arrays for the strings put_string cannot write as literals, in the order put_string uses them
+static void put_long_string(ConfigWriter* w, const char* symbol, const char* str, size_t* longCount) {
+    size_t length = strlen(str);
+    if (length <= CONFIG_MAX_C_LITERAL) {
+        return;
+    }
+    put_text(w, "static const char ");
+    put_name(w, symbol, "_t", (*longCount)++);
+    put_text(w, "[] = ");
+    config_write_c_bytes(w, str);
+    put_text(w, ";\n");
+}
+
+
+static void put_values(ConfigWriter* w, const char* symbol, const KeyValuePair* kv, size_t i, size_t* longCount) {
+    size_t elementLong = *longCount;   // numbers of the elements' byte arrays, written next
+    if (kv->type == STRING_ARRAY) {
+        for (size_t j = 0; j < kv->arraySize; ++j) {
+            put_long_string(w, symbol, kv->value.stringArrayValue[j], longCount);
+        }
+    }
+    else if (kv->type == STRING) {
+        put_long_string(w, symbol, kv->value.stringValue, longCount);
+    }
+    if ((kv->type != INT_ARRAY && kv->type != FLOAT_ARRAY && kv->type != STRING_ARRAY) || kv->arraySize == 0) {
+        return;
+    }
+
+    put_text(w, kv->type == STRING_ARRAY ? "static const char* const " : "static const unsigned int ");
+    put_name(w, symbol, "_v", i);
+    put_text(w, "[] = {");
+    for (size_t j = 0; j < kv->arraySize; ++j) {
+        put_text(w, j % 8 == 0 ? "\n    " : " ");
+        if (kv->type == INT_ARRAY) {
+            put_hex(w, (unsigned int)kv->value.intArrayValue[j]);
+        }
+        else if (kv->type == FLOAT_ARRAY) {
+            unsigned int bits;
+            memcpy(&bits, &kv->value.floatArrayValue[j], 4);
+            put_hex(w, bits);
+        }
+        else {
+            put_string(w, symbol, kv->value.stringArrayValue[j], &elementLong);
+        }
+        put_text(w, ",");
+    }
+    put_text(w, "\n};\n");
+}
+
+
+static void put_record(ConfigWriter* w, const char* symbol, const KeyValuePair* kv, size_t i, size_t* longCount) {
+    static const char* typeNames[] = { "INT", "FLOAT", "STRING", "INT_ARRAY", "FLOAT_ARRAY", "STRING_ARRAY" };
+    put_text(w, "    { ");
+    put_string(w, symbol, kv->key, longCount);
+    put_text(w, ", ");
+    put_hex(w, kv->keyHash);
+    put_text(w, ", ");
+    put_text(w, typeNames[kv->type]);
+    put_text(w, ", ");
+
+    unsigned int bits = 0;
+    if (kv->type == INT) {
+        bits = (unsigned int)kv->value.intValue;
+    }
+    else if (kv->type == FLOAT) {
+        memcpy(&bits, &kv->value.floatValue, 4);
+    }
+    put_hex(w, bits);
+    put_text(w, ", ");
+
+    if (kv->type == STRING) {
+        put_string(w, symbol, kv->value.stringValue, longCount);
+    }
+    else if (kv->type == INT || kv->type == FLOAT || kv->arraySize == 0) {
+        put_text(w, "NULL");
+    }
+    else {
+        put_name(w, symbol, "_v", i);
+    }
+    put_text(w, ", ");
+    put_size(w, kv->type == INT || kv->type == FLOAT || kv->type == STRING ? 0 : kv->arraySize);
+    put_text(w, " },\n");
+}
+
+
+static void put_table(ConfigWriter* w, const char* name, const unsigned int* values, size_t count) {
+    put_text(w, "static const unsigned int ");
+    put_text(w, name);
+    put_text(w, "[] = {");
+    for (size_t i = 0; i < count; ++i) {
+        put_text(w, i % 8 == 0 ? "\n    " : " ");
+        put_hex(w, values[i]);
+        put_text(w, ",");
+    }
+    put_text(w, "\n};\n");
+}
+
+
+static int is_identifier(const char* symbol) {
+    if (!((*symbol >= 'a' && *symbol <= 'z') || (*symbol >= 'A' && *symbol <= 'Z') || *symbol == '_')) {
+        return 0;
+    }
+    for (const char* p = symbol; *p; ++p) {
+        if (!((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9') || *p == '_')) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+// Write the C source of cm as the baked table symbol
+static int write_source(ConfigWriter* w, const ConfigManager* cm, const char* symbol,
+    const unsigned int* seeds, size_t bucketCount, const unsigned int* slots, size_t slotCount) {
+    put_text(w, "// Generated by save_config_to_c_source, do not edit.\n// Declare it where it is used: extern const ConfigBakedTable ");
+    put_text(w, symbol);
+    put_text(w, ";\n#include \"zhaoba_config_manager.h\"\n#include <stddef.h>\n\nextern const ConfigBakedTable ");
+    put_text(w, symbol);
+    put_text(w, ";\n\n");
+
+    // long strings and array values first, the records refer to them
+    size_t longCount = 0;
+    for (size_t i = 0; i < cm->size && !w->failed; ++i) {
+        put_long_string(w, symbol, cm->records[i].key, &longCount);
+        put_values(w, symbol, &cm->records[i], i, &longCount);
+    }
+
+    put_text(w, "\nstatic const ConfigBakedRecord ");
+    put_text(w, symbol);
+    put_text(w, "_records[] = {\n");
+    longCount = 0;
+    for (size_t i = 0; i < cm->size && !w->failed; ++i) {
+        const KeyValuePair* kv = &cm->records[i];
+        put_record(w, symbol, kv, i, &longCount);
+        if (kv->type == STRING_ARRAY) {
+            // the elements' byte arrays were numbered after the key's, skip them
+            for (size_t j = 0; j < kv->arraySize; ++j) {
+                if (strlen(kv->value.stringArrayValue[j]) > CONFIG_MAX_C_LITERAL) longCount++;
+            }
+        }
+    }
+    if (cm->size == 0) {
+        put_text(w, "    { NULL, 0, INT, 0, NULL, 0 },\n");
+    }
+    put_text(w, "};\n");
+
+    char name[300];
+    snprintf(name, sizeof(name), "%s_seeds", symbol);
+    put_table(w, name, seeds, bucketCount);
+    snprintf(name, sizeof(name), "%s_slots", symbol);
+    put_table(w, name, slots, slotCount);
+
+    put_text(w, "\nconst ConfigBakedTable ");
+    put_text(w, symbol);
+    put_text(w, " = { ");
+    put_text(w, symbol);
+    put_text(w, "_records, ");
+    put_size(w, cm->size);
+    put_text(w, ", ");
+    put_text(w, symbol);
+    put_text(w, "_seeds, ");
+    put_size(w, bucketCount);
+    put_text(w, ", ");
+    put_text(w, symbol);
+    put_text(w, "_slots, ");
+    put_size(w, slotCount);
+    put_text(w, " };\n");
+    return config_writer_flush(w);
+}
+
+
+// Write configuration data as C source defining a baked table
+int save_config_to_c_source(ConfigManager* cm, const char* filename, const char* symbol) {
+    if (!cm || !filename || !symbol || config_bulk_resolve(cm) != 0) {
+        return -1;
+    }
+    if (!is_identifier(symbol) || strlen(symbol) > 200) {
+        printf("Error: '%s' is not a valid C identifier.\n", symbol);
+        return -1;
+    }
+
+    // a bucket that finds no seed gets more room: twice the slots and the search starts over
+    size_t bucketCount = cm->size / BAKED_KEYS_PER_BUCKET + 1;
+    size_t slotCount = cm->size + cm->size / 4 + 1;
+    unsigned int* seeds = NULL;
+    unsigned int* slots = NULL;
+    int placed = 1;
+    while (placed == 1) {
+        free(seeds);
+        free(slots);
+        seeds = (unsigned int*)malloc(bucketCount * sizeof(unsigned int));
+        slots = (unsigned int*)malloc(slotCount * sizeof(unsigned int));
+        placed = seeds && slots ? build_perfect_hash(cm, bucketCount, slotCount, seeds, slots) : -1;
+        slotCount *= 2;
+    }
+    slotCount /= 2;
+    if (placed != 0) {
+        printf("Memory allocation for perfect hash failed.\n");
+        free(seeds);
+        free(slots);
+        return -1;
+    }
+
+    int fd = config_file_open_write(filename, 0);
+    ConfigWriter* w = fd >= 0 ? (ConfigWriter*)malloc(sizeof(ConfigWriter)) : NULL;
+    int result = -1;
+    if (w) {
+        config_writer_init(w, config_fd_write, &fd, 0);
+        result = write_source(w, cm, symbol, seeds, bucketCount, slots, slotCount);
+        free(w);
+    }
+    if (fd >= 0 && config_fd_close(fd) != 0) {
+        result = -1;
+    }
+    if (result != 0) {
+        printf("Error writing file: %s\n", filename);
+    }
+    free(seeds);
+    free(slots);
+    return result;
+}
@@ -0,0 +1,223 @@
+#include "zhaoba_config_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Structs bound to a manager through a table of field descriptors.
+//
+// A binding remembers, for every field, the record position its key resolved to. A refresh walks the
+// table once and copies each record straight into its field, so no key is hashed or compared again
+// while the records stay where they are; and it copies only records whose changeStamp is newer than the
+// last refresh, so a reload that changed two keys touches two fields. Records move only when a key is
+// removed or changes type, both of which bump rewriteChangeCount; then every field is looked up again.
+// A key that was missing is looked up again only after records were added.
+
+struct ConfigBinding {
+    ConfigManager* cm;
+    const ConfigBindingField* fields;
+    size_t fieldCount;
+    void* target;
+    size_t* positions;        // record position of each field, CONFIG_NPOS while its key is missing
+    unsigned int* keyHashes;  // config_hash_key of each field's key, checked before a position is used
+    int filled;
+    unsigned long seenChangeCount;   // cm->changeCount at the last refresh
+    unsigned long seenRewriteCount;  // cm->rewriteChangeCount when the positions were resolved
+    size_t seenSize;                 // cm->size when the positions were resolved
+    ConfigBinding* next;
+};
+
+
+static size_t element_size(ValueType type) {
+    switch (type) {
+    case INT:
+    case INT_ARRAY:
+        return sizeof(int);
+    case FLOAT:
+    case FLOAT_ARRAY:
+        return sizeof(float);
+    case STRING:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// Whether a descriptor can be filled: a supported type and a size that holds at least one element
+static int field_is_valid(const ConfigBindingField* field) {
+    size_t element = element_size(field->type);
+    if (!field->key || element == 0 || field->size < element) {
+        return 0;
+    }
+    if (field->type == INT || field->type == FLOAT) {
+        return field->size == element;
+    }
+    return field->size % element == 0;
+}
+
+
+// Copy a record into its field
+static void fill_field(unsigned char* target, const ConfigBindingField* field, const KeyValuePair* kv) {
+    unsigned char* dst = target + field->offset;
+    switch (field->type) {
+    case INT:
+    case FLOAT:
+        memcpy(dst, &kv->value, field->size);
+        break;
+    case STRING: {
+        // truncated to the buffer, always terminated
+        size_t length = strlen(kv->value.stringValue);
+        if (length >= field->size) {
+            length = field->size - 1;
+        }
+        memcpy(dst, kv->value.stringValue, length);
+        dst[length] = '\0';
+        break;
+    }
+    default: {
+        // INT_ARRAY, FLOAT_ARRAY: the elements that fit, the rest of the array zeroed
+        size_t bytes = kv->arraySize * element_size(field->type);
+        if (bytes > field->size) {
+            bytes = field->size;
+        }
+        if (bytes > 0) {
+            memcpy(dst, kv->value.intArrayValue, bytes);
+        }
+        memset(dst + bytes, 0, field->size - bytes);
+        break;
+    }
+    }
+}
+
+
+static int refresh_binding(ConfigBinding* b) {
+    ConfigManager* cm = b->cm;
+    if (config_bulk_resolve(cm) != 0) {
+        return -1;
+    }
+    if (b->filled && b->seenChangeCount == cm->changeCount) {
+        return 0;
+    }
+
+    int moved = cm->rewriteChangeCount != b->seenRewriteCount;
+    int grown = cm->size != b->seenSize;
+    unsigned char* target = (unsigned char*)b->target;
+    for (size_t f = 0; f < b->fieldCount; ++f) {
+        const ConfigBindingField* field = &b->fields[f];
+        size_t pos = b->positions[f];
+        int resolve = moved || (pos == CONFIG_NPOS ? grown : pos >= cm->size || cm->records[pos].keyHash != b->keyHashes[f]);
+        if (resolve) {
+            size_t found = find_record_index(cm, field->key);
+            resolve = found != b->positions[f];
+            pos = b->positions[f] = found;
+        }
+        if (pos == CONFIG_NPOS) {
+            continue;
+        }
+        const KeyValuePair* kv = &cm->records[pos];
+        if (kv->type != field->type) {
+            continue;
+        }
+        if (!b->filled || resolve || kv->changeStamp > b->seenChangeCount) {
+            fill_field(target, field, kv);
+        }
+    }
+
+    b->filled = 1;
+    b->seenChangeCount = cm->changeCount;
+    b->seenRewriteCount = cm->rewriteChangeCount;
+    b->seenSize = cm->size;
+    return 0;
+}
+
+
+// Bind a struct to the keys of a manager
+ConfigBinding* bind_config_struct(ConfigManager* cm, const ConfigBindingField* fields, size_t fieldCount, void* target) {
+    if (!cm || (!fields && fieldCount > 0) || !target) {
+        return NULL;
+    }
+    for (size_t f = 0; f < fieldCount; ++f) {
+        if (!field_is_valid(&fields[f])) {
+            printf("Error: binding field %zu ('%s') has an unsupported type %d or size %zu.\n",
+                f, fields[f].key ? fields[f].key : "", fields[f].type, fields[f].size);
+            return NULL;
+        }
+    }
+
+    ConfigBinding* b = (ConfigBinding*)calloc(1, sizeof(ConfigBinding));
+    size_t* positions = (size_t*)malloc((fieldCount + 1) * sizeof(size_t));
+    unsigned int* keyHashes = (unsigned int*)malloc((fieldCount + 1) * sizeof(unsigned int));
+    if (!b || !positions || !keyHashes) {
+        printf("Memory allocation for config binding failed.\n");
+        free(b);
+        free(positions);
+        free(keyHashes);
+        return NULL;
+    }
+    for (size_t f = 0; f < fieldCount; ++f) {
+        positions[f] = CONFIG_NPOS;
+        keyHashes[f] = config_hash_key(fields[f].key);
+    }
+    b->cm = cm;
+    b->fields = fields;
+    b->fieldCount = fieldCount;
+    b->target = target;
+    b->positions = positions;
+    b->keyHashes = keyHashes;
+    // every position is unresolved, so the first refresh looks every key up
+    b->seenSize = (size_t)-1;
+
+    if (refresh_binding(b) != 0) {
+        free(positions);
+        free(keyHashes);
+        free(b);
+        return NULL;
+    }
+    b->next = cm->bindings;
+    cm->bindings = b;
+    return b;
+}
+
+
+// Fill a bound struct from the current values
+int refresh_config_binding(ConfigBinding* binding) {
+    if (!binding) {
+        return -1;
+    }
+    return refresh_binding(binding);
+}
+
+
+static void free_binding(ConfigBinding* b) {
+    free(b->positions);
+    free(b->keyHashes);
+    free(b);
+}
+
+// Detach a struct from its manager
+void unbind_config_struct(ConfigBinding* binding) {
+    if (!binding) {
+        return;
+    }
+    for (ConfigBinding** link = &binding->cm->bindings; *link; link = &(*link)->next) {
+        if (*link == binding) {
+            *link = binding->next;
+            break;
+        }
+    }
+    free_binding(binding);
+}
+
+
+void config_bindings_refresh(ConfigManager* cm) {
+    for (ConfigBinding* b = cm->bindings; b; b = b->next) {
+        refresh_binding(b);
+    }
+}
+
+
+void config_bindings_free(ConfigManager* cm) {
+    while (cm->bindings) {
+        ConfigBinding* b = cm->bindings;
+        cm->bindings = b->next;
+        free_binding(b);
+    }
+}
@@ -0,0 +1,317 @@
+#include "zhaoba_config_internal.h"
+#include "zhaoba_config_thread.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Codec registry: which file format load_config_from_file, reload_config_from_file and
+// save_config_to_file_with_flags use for a given file.
+//
+// Loading probes the first bytes of the file with every codec. A codec recognizing its magic bytes wins,
+// then a codec that finds the bytes plausible and owns the file extension, then any codec owning the
+// extension, then the first plausible one. Saving has no bytes to look at and goes by extension alone,
+// unknown extensions stay JSON. Registered codecs are consulted newest first and before the built-in ones,
+// so a deployment can plug in a faster implementation of a format under the same name.
+
+#define CONFIG_MAX_CODECS 32
+// bytes handed to probe
+#define CODEC_PROBE_SIZE 64
+// JSON files at least this large are loaded on several threads when there are several processors
+#define CODEC_PARALLEL_JSON_BYTES (2 << 20)
+
+static config_mutex_t registryLock = CONFIG_MUTEX_INITIALIZER;
+static const ConfigCodec* registered[CONFIG_MAX_CODECS];
+static size_t registeredCount = 0;
+
+
+// ---- built-in codecs ----
+
+static size_t skip_text_space(const unsigned char* head, size_t length, size_t pos) {
+    if (pos == 0 && length >= 3 && memcmp(head, "\xEF\xBB\xBF", 3) == 0) {
+        pos = 3;
+    }
+    while (pos < length && (head[pos] == ' ' || head[pos] == '\t' || head[pos] == '\r' || head[pos] == '\n')) {
+        ++pos;
+    }
+    return pos;
+}
+
+// the record array, "[" then "{" or "]"; an INI section header also starts with "["
+static int probe_json(const unsigned char* head, size_t length) {
+    if (config_is_compressed((const char*)head, length)) {
+        // usually JSON, but every text loader inflates, so the extension may name another format
+        return CONFIG_PROBE_MAYBE;
+    }
+    size_t pos = skip_text_space(head, length, 0);
+    if (pos >= length || head[pos] != '[') {
+        return CONFIG_PROBE_NO;
+    }
+    pos = skip_text_space(head, length, pos + 1);
+    return pos >= length || head[pos] == '{' || head[pos] == ']' ? CONFIG_PROBE_YES : CONFIG_PROBE_NO;
+}
+
+static int probe_jsonl(const unsigned char* head, size_t length) {
+    size_t pos = skip_text_space(head, length, 0);
+    return pos < length && head[pos] == '{' ? CONFIG_PROBE_YES : CONFIG_PROBE_NO;
+}
+
+// a top-level map: fixmap bytes never start UTF-8 text, map16/map32 may
+static int probe_msgpack(const unsigned char* head, size_t length) {
+    if (length == 0) {
+        return CONFIG_PROBE_NO;
+    }
+    if (head[0] >= 0x80 && head[0] <= 0x8f) {
+        return CONFIG_PROBE_YES;
+    }
+    return head[0] == 0xde || head[0] == 0xdf ? CONFIG_PROBE_MAYBE : CONFIG_PROBE_NO;
+}
+
+// any text, INI has no magic
+static int probe_ini(const unsigned char* head, size_t length) {
+    if (length > 0 && head[0] >= 0x80 && head[0] <= 0x8f) {
+        return CONFIG_PROBE_NO;
+    }
+    return memchr(head, '\0', length) ? CONFIG_PROBE_NO : CONFIG_PROBE_MAYBE;
+}
+
+static int probe_snapshot(const unsigned char* head, size_t length) {
+    return length >= 4 && memcmp(head, "ZCS1", 4) == 0 ? CONFIG_PROBE_YES : CONFIG_PROBE_NO;
+}
+
+
+// the fastest JSON path for the file: streaming inflate, one parser per processor, or one tree
+static int json_load(ConfigManager* cm, const char* filename) {
+    if (config_file_is_compressed(filename)) {
+        return config_load_compressed(cm, filename);
+    }
+    if (config_cpu_count() > 1 && config_file_size(filename) >= CODEC_PARALLEL_JSON_BYTES) {
+        return load_config_from_file_parallel(cm, filename, 0);
+    }
+    return config_load_json(cm, filename);
+}
+
+static int json_save(ConfigManager* cm, const char* filename, unsigned int flags) {
+    return config_save_json(cm, filename, flags);
+}
+
+static int jsonl_load(ConfigManager* cm, const char* filename) {
+    return load_config_from_jsonl(cm, filename, 0);
+}
+
+static int msgpack_save(ConfigManager* cm, const char* filename, unsigned int flags) {
+    (void)flags;
+    return save_config_to_msgpack(cm, filename);
+}
+
+static int ini_save(ConfigManager* cm, const char* filename, unsigned int flags) {
+    (void)flags;
+    return save_config_to_ini(cm, filename);
+}
+
+static int snapshot_save(ConfigManager* cm, const char* filename, unsigned int flags) {
+    (void)flags;
+    return save_config_snapshot(cm, filename);
+}
+
+const ConfigCodec config_json_codec = { "json", ".json", probe_json, json_load, json_save };
+
+static const ConfigCodec builtinCodecs[] = {
+    { "json", ".json", probe_json, json_load, json_save },
+    { "jsonl", ".jsonl .ndjson", probe_jsonl, jsonl_load, save_config_to_jsonl },
+    { "msgpack", ".msgpack .mpk", probe_msgpack, load_config_from_msgpack, msgpack_save },
+    { "snapshot", ".snap", probe_snapshot, config_load_snapshot, snapshot_save },
+    { "ini", ".ini .properties .conf .cfg", probe_ini, load_config_from_ini, ini_save },
+};
+#define BUILTIN_CODEC_COUNT (sizeof(builtinCodecs) / sizeof(builtinCodecs[0]))
+
+
+// ---- registry ----
+
+// Snapshot of every codec in lookup order, registered ones newest first. return the count.
+static size_t list_codecs(const ConfigCodec** out) {
+    config_mutex_lock(&registryLock);
+    size_t count = 0;
+    for (size_t i = registeredCount; i-- > 0; ) {
+        out[count++] = registered[i];
+    }
+    config_mutex_unlock(&registryLock);
+
+    // the first built-in is the JSON codec, represented by config_json_codec so callers can recognize it
+    out[count++] = &config_json_codec;
+    for (size_t i = 1; i < BUILTIN_CODEC_COUNT; ++i) {
+        out[count++] = &builtinCodecs[i];
+    }
+    return count;
+}
+
+
+// Register a codec
+int register_config_codec(const ConfigCodec* codec) {
+    if (!codec || !codec->name || !codec->probe || !codec->load) {
+        return -1;
+    }
+    config_mutex_lock(&registryLock);
+    int result = 0;
+    size_t i = 0;
+    while (i < registeredCount && strcmp(registered[i]->name, codec->name) != 0) {
+        ++i;
+    }
+    if (i < registeredCount) {
+        // same name: the new codec replaces the old one and moves to the front
+        memmove(&registered[i], &registered[i + 1], (registeredCount - i - 1) * sizeof(registered[0]));
+        registered[registeredCount - 1] = codec;
+    }
+    else if (registeredCount < CONFIG_MAX_CODECS) {
+        registered[registeredCount++] = codec;
+    }
+    else {
+        printf("Error: too many configuration codecs registered.\n");
+        result = -1;
+    }
+    config_mutex_unlock(&registryLock);
+    return result;
+}
+
+
+// Find a codec by name
+const ConfigCodec* find_config_codec(const char* name) {
+    if (!name) {
+        return NULL;
+    }
+    const ConfigCodec* codecs[CONFIG_MAX_CODECS + BUILTIN_CODEC_COUNT];
+    size_t count = list_codecs(codecs);
+    for (size_t i = 0; i < count; ++i) {
+        if (strcmp(codecs[i]->name, name) == 0) {
+            return codecs[i];
+        }
+    }
+    return NULL;
+}
+
+
+// Whether filename ends in one of the space-separated extensions, compared without case
+static int has_extension(const ConfigCodec* codec, const char* filename) {
+    if (!codec->extensions) {
+        return 0;
+    }
+    size_t nameLength = strlen(filename);
+    const char* ext = codec->extensions;
+    while (*ext) {
+        size_t length = strcspn(ext, " ");
+        if (length > 0 && length <= nameLength) {
+            const char* tail = filename + nameLength - length;
+            size_t i = 0;
+            while (i < length && (tail[i] | 0x20) == (ext[i] | 0x20)) ++i;
+            if (i == length) {
+                return 1;
+            }
+        }
+        ext += length;
+        while (*ext == ' ') ++ext;
+    }
+    return 0;
+}
+
+
+// Pick the codec for loading filename
+const ConfigCodec* detect_config_codec(const char* filename) {
+    if (!filename) {
+        return NULL;
+    }
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        printf("Error opening file: %s\n", filename);
+        return NULL;
+    }
+    unsigned char head[CODEC_PROBE_SIZE];
+    size_t length = fread(head, 1, sizeof(head), file);
+    fclose(file);
+
+    const ConfigCodec* codecs[CONFIG_MAX_CODECS + BUILTIN_CODEC_COUNT];
+    size_t count = list_codecs(codecs);
+    int scores[CONFIG_MAX_CODECS + BUILTIN_CODEC_COUNT];
+    for (size_t i = 0; i < count; ++i) {
+        scores[i] = codecs[i]->probe(head, length);
+        if (scores[i] == CONFIG_PROBE_YES) {
+            return codecs[i];
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (scores[i] == CONFIG_PROBE_MAYBE && has_extension(codecs[i], filename)) {
+            return codecs[i];
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (has_extension(codecs[i], filename)) {
+            return codecs[i];
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (scores[i] == CONFIG_PROBE_MAYBE) {
+            return codecs[i];
+        }
+    }
+    printf("Error: no codec can read %s\n", filename);
+    return NULL;
+}
+
+
+// Codec that owns filename's extension and can save, NULL for the JSON default
+const ConfigCodec* config_codec_for_save(const char* filename) {
+    const ConfigCodec* codecs[CONFIG_MAX_CODECS + BUILTIN_CODEC_COUNT];
+    size_t count = list_codecs(codecs);
+    for (size_t i = 0; i < count; ++i) {
+        if (codecs[i]->save && has_extension(codecs[i], filename)) {
+            return codecs[i] == &config_json_codec ? NULL : codecs[i];
+        }
+    }
+    return NULL;
+}
+
+
+// A codec that remembers its saves (JSON Lines, for skipping and appending) remembered the temp file,
+// which is filename now that it has been renamed
+static void remember_final_name(ConfigManager* cm, const char* tempPath, const char* filename) {
+    config_mutex_lock(&cm->saveLock);
+    int remembered = cm->savedFile && strcmp(cm->savedFile, tempPath) == 0;
+    unsigned int savedFlags = cm->savedFlags;
+    unsigned long savedChangeCount = cm->savedChangeCount;
+    config_mutex_unlock(&cm->saveLock);
+    if (remembered) {
+        config_remember_save(cm, filename, savedFlags, savedChangeCount);
+    }
+}
+
+
+// Save through a codec. CONFIG_SAVE_ATOMIC is provided here for every codec: the codec writes a temp
+// file, which is then synced and renamed over filename.
+int config_codec_save(const ConfigCodec* codec, ConfigManager* cm, const char* filename, unsigned int flags) {
+    if (!(flags & CONFIG_SAVE_ATOMIC)) {
+        return codec->save(cm, filename, flags);
+    }
+
+    char* tempPath = config_temp_path(filename);
+    if (!tempPath) {
+        return -1;
+    }
+    int result = codec->save(cm, tempPath, flags & ~CONFIG_SAVE_ATOMIC);
+    if (result == 0) {
+        int fd = config_file_open_append(tempPath);
+        result = fd >= 0 && config_fd_sync(fd) == 0 ? 0 : -1;
+        if (fd >= 0 && config_fd_close(fd) != 0) {
+            result = -1;
+        }
+    }
+    if (result == 0) {
+        result = config_replace_file(tempPath, filename);
+    }
+    if (result == 0) {
+        config_sync_parent_dir(filename);
+        remember_final_name(cm, tempPath, filename);
+    }
+    else {
+        printf("Error committing file: %s\n", filename);
+        remove(tempPath);
+    }
+    free(tempPath);
+    return result;
+}
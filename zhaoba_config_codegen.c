@@ -0,0 +1,612 @@
+#include "zhaoba_config_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Typed settings structs generated from a schema.
+//
+// The schema is a config manager: each record's key, type and value are a setting's key, field type and
+// default, so a defaults file is a schema as it stands. The generated header declares the struct, one field
+// per record (plus a _count field for arrays), and the generated source fills it in one pass over the
+// fields: defaults in <prefix>_init, the values a manager holds with the schema type in <prefix>_refresh.
+// The generated code only calls the public API; its helpers are emitted only for the types it uses.
+
+#define CODEGEN_MAX_FIELD_NAME 48
+
+static const char* const cKeywords[] = {
+    "auto", "break", "case", "char", "const", "continue", "default", "do", "double", "else", "enum",
+    "extern", "float", "for", "goto", "if", "inline", "int", "long", "register", "restrict", "return",
+    "short", "signed", "sizeof", "static", "struct", "switch", "typedef", "union", "unsigned", "void",
+    "volatile", "while", "bool", "true", "false", "NULL"
+};
+
+// Field names, each a heap string, and which helpers the generated source needs
+typedef struct StructPlan {
+    char** names;
+    size_t nameCount;
+    char** fields;       // field of record i
+    int usesType[STRING_ARRAY + 1];
+    int usesFloatBits;   // a FLOAT default that C cannot write as a constant (NaN, infinity)
+} StructPlan;
+
+
+static int is_identifier_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static int is_c_identifier(const char* name) {
+    if (!*name || (*name >= '0' && *name <= '9')) {
+        return 0;
+    }
+    for (const char* p = name; *p; ++p) {
+        if (!is_identifier_char(*p)) return 0;
+    }
+    return 1;
+}
+
+static int name_taken(const StructPlan* plan, const char* name) {
+    for (size_t i = 0; i < plan->nameCount; ++i) {
+        if (strcmp(plan->names[i], name) == 0) return 1;
+    }
+    for (size_t i = 0; i < sizeof(cKeywords) / sizeof(cKeywords[0]); ++i) {
+        if (strcmp(cKeywords[i], name) == 0) return 1;
+    }
+    return 0;
+}
+
+
+// Field name for key: other characters become '_', a leading digit gets "f_", clashes get "_2", "_3"...
+// a long key gives its first CODEGEN_MAX_FIELD_NAME characters, well within every compiler's identifier limit.
+// An array also takes name_count. return the name (owned by plan) or NULL on allocation failure.
+static char* plan_field(StructPlan* plan, const char* key, int isArray) {
+    size_t length = strlen(key);
+    if (length > CODEGEN_MAX_FIELD_NAME) {
+        length = CODEGEN_MAX_FIELD_NAME;
+    }
+    char* base = (char*)malloc(length + 3);
+    char* name = (char*)malloc(length + 32);
+    char* count = (char*)malloc(length + 40);
+    if (!base || !name || !count) {
+        free(base);
+        free(name);
+        free(count);
+        return NULL;
+    }
+    size_t n = 0;
+    if (length == 0 || (key[0] >= '0' && key[0] <= '9')) {
+        base[n++] = 'f';
+        base[n++] = '_';
+    }
+    for (size_t i = 0; i < length; ++i) {
+        base[n++] = is_identifier_char(key[i]) ? key[i] : '_';
+    }
+    base[n] = '\0';
+
+    for (unsigned int suffix = 1; ; ++suffix) {
+        if (suffix == 1) snprintf(name, length + 32, "%s", base);
+        else snprintf(name, length + 32, "%s_%u", base, suffix);
+        snprintf(count, length + 40, "%s_count", name);
+        if (!name_taken(plan, name) && (!isArray || !name_taken(plan, count))) break;
+    }
+    free(base);
+
+    plan->names[plan->nameCount++] = name;
+    if (isArray) {
+        plan->names[plan->nameCount++] = count;
+    }
+    else {
+        free(count);
+    }
+    return name;
+}
+
+
+static int float_is_literal(float value) {
+    return value == value && value - value == 0.0f;
+}
+
+static void plan_free(StructPlan* plan) {
+    for (size_t i = 0; i < plan->nameCount; ++i) {
+        free(plan->names[i]);
+    }
+    free(plan->names);
+    free(plan->fields);
+}
+
+static int plan_struct(StructPlan* plan, const ConfigManager* schema) {
+    memset(plan, 0, sizeof(*plan));
+    plan->names = (char**)malloc((schema->size * 2 + 1) * sizeof(char*));
+    plan->fields = (char**)malloc((schema->size + 1) * sizeof(char*));
+    if (!plan->names || !plan->fields) {
+        return -1;
+    }
+    for (size_t i = 0; i < schema->size; ++i) {
+        const KeyValuePair* kv = &schema->records[i];
+        int isArray = kv->type == INT_ARRAY || kv->type == FLOAT_ARRAY || kv->type == STRING_ARRAY;
+        plan->fields[i] = plan_field(plan, kv->key, isArray);
+        if (!plan->fields[i]) {
+            return -1;
+        }
+        plan->usesType[kv->type] = 1;
+        if (kv->type == FLOAT && !float_is_literal(kv->value.floatValue)) {
+            plan->usesFloatBits = 1;
+        }
+    }
+    return 0;
+}
+
+
+// ---- output ----
+
+static void put(ConfigWriter* w, const char* text) {
+    config_writer_put(w, text, strlen(text));
+}
+
+// printf into w, for short pieces
+static void putf(ConfigWriter* w, const char* format, const char* a, const char* b) {
+    char buffer[512];
+    int length = snprintf(buffer, sizeof(buffer), format, a, b);
+    if (length >= (int)sizeof(buffer)) {
+        // names are long: write the pieces the slow way
+        const char* args[2] = { a, b };
+        int arg = 0;
+        for (const char* p = format; *p; ++p) {
+            if (p[0] == '%' && p[1] == 's') {
+                put(w, args[arg++]);
+                ++p;
+            }
+            else {
+                config_writer_put(w, p, 1);
+            }
+        }
+        return;
+    }
+    config_writer_put(w, buffer, (size_t)length);
+}
+
+static void put_int(ConfigWriter* w, int value) {
+    char buffer[32];
+    if (value == -2147483647 - 1) {
+        put(w, "(-2147483647 - 1)");
+        return;
+    }
+    snprintf(buffer, sizeof(buffer), "%d", value);
+    put(w, buffer);
+}
+
+// a float constant, or float_from_bits(...) for NaN and infinities
+static void put_float(ConfigWriter* w, float value) {
+    char buffer[CONFIG_NUMBER_BUFFER_SIZE + 32];
+    if (!float_is_literal(value)) {
+        unsigned int bits;
+        memcpy(&bits, &value, 4);
+        snprintf(buffer, sizeof(buffer), "float_from_bits(0x%08Xu)", bits);
+        put(w, buffer);
+        return;
+    }
+    int length = config_format_float(value, buffer);
+    if (!strpbrk(buffer, ".e")) {
+        memcpy(buffer + length, ".0", 3);
+    }
+    put(w, buffer);
+    put(w, "f");
+}
+
+
+static const char* field_type(ValueType type) {
+    switch (type) {
+    case INT: return "int ";
+    case FLOAT: return "float ";
+    case STRING: return "char* ";
+    case INT_ARRAY: return "int* ";
+    case FLOAT_ARRAY: return "float* ";
+    default: return "char** ";
+    }
+}
+
+
+// key as a literal for a comment, cut short when it is too long for one line
+static void put_key_comment(ConfigWriter* w, const char* key) {
+    char shortKey[64];
+    if (strlen(key) < sizeof(shortKey)) {
+        config_write_c_string(w, key);
+        return;
+    }
+    memcpy(shortKey, key, sizeof(shortKey) - 1);
+    shortKey[sizeof(shortKey) - 1] = '\0';
+    config_write_c_string(w, shortKey);
+    put(w, "...");
+}
+
+
+static void write_header(ConfigWriter* w, const ConfigManager* schema, const StructPlan* plan,
+    const char* structName, const char* prefix) {
+    put(w, "// Generated by generate_config_struct, do not edit.\n");
+    size_t guardLength = strlen(prefix);
+    char* guard = (char*)malloc(guardLength + 1);
+    if (guard) {
+        for (size_t i = 0; i <= guardLength; ++i) {
+            char c = prefix[i];
+            guard[i] = c >= 'a' && c <= 'z' ? (char)(c - 'a' + 'A') : c;
+        }
+        putf(w, "#ifndef %s_CONFIG_STRUCT_H\n#define %s_CONFIG_STRUCT_H\n\n", guard, guard);
+    }
+    put(w, "#include \"zhaoba_config_manager.h\"\n#include <stddef.h>\n\n");
+
+    putf(w, "// Settings read from a config manager, see %s_refresh\ntypedef struct %s {\n", prefix, structName);
+    for (size_t i = 0; i < schema->size; ++i) {
+        const KeyValuePair* kv = &schema->records[i];
+        put(w, "    ");
+        put(w, field_type(kv->type));
+        put(w, plan->fields[i]);
+        put(w, ";   // ");
+        put_key_comment(w, kv->key);
+        put(w, "\n");
+        if (kv->type == INT_ARRAY || kv->type == FLOAT_ARRAY || kv->type == STRING_ARRAY) {
+            putf(w, "    size_t %s_count;\n", plan->fields[i], NULL);
+        }
+    }
+    if (schema->size == 0) {
+        put(w, "    int unused;\n");
+    }
+    putf(w, "} %s;\n\n", structName, NULL);
+
+    putf(w, "// Set every field of cfg to its default. return 0 on success, -1 on allocation failure.\n"
+        "int %s_init(%s* cfg);\n\n", prefix, structName);
+    putf(w, "// Copy every key of cm stored with its schema type into its field, the other fields keep their value.\n"
+        "// return 0 on success, -1 on allocation failure.\n"
+        "int %s_refresh(%s* cfg, ConfigManager* cm);\n\n", prefix, structName);
+    putf(w, "// Defaults, then the values of cm. return 0 on success, -1 on allocation failure.\n"
+        "int %s_load(%s* cfg, ConfigManager* cm);\n\n", prefix, structName);
+    putf(w, "// Defaults, then the values of a file in any format load_config_from_file reads.\n"
+        "// return 0 on success, -1 if the file cannot be loaded (cfg keeps the defaults) or on allocation failure.\n"
+        "int %s_load_file(%s* cfg, const char* filename);\n\n", prefix, structName);
+    putf(w, "// Free the strings and arrays of cfg.\nvoid %s_free(%s* cfg);\n", prefix, structName);
+    if (guard) {
+        putf(w, "\n#endif // %s_CONFIG_STRUCT_H\n", guard, NULL);
+        free(guard);
+    }
+}
+
+
+static void write_helpers(ConfigWriter* w, const StructPlan* plan) {
+    const int* uses = plan->usesType;
+    if (plan->usesFloatBits) {
+        put(w, "static float float_from_bits(unsigned int bits) {\n"
+            "    float value;\n    memcpy(&value, &bits, sizeof(value));\n    return value;\n}\n\n");
+    }
+    if (uses[INT] || uses[FLOAT] || uses[STRING] || uses[INT_ARRAY] || uses[FLOAT_ARRAY] || uses[STRING_ARRAY]) {
+        put(w, "static int has_type(ConfigManager* cm, const char* key, ValueType type, size_t* count) {\n"
+            "    ValueType stored;\n"
+            "    return config_value_info(cm, key, &stored, count) == 0 && stored == type;\n}\n\n");
+    }
+    if (uses[STRING] || uses[STRING_ARRAY]) {
+        put(w, "static char* copy_string(const char* str) {\n"
+            "    size_t length = strlen(str) + 1;\n"
+            "    char* copy = (char*)malloc(length);\n"
+            "    if (copy) memcpy(copy, str, length);\n"
+            "    return copy;\n}\n\n");
+    }
+    if (uses[INT]) {
+        put(w, "static void refresh_int(ConfigManager* cm, const char* key, int* field) {\n"
+            "    if (has_type(cm, key, INT, NULL)) fetch_value_by_key(cm, key, field, INT);\n}\n\n");
+    }
+    if (uses[FLOAT]) {
+        put(w, "static void refresh_float(ConfigManager* cm, const char* key, float* field) {\n"
+            "    if (has_type(cm, key, FLOAT, NULL)) fetch_value_by_key(cm, key, field, FLOAT);\n}\n\n");
+    }
+    if (uses[STRING]) {
+        put(w, "static int set_string(char** field, const char* value) {\n"
+            "    char* copy = copy_string(value);\n"
+            "    if (!copy) return -1;\n"
+            "    free(*field);\n    *field = copy;\n    return 0;\n}\n\n"
+            "static int refresh_string(ConfigManager* cm, const char* key, char** field) {\n"
+            "    char* value;\n"
+            "    if (!has_type(cm, key, STRING, NULL) || fetch_value_by_key(cm, key, &value, STRING) != 0) return 0;\n"
+            "    return set_string(field, value);\n}\n\n");
+    }
+    // int and float arrays share the shape, only the element type differs
+    static const char* const arrayTypes[2][2] = { { "int", "INT_ARRAY" }, { "float", "FLOAT_ARRAY" } };
+    for (int a = 0; a < 2; ++a) {
+        if (!uses[a == 0 ? INT_ARRAY : FLOAT_ARRAY]) continue;
+        const char* elem = arrayTypes[a][0];
+        const char* type = arrayTypes[a][1];
+        putf(w, "static int set_%ss(%s** field, size_t* count, const void* values, size_t n) {\n", elem, elem);
+        putf(w, "    %s* copy = (%s*)malloc(n * sizeof(**field) + 1);\n", elem, elem);
+        put(w, "    if (!copy) return -1;\n"
+            "    if (n > 0) memcpy(copy, values, n * sizeof(**field));\n"
+            "    free(*field);\n    *field = copy;\n    *count = n;\n    return 0;\n}\n\n");
+        putf(w, "static int refresh_%ss(ConfigManager* cm, const char* key, %s** field, size_t* count) {\n", elem, elem);
+        putf(w, "    size_t n;\n    if (!has_type(cm, key, %s, &n)) return 0;\n", type, NULL);
+        putf(w, "    %s* values = (%s*)malloc(n * sizeof(**field) + 1);\n", elem, elem);
+        putf(w, "    if (!values) return -1;\n    fetch_value_by_key(cm, key, values, %s);\n", type, NULL);
+        put(w, "    free(*field);\n    *field = values;\n    *count = n;\n    return 0;\n}\n\n");
+    }
+    if (uses[STRING_ARRAY]) {
+        put(w, "static void free_strings(char** strings, size_t n) {\n"
+            "    for (size_t i = 0; strings && i < n; ++i) free(strings[i]);\n"
+            "    free(strings);\n}\n\n"
+            "static int set_strings(char*** field, size_t* count, const char* const* values, size_t n) {\n"
+            "    char** copy = (char**)calloc(n + 1, sizeof(char*));\n"
+            "    if (!copy) return -1;\n"
+            "    for (size_t i = 0; i < n; ++i) {\n"
+            "        copy[i] = copy_string(values[i]);\n"
+            "        if (!copy[i]) {\n"
+            "            free_strings(copy, i);\n"
+            "            return -1;\n"
+            "        }\n"
+            "    }\n"
+            "    free_strings(*field, *count);\n"
+            "    *field = copy;\n    *count = n;\n    return 0;\n}\n\n"
+            "static int refresh_strings(ConfigManager* cm, const char* key, char*** field, size_t* count) {\n"
+            "    size_t n;\n"
+            "    if (!has_type(cm, key, STRING_ARRAY, &n)) return 0;\n"
+            "    char** values = (char**)malloc(n * sizeof(char*) + 1);\n"
+            "    if (!values) return -1;\n"
+            "    fetch_value_by_key(cm, key, values, STRING_ARRAY);\n"
+            "    int result = set_strings(field, count, (const char* const*)values, n);\n"
+            "    free(values);\n    return result;\n}\n\n");
+    }
+}
+
+
+// Strings longer than a literal may be are written as byte arrays before the functions, named
+// <prefix>_key_<record> for keys and <prefix>_text_<record>[_<element>] for values.
+static void put_string_name(ConfigWriter* w, const char* prefix, const char* kind, size_t record, size_t element) {
+    char buffer[64];
+    put(w, prefix);
+    put(w, "_");
+    put(w, kind);
+    if (element == CONFIG_NPOS) {
+        snprintf(buffer, sizeof(buffer), "_%zu", record);
+    }
+    else {
+        snprintf(buffer, sizeof(buffer), "_%zu_%zu", record, element);
+    }
+    put(w, buffer);
+}
+
+// str as an expression: a literal, or the name of its byte array when it is long
+static void put_string(ConfigWriter* w, const char* prefix, const char* kind, size_t record, size_t element, const char* str) {
+    if (strlen(str) <= CONFIG_MAX_C_LITERAL) {
+        config_write_c_string(w, str);
+    }
+    else {
+        put_string_name(w, prefix, kind, record, element);
+    }
+}
+
+static void put_long_string(ConfigWriter* w, const char* prefix, const char* kind, size_t record, size_t element, const char* str) {
+    if (strlen(str) <= CONFIG_MAX_C_LITERAL) {
+        return;
+    }
+    put(w, "static const char ");
+    put_string_name(w, prefix, kind, record, element);
+    put(w, "[] = ");
+    config_write_c_bytes(w, str);
+    put(w, ";\n");
+}
+
+// byte arrays for every long key and string default put_string refers to
+static void write_long_strings(ConfigWriter* w, const ConfigManager* schema, const char* prefix) {
+    for (size_t i = 0; i < schema->size; ++i) {
+        const KeyValuePair* kv = &schema->records[i];
+        put_long_string(w, prefix, "key", i, CONFIG_NPOS, kv->key);
+        if (kv->type == STRING) {
+            put_long_string(w, prefix, "text", i, CONFIG_NPOS, kv->value.stringValue);
+        }
+        for (size_t j = 0; kv->type == STRING_ARRAY && j < kv->arraySize; ++j) {
+            put_long_string(w, prefix, "text", i, j, kv->value.stringArrayValue[j]);
+        }
+    }
+}
+
+
+// static const arrays holding the array defaults, named <prefix>_default_<field>
+static void write_defaults(ConfigWriter* w, const ConfigManager* schema, const StructPlan* plan, const char* prefix) {
+    write_long_strings(w, schema, prefix);
+    for (size_t i = 0; i < schema->size; ++i) {
+        const KeyValuePair* kv = &schema->records[i];
+        if (kv->arraySize == 0 || (kv->type != INT_ARRAY && kv->type != FLOAT_ARRAY && kv->type != STRING_ARRAY)) {
+            continue;
+        }
+        // a float array with NaN or infinities is kept as bits, set_floats copies the bytes
+        int asBits = 0;
+        for (size_t j = 0; kv->type == FLOAT_ARRAY && j < kv->arraySize; ++j) {
+            if (!float_is_literal(kv->value.floatArrayValue[j])) asBits = 1;
+        }
+        put(w, kv->type == INT_ARRAY ? "static const int " : kv->type == STRING_ARRAY ? "static const char* const "
+            : asBits ? "static const unsigned int " : "static const float ");
+        putf(w, "%s_default_%s[] = {", prefix, plan->fields[i]);
+        for (size_t j = 0; j < kv->arraySize; ++j) {
+            put(w, j % 8 == 0 ? "\n    " : " ");
+            if (kv->type == INT_ARRAY) {
+                put_int(w, kv->value.intArrayValue[j]);
+            }
+            else if (kv->type == STRING_ARRAY) {
+                put_string(w, prefix, "text", i, j, kv->value.stringArrayValue[j]);
+            }
+            else if (asBits) {
+                char buffer[16];
+                unsigned int bits;
+                memcpy(&bits, &kv->value.floatArrayValue[j], 4);
+                snprintf(buffer, sizeof(buffer), "0x%08Xu", bits);
+                put(w, buffer);
+            }
+            else {
+                put_float(w, kv->value.floatArrayValue[j]);
+            }
+            put(w, ",");
+        }
+        put(w, "\n};\n");
+    }
+}
+
+
+// "    if (set_x(&cfg->field, ...) != 0) goto fail;" for one default
+static void write_init_field(ConfigWriter* w, const KeyValuePair* kv, size_t record, const char* field, const char* prefix) {
+    switch (kv->type) {
+    case INT:
+        putf(w, "    cfg->%s = ", field, NULL);
+        put_int(w, kv->value.intValue);
+        put(w, ";\n");
+        return;
+    case FLOAT:
+        putf(w, "    cfg->%s = ", field, NULL);
+        put_float(w, kv->value.floatValue);
+        put(w, ";\n");
+        return;
+    case STRING:
+        putf(w, "    if (set_string(&cfg->%s, ", field, NULL);
+        put_string(w, prefix, "text", record, CONFIG_NPOS, kv->value.stringValue);
+        put(w, ") != 0) goto fail;\n");
+        return;
+    default: {
+        const char* setter = kv->type == INT_ARRAY ? "ints" : kv->type == FLOAT_ARRAY ? "floats" : "strings";
+        putf(w, "    if (set_%s(&cfg->%s, ", setter, field);
+        putf(w, "&cfg->%s_count, ", field, NULL);
+        if (kv->arraySize == 0) {
+            put(w, "NULL");
+        }
+        else {
+            putf(w, "%s_default_%s", prefix, field);
+        }
+        char buffer[48];
+        snprintf(buffer, sizeof(buffer), ", %zu) != 0) goto fail;\n", kv->arraySize);
+        put(w, buffer);
+        return;
+    }
+    }
+}
+
+
+static void write_source(ConfigWriter* w, const ConfigManager* schema, const StructPlan* plan,
+    const char* structName, const char* prefix, const char* headerName) {
+    put(w, "// Generated by generate_config_struct, do not edit.\n#include \"");
+    put(w, headerName);
+    put(w, "\"\n#include <stdlib.h>\n#include <string.h>\n\n");
+
+    write_helpers(w, plan);
+    write_defaults(w, schema, plan, prefix);
+
+    int canFail = plan->usesType[STRING] || plan->usesType[INT_ARRAY] || plan->usesType[FLOAT_ARRAY] || plan->usesType[STRING_ARRAY];
+    putf(w, "\nint %s_init(%s* cfg) {\n    memset(cfg, 0, sizeof(*cfg));\n", prefix, structName);
+    for (size_t i = 0; i < schema->size; ++i) {
+        write_init_field(w, &schema->records[i], i, plan->fields[i], prefix);
+    }
+    put(w, "    return 0;\n");
+    if (canFail) {
+        putf(w, "fail:\n    %s_free(cfg);\n    return -1;\n", prefix, NULL);
+    }
+    put(w, "}\n\n");
+
+    putf(w, "int %s_refresh(%s* cfg, ConfigManager* cm) {\n    int result = 0;\n", prefix, structName);
+    for (size_t i = 0; i < schema->size; ++i) {
+        const KeyValuePair* kv = &schema->records[i];
+        const char* field = plan->fields[i];
+        switch (kv->type) {
+        case INT:
+        case FLOAT:
+            put(w, kv->type == INT ? "    refresh_int(cm, " : "    refresh_float(cm, ");
+            put_string(w, prefix, "key", i, CONFIG_NPOS, kv->key);
+            putf(w, ", &cfg->%s);\n", field, NULL);
+            break;
+        case STRING:
+            put(w, "    if (refresh_string(cm, ");
+            put_string(w, prefix, "key", i, CONFIG_NPOS, kv->key);
+            putf(w, ", &cfg->%s) != 0) result = -1;\n", field, NULL);
+            break;
+        default:
+            put(w, kv->type == INT_ARRAY ? "    if (refresh_ints(cm, " : kv->type == FLOAT_ARRAY ? "    if (refresh_floats(cm, "
+                : "    if (refresh_strings(cm, ");
+            put_string(w, prefix, "key", i, CONFIG_NPOS, kv->key);
+            putf(w, ", &cfg->%s, &cfg->%s_count) != 0) result = -1;\n", field, field);
+            break;
+        }
+    }
+    if (schema->size == 0) {
+        put(w, "    (void)cfg;\n    (void)cm;\n");
+    }
+    put(w, "    return result;\n}\n\n");
+
+    putf(w, "int %s_load(%s* cfg, ConfigManager* cm) {\n", prefix, structName);
+    putf(w, "    if (%s_init(cfg) != 0) return -1;\n    return %s_refresh(cfg, cm);\n}\n\n", prefix, prefix);
+
+    putf(w, "int %s_load_file(%s* cfg, const char* filename) {\n", prefix, structName);
+    putf(w, "    if (%s_init(cfg) != 0) return -1;\n", prefix, NULL);
+    put(w, "    ConfigManager* cm = create_config_manager();\n"
+        "    if (!cm) return -1;\n"
+        "    int result = load_config_from_file(cm, filename);\n");
+    putf(w, "    if (result == 0) result = %s_refresh(cfg, cm);\n", prefix, NULL);
+    put(w, "    free_config_manager(cm);\n    return result;\n}\n\n");
+
+    putf(w, "void %s_free(%s* cfg) {\n", prefix, structName);
+    for (size_t i = 0; i < schema->size; ++i) {
+        ValueType type = schema->records[i].type;
+        if (type == STRING || type == INT_ARRAY || type == FLOAT_ARRAY) {
+            putf(w, "    free(cfg->%s);\n", plan->fields[i], NULL);
+        }
+        else if (type == STRING_ARRAY) {
+            putf(w, "    free_strings(cfg->%s, cfg->%s_count);\n", plan->fields[i], plan->fields[i]);
+        }
+    }
+    put(w, "    memset(cfg, 0, sizeof(*cfg));\n}\n");
+}
+
+
+// Write one generated file. return 0 on success, -1 on error.
+static int write_file(const char* filename, const ConfigManager* schema, const StructPlan* plan,
+    const char* structName, const char* prefix, const char* headerName) {
+    int fd = config_file_open_write(filename, 0);
+    ConfigWriter* w = fd >= 0 ? (ConfigWriter*)malloc(sizeof(ConfigWriter)) : NULL;
+    int result = -1;
+    if (w) {
+        config_writer_init(w, config_fd_write, &fd, 0);
+        if (headerName) {
+            write_source(w, schema, plan, structName, prefix, headerName);
+        }
+        else {
+            write_header(w, schema, plan, structName, prefix);
+        }
+        result = config_writer_flush(w);
+        free(w);
+    }
+    if (fd >= 0 && config_fd_close(fd) != 0) {
+        result = -1;
+    }
+    if (result != 0) {
+        printf("Error writing file: %s\n", filename);
+    }
+    return result;
+}
+
+
+// Generate a typed settings struct from a schema
+int generate_config_struct(ConfigManager* schema, const char* structName, const char* prefix,
+    const char* headerFile, const char* sourceFile) {
+    if (!schema || !structName || !prefix || !headerFile || !sourceFile || config_bulk_resolve(schema) != 0) {
+        return -1;
+    }
+    if (!is_c_identifier(structName) || !is_c_identifier(prefix)) {
+        printf("Error: struct name and prefix must be C identifiers.\n");
+        return -1;
+    }
+
+    StructPlan plan;
+    if (plan_struct(&plan, schema) != 0) {
+        printf("Memory allocation for struct fields failed.\n");
+        plan_free(&plan);
+        return -1;
+    }
+
+    // the source includes the header by its file name, both are expected in the same directory
+    const char* headerName = headerFile;
+    for (const char* p = headerFile; *p; ++p) {
+        if (*p == '/' || *p == '\\') headerName = p + 1;
+    }
+    int result = write_file(headerFile, schema, &plan, structName, prefix, NULL);
+    if (result == 0) {
+        result = write_file(sourceFile, schema, &plan, structName, prefix, headerName);
+    }
+    plan_free(&plan);
+    return result;
+}
@@ -0,0 +1,535 @@
+#include "zhaoba_config_internal.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Compressed configuration files.
+//
+// A compressed file is CONFIG_COMPRESSED_MAGIC followed by independent blocks of at most LZ_BLOCK_SIZE
+// raw bytes, each behind a 12-byte header:
+//      u32 raw length, u32 packed length (high bit set when the block is stored uncompressed), u32 Adler-32 of the raw bytes
+// and closed by a header of zeros. Blocks use a small LZ77 format in the style of LZ4:
+//      token (literal count << 4 | match length - 4), extra literal count bytes, literals,
+//      u16 match offset, extra match length bytes
+// where a nibble of 15 continues in following bytes of 255 until a smaller one. The last sequence of
+// a block has literals only. Matches never reach outside their block, so every block decodes alone
+// and a reader only ever holds one of them.
+
+#define LZ_BLOCK_SIZE 65536
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 13
+#define LZ_STORED_FLAG 0x80000000u
+#define LZ_BLOCK_HEADER_SIZE 12
+// worst case of an incompressible block plus its sequence overhead
+#define LZ_PACKED_CAPACITY (LZ_BLOCK_SIZE + LZ_BLOCK_SIZE / 255 + 64)
+
+
+static void put_u32(unsigned char* out, uint32_t v) {
+    out[0] = (unsigned char)v;
+    out[1] = (unsigned char)(v >> 8);
+    out[2] = (unsigned char)(v >> 16);
+    out[3] = (unsigned char)(v >> 24);
+}
+
+
+static uint32_t get_u32(const unsigned char* in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+
+static uint32_t read32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+
+static uint32_t adler32(const unsigned char* data, size_t length) {
+    uint32_t a = 1, b = 0;
+    while (length > 0) {
+        size_t run = length < 5552 ? length : 5552;  // largest run before b can overflow
+        length -= run;
+        for (; run > 0; --run) {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+
+// a length nibble of 15 continues in bytes of 255 and a final smaller byte
+static unsigned char* put_length(unsigned char* op, size_t length) {
+    for (; length >= 255; length -= 255) {
+        *op++ = 255;
+    }
+    *op++ = (unsigned char)length;
+    return op;
+}
+
+
+// Emit one sequence. matchLength 0 marks the final literals-only sequence.
+// return the new output position, or NULL if it would pass outEnd.
+static unsigned char* emit_sequence(unsigned char* op, unsigned char* outEnd, const unsigned char* literals, size_t literalCount, size_t offset, size_t matchLength) {
+    if ((size_t)(outEnd - op) < 1 + literalCount / 255 + 1 + literalCount + 2 + matchLength / 255 + 1) {
+        return NULL;
+    }
+    size_t matchCode = matchLength ? matchLength - LZ_MIN_MATCH : 0;
+    unsigned char* token = op++;
+    *token = (unsigned char)(((literalCount < 15 ? literalCount : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+    if (literalCount >= 15) {
+        op = put_length(op, literalCount - 15);
+    }
+    memcpy(op, literals, literalCount);
+    op += literalCount;
+    if (matchLength) {
+        *op++ = (unsigned char)offset;
+        *op++ = (unsigned char)(offset >> 8);
+        if (matchCode >= 15) {
+            op = put_length(op, matchCode - 15);
+        }
+    }
+    return op;
+}
+
+
+// Greedy LZ77 over one block. return the packed size, or 0 if it would not be smaller than the input.
+static size_t lz_compress(const unsigned char* in, size_t length, unsigned char* out, uint32_t* table) {
+    memset(table, 0, sizeof(uint32_t) << LZ_HASH_BITS);
+    unsigned char* op = out;
+    unsigned char* outEnd = out + length;
+    size_t anchor = 0;
+    size_t pos = 0;
+
+    while (pos + LZ_MIN_MATCH <= length) {
+        uint32_t sequence = read32(in + pos);
+        uint32_t slot = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+        size_t candidate = table[slot];  // position + 1, 0 when empty
+        table[slot] = (uint32_t)(pos + 1);
+
+        if (candidate == 0 || read32(in + candidate - 1) != sequence) {
+            pos++;
+            continue;
+        }
+        size_t match = candidate - 1;
+        size_t matchLength = LZ_MIN_MATCH;
+        while (pos + matchLength < length && in[match + matchLength] == in[pos + matchLength]) {
+            matchLength++;
+        }
+        op = emit_sequence(op, outEnd, in + anchor, pos - anchor, pos - match, matchLength);
+        if (!op) {
+            return 0;
+        }
+        pos += matchLength;
+        anchor = pos;
+    }
+
+    op = emit_sequence(op, outEnd, in + anchor, length - anchor, 0, 0);
+    return op ? (size_t)(op - out) : 0;
+}
+
+
+// Bounds-checked decoder. return 0 when in decodes to exactly rawLength bytes, -1 on corrupt input.
+static int lz_decompress(const unsigned char* in, size_t packedLength, unsigned char* out, size_t rawLength) {
+    size_t ip = 0;
+    size_t op = 0;
+    while (ip < packedLength) {
+        unsigned int token = in[ip++];
+        size_t literalCount = token >> 4;
+        if (literalCount == 15) {
+            unsigned char b;
+            do {
+                if (ip >= packedLength) return -1;
+                b = in[ip++];
+                literalCount += b;
+            } while (b == 255);
+        }
+        if (literalCount > packedLength - ip || literalCount > rawLength - op) {
+            return -1;
+        }
+        memcpy(out + op, in + ip, literalCount);
+        ip += literalCount;
+        op += literalCount;
+        if (ip == packedLength) {
+            break;  // final literals-only sequence
+        }
+
+        if (packedLength - ip < 2) {
+            return -1;
+        }
+        size_t offset = (size_t)in[ip] | ((size_t)in[ip + 1] << 8);
+        ip += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15) {
+            unsigned char b;
+            do {
+                if (ip >= packedLength) return -1;
+                b = in[ip++];
+                matchLength += b;
+            } while (b == 255);
+        }
+        matchLength += LZ_MIN_MATCH;
+        if (offset == 0 || offset > op || matchLength > rawLength - op) {
+            return -1;
+        }
+
+        unsigned char* dest = out + op;
+        const unsigned char* source = dest - offset;
+        if (offset >= matchLength) {
+            memcpy(dest, source, matchLength);
+        }
+        else {
+            for (size_t i = 0; i < matchLength; ++i) {
+                dest[i] = source[i];  // overlapping run
+            }
+        }
+        op += matchLength;
+    }
+    return op == rawLength ? 0 : -1;
+}
+
+
+// Validate a block header. return the raw length, 0 for the end marker, -1 if malformed.
+static long parse_block_header(const unsigned char* header, uint32_t* packedLength, int* stored) {
+    uint32_t rawLength = get_u32(header);
+    uint32_t packed = get_u32(header + 4);
+    *stored = (packed & LZ_STORED_FLAG) != 0;
+    *packedLength = packed & ~LZ_STORED_FLAG;
+    if (rawLength == 0) {
+        return packed == 0 && get_u32(header + 8) == 0 ? 0 : -1;
+    }
+    if (rawLength > LZ_BLOCK_SIZE || *packedLength > LZ_PACKED_CAPACITY || (*stored && *packedLength != rawLength)) {
+        return -1;
+    }
+    return (long)rawLength;
+}
+
+
+// Decode one block and verify its checksum. return 0 on success, -1 on corrupt input.
+static int decode_block(const unsigned char* header, const unsigned char* packed, uint32_t packedLength, int stored, unsigned char* out, size_t rawLength) {
+    if (stored) {
+        memcpy(out, packed, rawLength);
+    }
+    else if (lz_decompress(packed, packedLength, out, rawLength) != 0) {
+        return -1;
+    }
+    return adler32(out, rawLength) == get_u32(header + 8) ? 0 : -1;
+}
+
+
+// ---- save side ----
+
+// ConfigWriteCallback that compresses everything passing through into blocks for the next callback
+struct ConfigCompressor {
+    ConfigWriteCallback write;
+    void* context;
+    int failed;
+    size_t used;
+    uint32_t table[1 << LZ_HASH_BITS];
+    unsigned char raw[LZ_BLOCK_SIZE];
+    unsigned char packed[LZ_BLOCK_HEADER_SIZE + LZ_PACKED_CAPACITY];
+};
+
+
+static void emit_block(ConfigCompressor* c) {
+    if (c->used == 0 || c->failed) {
+        return;
+    }
+    unsigned char* body = c->packed + LZ_BLOCK_HEADER_SIZE;
+    size_t packedLength = lz_compress(c->raw, c->used, body, c->table);
+    uint32_t lengthField = (uint32_t)packedLength;
+    if (packedLength == 0) {
+        memcpy(body, c->raw, c->used);
+        packedLength = c->used;
+        lengthField = (uint32_t)c->used | LZ_STORED_FLAG;
+    }
+    put_u32(c->packed, (uint32_t)c->used);
+    put_u32(c->packed + 4, lengthField);
+    put_u32(c->packed + 8, adler32(c->raw, c->used));
+    if (c->write(c->context, (const char*)c->packed, LZ_BLOCK_HEADER_SIZE + packedLength) != 0) {
+        c->failed = 1;
+    }
+    c->used = 0;
+}
+
+
+ConfigCompressor* config_compressor_create(ConfigWriteCallback write, void* context) {
+    ConfigCompressor* c = (ConfigCompressor*)malloc(sizeof(ConfigCompressor));
+    if (!c) {
+        printf("Memory allocation for compressor failed.\n");
+        return NULL;
+    }
+    c->write = write;
+    c->context = context;
+    c->used = 0;
+    c->failed = write(context, CONFIG_COMPRESSED_MAGIC, CONFIG_COMPRESSED_MAGIC_SIZE) != 0;
+    return c;
+}
+
+
+int config_compressor_write(void* context, const char* data, size_t length) {
+    ConfigCompressor* c = (ConfigCompressor*)context;
+    while (length > 0 && !c->failed) {
+        size_t take = LZ_BLOCK_SIZE - c->used;
+        if (take > length) {
+            take = length;
+        }
+        memcpy(c->raw + c->used, data, take);
+        c->used += take;
+        data += take;
+        length -= take;
+        if (c->used == LZ_BLOCK_SIZE) {
+            emit_block(c);
+        }
+    }
+    return c->failed ? -1 : 0;
+}
+
+
+int config_compressor_finish(ConfigCompressor* c) {
+    emit_block(c);
+    unsigned char end[LZ_BLOCK_HEADER_SIZE] = { 0 };
+    if (!c->failed && c->write(c->context, (const char*)end, sizeof(end)) != 0) {
+        c->failed = 1;
+    }
+    int result = c->failed ? -1 : 0;
+    free(c);
+    return result;
+}
+
+
+// ---- load side ----
+
+int config_is_compressed(const char* data, size_t size) {
+    return size >= CONFIG_COMPRESSED_MAGIC_SIZE && memcmp(data, CONFIG_COMPRESSED_MAGIC, CONFIG_COMPRESSED_MAGIC_SIZE) == 0;
+}
+
+
+int config_file_is_compressed(const char* filename) {
+    char magic[CONFIG_COMPRESSED_MAGIC_SIZE];
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        return 0;
+    }
+    size_t got = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+    return config_is_compressed(magic, got);
+}
+
+
+// Inflate a whole compressed image held in memory
+char* config_inflate(const char* data, size_t size, size_t* sizeOut) {
+    const unsigned char* p = (const unsigned char*)data + CONFIG_COMPRESSED_MAGIC_SIZE;
+    const unsigned char* end = (const unsigned char*)data + size;
+    size_t capacity = size * 4 + 1;
+    size_t used = 0;
+    char* out = (char*)malloc(capacity);
+
+    while (out) {
+        uint32_t packedLength;
+        int stored;
+        const unsigned char* header = p;
+        long rawLength = (size_t)(end - p) >= LZ_BLOCK_HEADER_SIZE ? parse_block_header(header, &packedLength, &stored) : -1;
+        if (rawLength == 0) {
+            out[used] = '\0';
+            *sizeOut = used;
+            return out;
+        }
+        p += LZ_BLOCK_HEADER_SIZE;
+        if (rawLength < 0 || (size_t)(end - p) < packedLength) {
+            break;
+        }
+        if (used + (size_t)rawLength + 1 > capacity) {
+            while (used + (size_t)rawLength + 1 > capacity) {
+                capacity *= 2;
+            }
+            char* grown = (char*)realloc(out, capacity);
+            if (!grown) {
+                break;
+            }
+            out = grown;
+        }
+        if (decode_block(header, p, packedLength, stored, (unsigned char*)out + used, (size_t)rawLength) != 0) {
+            break;
+        }
+        used += (size_t)rawLength;
+        p += packedLength;
+    }
+
+    printf("Error decompressing data: corrupt or truncated input.\n");
+    free(out);
+    return NULL;
+}
+
+
+// Sliding window of decompressed text over a compressed file. Only the unparsed tail is kept;
+// it grows when a single record spans more than what has been decoded so far.
+typedef struct InflateWindow {
+    FILE* file;
+    char* text;
+    size_t capacity;
+    size_t pos;
+    size_t end;
+    int finished;
+    unsigned char packed[LZ_PACKED_CAPACITY];
+} InflateWindow;
+
+
+// Decode the next block onto the end of the window. return 1 when text was added, 0 at the end, -1 on error.
+static int window_refill(InflateWindow* w) {
+    if (w->finished) {
+        return 0;
+    }
+    if (w->pos > 0) {
+        memmove(w->text, w->text + w->pos, w->end - w->pos);
+        w->end -= w->pos;
+        w->pos = 0;
+    }
+
+    unsigned char header[LZ_BLOCK_HEADER_SIZE];
+    uint32_t packedLength;
+    int stored;
+    long rawLength = fread(header, 1, sizeof(header), w->file) == sizeof(header) ? parse_block_header(header, &packedLength, &stored) : -1;
+    if (rawLength == 0) {
+        w->finished = 1;
+        return 0;
+    }
+    if (rawLength < 0 || fread(w->packed, 1, packedLength, w->file) != packedLength) {
+        return -1;
+    }
+
+    if (w->end + (size_t)rawLength + 1 > w->capacity) {
+        size_t capacity = w->capacity ? w->capacity : 2 * LZ_BLOCK_SIZE;
+        while (w->end + (size_t)rawLength + 1 > capacity) {
+            capacity *= 2;
+        }
+        char* grown = (char*)realloc(w->text, capacity);
+        if (!grown) {
+            return -1;
+        }
+        w->text = grown;
+        w->capacity = capacity;
+    }
+    if (decode_block(header, w->packed, packedLength, stored, (unsigned char*)w->text + w->end, (size_t)rawLength) != 0) {
+        return -1;
+    }
+    w->end += (size_t)rawLength;
+    w->text[w->end] = '\0';
+    return 1;
+}
+
+
+static int is_json_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+
+// Skip whitespace, refilling as needed. return the next character, 0 at the end of input, -1 on error.
+static int window_peek(InflateWindow* w) {
+    for (;;) {
+        while (w->pos < w->end && is_json_space(w->text[w->pos])) {
+            w->pos++;
+        }
+        if (w->pos < w->end) {
+            return (unsigned char)w->text[w->pos];
+        }
+        int refilled = window_refill(w);
+        if (refilled <= 0) {
+            return refilled;
+        }
+    }
+}
+
+
+// Parse the next record of the top-level array from the window.
+// return the parsed item, or NULL on a parse or decompression error.
+static cJSON* window_parse_record(InflateWindow* w) {
+    for (;;) {
+        size_t available = w->end - w->pos;
+        const char* parseEnd = NULL;
+        cJSON* item = cJSON_ParseWithLengthOpts(w->text + w->pos, available, &parseEnd, 0);
+        // a value that ends exactly at the end of the window may continue in the next block
+        if (item && (parseEnd < w->text + w->end || w->finished)) {
+            w->pos = (size_t)(parseEnd - w->text);
+            return item;
+        }
+        cJSON_Delete(item);
+        if (w->finished) {
+            printf("Error parsing JSON: %.40s\n", w->text + w->pos);
+            return NULL;
+        }
+
+        // decode until the unparsed text has doubled, so a huge record is retried a logarithmic number of times
+        size_t target = available * 2 + 1;
+        int refilled;
+        do {
+            refilled = window_refill(w);
+        } while (refilled > 0 && w->end - w->pos < target);
+        if (refilled < 0) {
+            printf("Error decompressing data: corrupt or truncated input.\n");
+            return NULL;
+        }
+    }
+}
+
+
+// Load a compressed file, parsing records as blocks are decompressed
+int config_load_compressed(ConfigManager* cm, const char* filename) {
+    InflateWindow* w = (InflateWindow*)calloc(1, sizeof(InflateWindow));
+    if (!w) {
+        return -1;
+    }
+    w->file = fopen(filename, "rb");
+    char magic[CONFIG_COMPRESSED_MAGIC_SIZE];
+    if (!w->file || fread(magic, 1, sizeof(magic), w->file) != sizeof(magic) || !config_is_compressed(magic, sizeof(magic))) {
+        printf("Error opening file: %s\n", filename);
+        if (w->file) fclose(w->file);
+        free(w);
+        return -1;
+    }
+
+    int bulk = begin_config_bulk_load(cm) == 0;
+    size_t mark = cm->size;
+    int error = window_peek(w) != '[';
+    if (!error) {
+        w->pos++;
+        int c = window_peek(w);
+        while (c > 0 && c != ']') {
+            cJSON* item = window_parse_record(w);
+            if (!item) {
+                error = 1;
+                break;
+            }
+            KeyValuePair kv;
+            if (config_record_from_json(item, &kv) == 0) {
+                config_put_record(cm, &kv);
+            }
+            cJSON_Delete(item);
+
+            c = window_peek(w);
+            if (c == ',') {
+                w->pos++;
+                c = window_peek(w);
+            }
+            else if (c != ']') {
+                c = -1;
+            }
+        }
+        error = error || c != ']';
+    }
+    if (error) {
+        // in bulk mode the records of this file are still an unchecked tail, drop them all
+        printf("Error loading compressed file: %s\n", filename);
+        while (cm->size > mark) {
+            free_key_value_pair(&cm->records[--cm->size]);
+        }
+    }
+    int result = bulk ? end_config_bulk_load(cm) : 0;
+
+    fclose(w->file);
+    free(w->text);
+    free(w);
+    return error ? -1 : result;
+}
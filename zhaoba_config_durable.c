@@ -0,0 +1,400 @@
+#include "zhaoba_config_internal.h"
+#include "zhaoba_config_thread.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <process.h>
+#else
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+// descriptors are opened close-on-exec where the platform can, so a fork+exec does not inherit them
+#if !defined(_WIN32) && !defined(O_CLOEXEC)
+#define O_CLOEXEC 0
+#endif
+
+
+// Low-level file helpers shared by the durable save paths
+
+
+int config_file_open_write(const char* path, int binary) {
+#ifdef _WIN32
+    // text mode unless binary, so the bytes match save_config_to_file's fopen(filename, "w")
+    return _open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | (binary ? _O_BINARY : _O_TEXT), _S_IREAD | _S_IWRITE);
+#else
+    (void)binary;
+    return open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+}
+
+
+int config_file_open_append(const char* path) {
+#ifdef _WIN32
+    return _open(path, _O_WRONLY | _O_APPEND | _O_BINARY);
+#else
+    return open(path, O_WRONLY | O_APPEND | O_CLOEXEC);
+#endif
+}
+
+
+int config_fd_write(void* context, const char* data, size_t length) {
+    int fd = *(int*)context;
+    while (length > 0) {
+#ifdef _WIN32
+        unsigned int chunk = length > 0x40000000u ? 0x40000000u : (unsigned int)length;
+        int written = _write(fd, data, chunk);
+#else
+        ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR) continue;
+#endif
+        if (written <= 0) {
+            return -1;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+
+int config_fd_writev(int fd, const ConfigBytes* parts, size_t count) {
+#ifdef _WIN32
+    for (size_t i = 0; i < count; ++i) {
+        if (config_fd_write(&fd, parts[i].data, parts[i].length) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+#else
+    struct iovec vectors[16];   // the POSIX minimum for IOV_MAX
+    size_t next = 0;     // first part not yet handed to writev
+    size_t offset = 0;   // bytes of parts[next] already written
+    while (next < count) {
+        int n = 0;
+        for (size_t i = next; i < count && n < 16; ++i, ++n) {
+            vectors[n].iov_base = (void*)(parts[i].data + (i == next ? offset : 0));
+            vectors[n].iov_len = parts[i].length - (i == next ? offset : 0);
+        }
+        ssize_t written = writev(fd, vectors, n);
+        if (written < 0 && errno == EINTR) continue;
+        if (written < 0) {
+            return -1;
+        }
+        // advance past what the kernel took, a short write resumes mid-part
+        size_t left = (size_t)written;
+        while (next < count && left >= parts[next].length - offset) {
+            left -= parts[next].length - offset;
+            offset = 0;
+            ++next;
+        }
+        offset += left;
+        if (written == 0 && next < count && parts[next].length > offset) {
+            return -1;
+        }
+    }
+    return 0;
+#endif
+}
+
+
+int config_fd_sync(int fd) {
+#ifdef _WIN32
+    return _commit(fd) == 0 ? 0 : -1;
+#else
+    return fsync(fd) == 0 ? 0 : -1;
+#endif
+}
+
+
+int config_fd_close(int fd) {
+#ifdef _WIN32
+    return _close(fd) == 0 ? 0 : -1;
+#else
+    return close(fd) == 0 ? 0 : -1;
+#endif
+}
+
+
+long long config_file_size(const char* path) {
+#ifdef _WIN32
+    struct _stat64 st;
+    return _stat64(path, &st) == 0 ? (long long)st.st_size : -1;
+#else
+    struct stat st;
+    return stat(path, &st) == 0 ? (long long)st.st_size : -1;
+#endif
+}
+
+
+void config_file_stamp(const char* path, ConfigFileStamp* stamp) {
+    memset(stamp, 0, sizeof(*stamp));
+#ifdef _WIN32
+    // the handle is opened for attributes only, sharing everything, so it never blocks a writer
+    HANDLE file = CreateFileA(path, FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    BY_HANDLE_FILE_INFORMATION info;
+    if (GetFileInformationByHandle(file, &info)) {
+        stamp->exists = 1;
+        stamp->size = (long long)(((unsigned long long)info.nFileSizeHigh << 32) | info.nFileSizeLow);
+        stamp->mtimeNs = (long long)((((unsigned long long)info.ftLastWriteTime.dwHighDateTime << 32)
+            | info.ftLastWriteTime.dwLowDateTime) * 100);
+        stamp->fileId = ((unsigned long long)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+        stamp->device = info.dwVolumeSerialNumber;
+    }
+    CloseHandle(file);
+#else
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return;
+    }
+    stamp->exists = 1;
+    stamp->size = (long long)st.st_size;
+#if defined(__APPLE__)
+    stamp->mtimeNs = (long long)st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+    stamp->mtimeNs = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+    stamp->fileId = (unsigned long long)st.st_ino;
+    stamp->device = (unsigned long long)st.st_dev;
+#endif
+}
+
+
+int config_file_stamp_equal(const ConfigFileStamp* a, const ConfigFileStamp* b) {
+    return a->exists && b->exists
+        && a->size == b->size
+        && a->mtimeNs == b->mtimeNs
+        && a->fileId == b->fileId
+        && a->device == b->device;
+}
+
+
+int config_replace_file(const char* source, const char* target) {
+#ifdef _WIN32
+    return MoveFileExA(source, target, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? 0 : -1;
+#else
+    return rename(source, target) == 0 ? 0 : -1;
+#endif
+}
+
+
+// Make a rename in the directory of path durable. Windows has no directory handle to flush,
+// MOVEFILE_WRITE_THROUGH already covers it there.
+int config_sync_parent_dir(const char* path) {
+#ifdef _WIN32
+    (void)path;
+    return 0;
+#else
+    char* dir = _strdup(path);
+    if (!dir) {
+        return -1;
+    }
+    char* slash = strrchr(dir, '/');
+    if (slash == dir) {
+        slash[1] = '\0';
+    }
+    else if (slash) {
+        *slash = '\0';
+    }
+    else {
+        strcpy(dir, ".");
+    }
+
+    int fd = open(dir, O_RDONLY | O_CLOEXEC);
+    free(dir);
+    if (fd < 0) {
+        return -1;
+    }
+    int result = fsync(fd) == 0 ? 0 : -1;
+    close(fd);
+    return result;
+#endif
+}
+
+
+// One atomic save waiting for its commit. Lives on the saving thread's stack until done is set.
+//
+// Saves that arrive while another thread is committing queue up here, and the next committer takes
+// the whole queue (group commit): for each target only the newest temp file is synced and renamed,
+// older ones for the same target already hold stale content and are dropped without a sync.
+// Before taking the queue a committer holds a short commit window while other saves are still being
+// serialized, so saves started moments apart join one batch; with no other save in progress it commits
+// at once and a lone save pays no delay.
+typedef struct PendingCommit {
+    char* tempPath;
+    const char* target;
+    int fd;
+    int superseded;
+    int done;
+    int result;
+    struct PendingCommit* next;
+} PendingCommit;
+
+// the commit window: up to COMMIT_WINDOW_SLICES waits of COMMIT_WINDOW_SLICE_MS for saves being serialized
+#define COMMIT_WINDOW_SLICE_MS 2
+#define COMMIT_WINDOW_SLICES 5
+
+static config_mutex_t commitLock = CONFIG_MUTEX_INITIALIZER;
+static config_cond_t commitDone = CONFIG_COND_INITIALIZER;
+static config_cond_t commitQueued = CONFIG_COND_INITIALIZER;
+static PendingCommit* commitQueue = NULL;
+static PendingCommit** commitQueueTail = &commitQueue;
+static int committerActive = 0;
+static size_t commitWriters = 0;   // saves serializing their temp file, not queued yet
+static unsigned long tempCounter = 0;
+
+
+// Sync, rename and directory-sync one batch. Runs without commitLock held.
+static void commit_batch(PendingCommit* batch) {
+    for (PendingCommit* entry = batch; entry; entry = entry->next) {
+        entry->superseded = 0;
+        for (PendingCommit* later = entry->next; later && !entry->superseded; later = later->next) {
+            entry->superseded = strcmp(later->target, entry->target) == 0;
+        }
+    }
+
+    for (PendingCommit* entry = batch; entry; entry = entry->next) {
+        if (entry->superseded) {
+            config_fd_close(entry->fd);
+            remove(entry->tempPath);
+            continue;
+        }
+
+        int result = config_fd_sync(entry->fd);
+        if (config_fd_close(entry->fd) != 0) {
+            result = -1;
+        }
+        if (result == 0 && config_replace_file(entry->tempPath, entry->target) != 0) {
+            result = -1;
+        }
+        if (result == 0 && config_sync_parent_dir(entry->target) != 0) {
+            result = -1;
+        }
+        if (result != 0) {
+            printf("Error committing file: %s\n", entry->target);
+            remove(entry->tempPath);
+        }
+        entry->result = result;
+    }
+
+    // a superseded save succeeds or fails with the newest save of the same file
+    for (PendingCommit* entry = batch; entry; entry = entry->next) {
+        for (PendingCommit* later = entry->next; entry->superseded && later; later = later->next) {
+            if (!later->superseded && strcmp(later->target, entry->target) == 0) {
+                entry->result = later->result;
+            }
+        }
+    }
+}
+
+
+// Unique sibling path for writing filename's replacement: <filename>.tmp.<pid>.<sequence>
+char* config_temp_path(const char* filename) {
+    char* path = (char*)malloc(strlen(filename) + 48);
+    if (!path) {
+        return NULL;
+    }
+
+    config_mutex_lock(&commitLock);
+    unsigned long sequence = ++tempCounter;
+    config_mutex_unlock(&commitLock);
+#ifdef _WIN32
+    sprintf(path, "%s.tmp.%d.%lu", filename, _getpid(), sequence);
+#else
+    sprintf(path, "%s.tmp.%d.%lu", filename, (int)getpid(), sequence);
+#endif
+    return path;
+}
+
+
+// Atomic, durable save through a temp file and the group commit queue
+int config_save_atomic(ConfigManager* cm, const char* filename, unsigned int flags) {
+    if (!cm || !filename) {
+        return -1;
+    }
+
+    PendingCommit entry;
+    entry.target = filename;
+    entry.superseded = 0;
+    entry.done = 0;
+    entry.result = -1;
+    entry.next = NULL;
+    entry.tempPath = config_temp_path(filename);
+    if (!entry.tempPath) {
+        return -1;
+    }
+
+    config_mutex_lock(&commitLock);
+    commitWriters++;
+    config_mutex_unlock(&commitLock);
+
+    // serialize outside the lock, only the sync is shared
+    int written = 0;
+    entry.fd = config_file_open_write(entry.tempPath, (flags & CONFIG_SAVE_COMPRESSED) != 0);
+    if (entry.fd < 0) {
+        printf("Error opening file: %s\n", entry.tempPath);
+    }
+    else if (save_config_to_stream(cm, config_fd_write, &entry.fd, flags) != 0) {
+        printf("Error writing file: %s\n", entry.tempPath);
+        config_fd_close(entry.fd);
+        remove(entry.tempPath);
+    }
+    else {
+        written = 1;
+    }
+
+    config_mutex_lock(&commitLock);
+    commitWriters--;
+    if (written) {
+        *commitQueueTail = &entry;
+        commitQueueTail = &entry.next;
+    }
+    config_cond_broadcast(&commitQueued);
+    while (written && !entry.done) {
+        if (committerActive) {
+            config_cond_wait(&commitDone, &commitLock);
+            continue;
+        }
+
+        // commit window: let saves that are still serializing join this batch
+        committerActive = 1;
+        for (int slice = 0; slice < COMMIT_WINDOW_SLICES && commitWriters > 0; ++slice) {
+            config_cond_timedwait(&commitQueued, &commitLock, COMMIT_WINDOW_SLICE_MS);
+        }
+
+        PendingCommit* batch = commitQueue;
+        commitQueue = NULL;
+        commitQueueTail = &commitQueue;
+        config_mutex_unlock(&commitLock);
+
+        commit_batch(batch);
+
+        config_mutex_lock(&commitLock);
+        while (batch) {
+            PendingCommit* next = batch->next;  // read before done is set, the owner frees its entry after that
+            batch->done = 1;
+            batch = next;
+        }
+        committerActive = 0;
+        config_cond_broadcast(&commitDone);
+    }
+    config_mutex_unlock(&commitLock);
+
+    free(entry.tempPath);
+    return entry.result;
+}
+
+
+// Save configuration data to a file atomically and durably
+int save_config_to_file_atomic(ConfigManager* cm, const char* filename) {
+    return save_config_to_file_with_flags(cm, filename, CONFIG_SAVE_ATOMIC);
+}
@@ -0,0 +1,591 @@
+#include "zhaoba_config_internal.h"
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Line-oriented key = value files (INI and Java-style properties).
+//
+// Loading is one pass over the file text: memchr finds each line end and the first '=' or ':' in it,
+// values are classified in place and only the final strings are copied. Per line:
+//      blank, or first non-blank character '#', ';' or '!'   ignored
+//      [section]                                             later keys become "section.key", [] ends the section
+//      key = value  or  key: value                           key and value trimmed of spaces and tabs
+//      anything else                                         skipped
+// A value is a list when it has a comma outside double quotes, one trailing comma ends the list ("1," is [1]).
+// Each scalar or list element is inferred: "quoted" is a STRING (with \\ \" \n \r \t escapes), an int in range
+// is an INT, a number with a point or exponent or nan/inf/-inf a FLOAT, anything else a STRING as written.
+// A list of INTs is an INT_ARRAY, of INTs and FLOATs a FLOAT_ARRAY, with any STRING (or empty) a STRING_ARRAY.
+// There are no inline comments, "a = 1 ; x" is the STRING "1 ; x".
+// The saver writes an empty list as a lone ",", which carries no element type: an empty INT_ARRAY or
+// FLOAT_ARRAY reads back as an empty STRING_ARRAY. Every other value reads back with its type.
+
+// longest unquoted text tried as a number
+#define INI_MAX_NUMBER 64
+
+// Where the elements of the value being parsed are collected, reused across lines
+typedef struct IniSpan {
+    const char* text;
+    size_t length;
+    int quoted;   // text is the inside of the quotes, escapes not yet resolved
+} IniSpan;
+
+typedef struct IniSpans {
+    IniSpan* items;
+    size_t count;
+    size_t capacity;
+} IniSpans;
+
+
+static int is_blank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static void trim(const char** text, size_t* length) {
+    while (*length > 0 && is_blank(**text)) {
+        ++*text;
+        --*length;
+    }
+    while (*length > 0 && is_blank((*text)[*length - 1])) {
+        --*length;
+    }
+}
+
+
+// ---- inference, shared by the loader and the saver's quoting decision ----
+
+static int parse_int(const char* text, size_t length, int* out) {
+    size_t i = 0;
+    int negative = 0;
+    if (length > 0 && (text[0] == '-' || text[0] == '+')) {
+        negative = text[0] == '-';
+        i = 1;
+    }
+    if (i == length) {
+        return -1;
+    }
+    long long value = 0;
+    for (; i < length; ++i) {
+        if (text[i] < '0' || text[i] > '9') {
+            return -1;
+        }
+        value = value * 10 + (text[i] - '0');
+        if (value > (long long)INT_MAX + 1) {
+            return -1;
+        }
+    }
+    value = negative ? -value : value;
+    if (value > INT_MAX) {
+        return -1;
+    }
+    *out = (int)value;
+    return 0;
+}
+
+static int parse_float(const char* text, size_t length, float* out) {
+    if (length == 3 && memcmp(text, "nan", 3) == 0) {
+        *out = NAN;
+        return 0;
+    }
+    if ((length == 3 && memcmp(text, "inf", 3) == 0) || (length == 4 && memcmp(text, "-inf", 4) == 0)) {
+        *out = text[0] == '-' ? -INFINITY : INFINITY;
+        return 0;
+    }
+
+    // [+-] digits [. digits] [e [+-] digits], with at least one digit before the exponent and a point
+    // or an exponent, so an integer too large for INT stays a STRING rather than losing digits
+    size_t i = 0, digits = 0;
+    int point = 0;
+    if (i < length && (text[i] == '-' || text[i] == '+')) ++i;
+    for (; i < length && text[i] >= '0' && text[i] <= '9'; ++i) ++digits;
+    if (i < length && text[i] == '.') {
+        point = 1;
+        for (++i; i < length && text[i] >= '0' && text[i] <= '9'; ++i) ++digits;
+    }
+    if (digits == 0 || (!point && (i == length || (text[i] != 'e' && text[i] != 'E')))) {
+        return -1;
+    }
+    if (i < length && (text[i] == 'e' || text[i] == 'E')) {
+        ++i;
+        if (i < length && (text[i] == '-' || text[i] == '+')) ++i;
+        size_t exponentDigits = 0;
+        for (; i < length && text[i] >= '0' && text[i] <= '9'; ++i) ++exponentDigits;
+        if (exponentDigits == 0) {
+            return -1;
+        }
+    }
+    if (i != length || length >= INI_MAX_NUMBER) {
+        return -1;
+    }
+
+    char number[INI_MAX_NUMBER];
+    memcpy(number, text, length);
+    number[length] = '\0';
+    *out = strtof(number, NULL);
+    return 0;
+}
+
+// type of an unquoted scalar: INT, FLOAT or STRING
+static ValueType infer_type(const char* text, size_t length) {
+    int i;
+    float f;
+    if (parse_int(text, length, &i) == 0) return INT;
+    if (parse_float(text, length, &f) == 0) return FLOAT;
+    return STRING;
+}
+
+
+// ---- loading ----
+
+// Split a trimmed value at commas outside quotes, *isList set when there was one. A quoted element
+// whose closing quote is not followed by only blanks up to the next comma is taken as plain text.
+// return 0 on success, -1 on allocation failure.
+static int split_value(const char* text, size_t length, IniSpans* spans, int* isList) {
+    spans->count = 0;
+    *isList = 0;
+    const char* end = text + length;
+    const char* p = text;
+    for (;;) {
+        const char* start = p;
+        while (p < end && is_blank(*p)) ++p;
+
+        IniSpan span = { p, 0, 0 };
+        const char* next = NULL;
+        if (p < end && *p == '"') {
+            const char* q = p + 1;
+            while (q < end && *q != '"') {
+                q += *q == '\\' && q + 1 < end ? 2 : 1;
+            }
+            const char* after = q + 1;
+            while (after < end && is_blank(*after)) ++after;
+            if (q < end && (after == end || *after == ',')) {
+                span.text = p + 1;
+                span.length = (size_t)(q - p - 1);
+                span.quoted = 1;
+                next = after;
+            }
+        }
+        if (!next) {
+            // plain text up to the next comma outside quotes
+            const char* q = start;
+            int inQuotes = 0;
+            for (; q < end && (inQuotes || *q != ','); ++q) {
+                if (*q == '"') inQuotes = !inQuotes;
+            }
+            span.text = start;
+            span.length = (size_t)(q - start);
+            trim(&span.text, &span.length);
+            next = q;
+        }
+
+        if (spans->count == spans->capacity) {
+            size_t capacity = spans->capacity ? spans->capacity * 2 : 16;
+            IniSpan* items = (IniSpan*)realloc(spans->items, capacity * sizeof(IniSpan));
+            if (!items) {
+                return -1;
+            }
+            spans->items = items;
+            spans->capacity = capacity;
+        }
+        spans->items[spans->count++] = span;
+
+        if (next >= end) {
+            return 0;
+        }
+        *isList = 1;
+        p = next + 1;  // past the comma
+        if (p >= end) {
+            return 0;  // one trailing comma closes the list
+        }
+    }
+}
+
+
+// Copy a span into a new string, resolving escapes when it was quoted
+static char* span_string(const IniSpan* span) {
+    char* str = (char*)malloc(span->length + 1);
+    if (!str) {
+        return NULL;
+    }
+    if (!span->quoted) {
+        memcpy(str, span->text, span->length);
+        str[span->length] = '\0';
+        return str;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < span->length; ++i) {
+        char c = span->text[i];
+        if (c == '\\' && i + 1 < span->length) {
+            c = span->text[++i];
+            switch (c) {
+            case 'n': c = '\n'; break;
+            case 'r': c = '\r'; break;
+            case 't': c = '\t'; break;
+            default: break;   // \\, \" and unknown escapes give the character itself
+            }
+        }
+        str[n++] = c;
+    }
+    str[n] = '\0';
+    return str;
+}
+
+
+// Build kv's value from a trimmed value text. return 0 on success, -1 on allocation failure.
+static int parse_value(const char* text, size_t length, IniSpans* spans, KeyValuePair* kv) {
+    int isList;
+    if (split_value(text, length, spans, &isList) != 0) {
+        return -1;
+    }
+
+    if (!isList) {
+        IniSpan* span = &spans->items[0];
+        ValueType type = span->quoted ? STRING : infer_type(span->text, span->length);
+        kv->type = type;
+        if (type == INT) {
+            parse_int(span->text, span->length, &kv->value.intValue);
+            return 0;
+        }
+        if (type == FLOAT) {
+            parse_float(span->text, span->length, &kv->value.floatValue);
+            return 0;
+        }
+        kv->value.stringValue = span_string(span);
+        return kv->value.stringValue ? 0 : -1;
+    }
+
+    // a list: "," alone is empty
+    size_t count = spans->count == 1 && spans->items[0].length == 0 && !spans->items[0].quoted ? 0 : spans->count;
+    ValueType type = INT_ARRAY;
+    for (size_t i = 0; i < count && type != STRING_ARRAY; ++i) {
+        IniSpan* span = &spans->items[i];
+        ValueType element = span->quoted ? STRING : infer_type(span->text, span->length);
+        if (element == STRING) type = STRING_ARRAY;
+        else if (element == FLOAT) type = FLOAT_ARRAY;
+    }
+    if (count == 0) {
+        type = STRING_ARRAY;
+    }
+
+    kv->type = type;
+    kv->arraySize = count;
+    switch (type) {
+    case INT_ARRAY:
+        kv->value.intArrayValue = (int*)malloc(count * sizeof(int) + 1);
+        if (!kv->value.intArrayValue) return -1;
+        for (size_t i = 0; i < count; ++i) {
+            parse_int(spans->items[i].text, spans->items[i].length, &kv->value.intArrayValue[i]);
+        }
+        return 0;
+    case FLOAT_ARRAY:
+        kv->value.floatArrayValue = (float*)malloc(count * sizeof(float) + 1);
+        if (!kv->value.floatArrayValue) return -1;
+        for (size_t i = 0; i < count; ++i) {
+            int n;
+            if (parse_int(spans->items[i].text, spans->items[i].length, &n) == 0) {
+                kv->value.floatArrayValue[i] = (float)n;
+            }
+            else {
+                parse_float(spans->items[i].text, spans->items[i].length, &kv->value.floatArrayValue[i]);
+            }
+        }
+        return 0;
+    default:
+        kv->value.stringArrayValue = (char**)calloc(count + 1, sizeof(char*));
+        if (!kv->value.stringArrayValue) return -1;
+        for (size_t i = 0; i < count; ++i) {
+            kv->value.stringArrayValue[i] = span_string(&spans->items[i]);
+            if (!kv->value.stringArrayValue[i]) return -1;
+        }
+        return 0;
+    }
+}
+
+
+// Parse one value written as in an INI file, for other text sources
+int config_parse_text_value(const char* text, size_t length, KeyValuePair* kv) {
+    IniSpans spans = { NULL, 0, 0 };
+    trim(&text, &length);
+    int result = parse_value(text, length, &spans, kv);
+    free(spans.items);
+    return result;
+}
+
+
+// Load configuration data from an INI or properties file
+int load_config_from_ini(ConfigManager* cm, const char* filename) {
+    if (!cm || !filename) {
+        return -1;
+    }
+    size_t size = 0;
+    char* text = config_read_file(filename, &size);
+    if (!text) {
+        return -1;
+    }
+
+    IniSpans spans = { NULL, 0, 0 };
+    char* key = NULL;          // "section." followed by the current key
+    size_t keyCapacity = 0;
+    size_t sectionLength = 0;
+
+    int bulk = begin_config_bulk_load(cm) == 0;
+    size_t mark = cm->size;
+    int error = 0;
+    const char* p = text;
+    const char* end = text + size;
+    if (size >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0) {
+        p += 3;  // UTF-8 byte order mark
+    }
+
+    while (p < end && !error) {
+        const char* newline = (const char*)memchr(p, '\n', (size_t)(end - p));
+        const char* lineEnd = newline ? newline : end;
+        const char* line = p;
+        size_t length = (size_t)(lineEnd - line);
+        p = newline ? newline + 1 : end;
+        if (length > 0 && line[length - 1] == '\r') {
+            --length;
+        }
+        trim(&line, &length);
+        if (length == 0 || line[0] == '#' || line[0] == ';' || line[0] == '!') {
+            continue;
+        }
+
+        const char* keyText = line;
+        size_t keyLength;
+        const char* valueText;
+        size_t valueLength;
+        if (line[0] == '[') {
+            if (line[length - 1] != ']') {
+                continue;
+            }
+            keyText = line + 1;
+            keyLength = length - 2;
+            trim(&keyText, &keyLength);
+            valueLength = 0;
+        }
+        else {
+            const char* equals = (const char*)memchr(line, '=', length);
+            const char* colon = (const char*)memchr(line, ':', equals ? (size_t)(equals - line) : length);
+            const char* separator = colon ? colon : equals;
+            if (!separator) {
+                continue;
+            }
+            keyLength = (size_t)(separator - line);
+            trim(&keyText, &keyLength);
+            valueText = separator + 1;
+            valueLength = (size_t)(line + length - valueText);
+            trim(&valueText, &valueLength);
+            if (keyLength == 0) {
+                continue;
+            }
+        }
+
+        // key buffer: the section prefix stays in front, the key is written after it
+        size_t needed = (line[0] == '[' ? 0 : sectionLength) + keyLength + 2;
+        if (needed > keyCapacity) {
+            char* grown = (char*)realloc(key, needed * 2);
+            if (!grown) {
+                error = 1;
+                break;
+            }
+            key = grown;
+            keyCapacity = needed * 2;
+        }
+        if (line[0] == '[') {
+            memcpy(key, keyText, keyLength);
+            if (keyLength > 0) key[keyLength++] = '.';
+            sectionLength = keyLength;
+            continue;
+        }
+        memcpy(key + sectionLength, keyText, keyLength);
+        key[sectionLength + keyLength] = '\0';
+
+        KeyValuePair kv;
+        memset(&kv, 0, sizeof(kv));
+        kv.key = _strdup(key);
+        if (!kv.key || parse_value(valueText, valueLength, &spans, &kv) != 0) {
+            printf("Memory allocation for record failed.\n");
+            free_key_value_pair(&kv);
+            error = 1;
+            break;
+        }
+        kv.keyHash = config_hash_key(kv.key);
+        kv.valueHash = config_hash_value(&kv);
+        config_put_record(cm, &kv);
+    }
+
+    if (error) {
+        // in bulk mode the records of this file are still an unchecked tail, drop them all
+        while (cm->size > mark) {
+            free_key_value_pair(&cm->records[--cm->size]);
+        }
+    }
+    int result = bulk ? end_config_bulk_load(cm) : 0;
+    free(spans.items);
+    free(key);
+    free(text);
+    return error ? -1 : result;
+}
+
+
+// ---- saving ----
+
+// Whether a key reads back unchanged as the key of a key = value line
+static int key_is_writable(const char* key) {
+    size_t length = strlen(key);
+    if (length == 0 || is_blank(key[0]) || is_blank(key[length - 1])) {
+        return 0;
+    }
+    if (key[0] == '#' || key[0] == ';' || key[0] == '!' || key[0] == '[') {
+        return 0;
+    }
+    return strpbrk(key, "=:\r\n") == NULL;
+}
+
+// Whether a string element must be quoted to read back as the same STRING
+static int needs_quotes(const char* str) {
+    size_t length = strlen(str);
+    if (length == 0) {
+        return 1;   // in a list an empty last element would be taken for the closing comma
+    }
+    if (is_blank(str[0]) || is_blank(str[length - 1])) {
+        return 1;
+    }
+    for (const char* c = str; *c; ++c) {
+        if (*c == ',' || *c == '"' || (unsigned char)*c < 32) {
+            return 1;
+        }
+    }
+    return infer_type(str, length) != STRING;
+}
+
+static void write_quoted(ConfigWriter* w, const char* str) {
+    config_writer_put(w, "\"", 1);
+    const char* run = str;
+    for (const char* c = str; *c; ++c) {
+        const char* escape = NULL;
+        switch (*c) {
+        case '"': escape = "\\\""; break;
+        case '\\': escape = "\\\\"; break;
+        case '\n': escape = "\\n"; break;
+        case '\r': escape = "\\r"; break;
+        case '\t': escape = "\\t"; break;
+        default: break;
+        }
+        if (escape) {
+            config_writer_put(w, run, (size_t)(c - run));
+            config_writer_put(w, escape, 2);
+            run = c + 1;
+        }
+    }
+    config_writer_put(w, run, strlen(run));
+    config_writer_put(w, "\"", 1);
+}
+
+static void write_text(ConfigWriter* w, const char* str) {
+    if (needs_quotes(str)) {
+        write_quoted(w, str);
+    }
+    else {
+        config_writer_put(w, str, strlen(str));
+    }
+}
+
+// FLOAT text that reads back as FLOAT: shortest digits, ".0" added to whole numbers
+static void write_ini_float(ConfigWriter* w, float value) {
+    if (isnan(value)) {
+        config_writer_put(w, "nan", 3);
+        return;
+    }
+    if (isinf(value)) {
+        config_writer_put(w, value > 0 ? "inf" : "-inf", value > 0 ? 3 : 4);
+        return;
+    }
+    char number[CONFIG_NUMBER_BUFFER_SIZE + 2];
+    int length = config_format_float(value, number);
+    if (!strpbrk(number, ".e")) {
+        memcpy(number + length, ".0", 3);
+        length += 2;
+    }
+    config_writer_put(w, number, (size_t)length);
+}
+
+static void write_ini_value(ConfigWriter* w, const KeyValuePair* kv) {
+    char number[CONFIG_NUMBER_BUFFER_SIZE];
+    switch (kv->type) {
+    case INT:
+        config_writer_put(w, number, (size_t)sprintf(number, "%d", kv->value.intValue));
+        return;
+    case FLOAT:
+        write_ini_float(w, kv->value.floatValue);
+        return;
+    case STRING:
+        write_text(w, kv->value.stringValue ? kv->value.stringValue : "");
+        return;
+    default:
+        break;
+    }
+
+    for (size_t j = 0; j < kv->arraySize; ++j) {
+        if (j > 0) {
+            config_writer_put(w, ", ", 2);
+        }
+        if (kv->type == INT_ARRAY) {
+            config_writer_put(w, number, (size_t)sprintf(number, "%d", kv->value.intArrayValue[j]));
+        }
+        else if (kv->type == FLOAT_ARRAY) {
+            write_ini_float(w, kv->value.floatArrayValue[j]);
+        }
+        else {
+            write_text(w, kv->value.stringArrayValue[j]);
+        }
+    }
+    if (kv->arraySize < 2) {
+        config_writer_put(w, ",", 1);  // marks a list of one, or alone an empty list (of any type, see above)
+    }
+}
+
+
+// Save configuration data as key = value lines
+int save_config_to_ini(ConfigManager* cm, const char* filename) {
+    if (!cm || !filename || config_bulk_resolve(cm) != 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < cm->size; ++i) {
+        if (!key_is_writable(cm->records[i].key)) {
+            printf("Error: key '%s' cannot be written to an INI file.\n", cm->records[i].key);
+            return -1;
+        }
+    }
+
+    int fd = config_file_open_write(filename, 0);
+    if (fd < 0) {
+        printf("Error opening file: %s\n", filename);
+        return -1;
+    }
+    ConfigWriter* w = (ConfigWriter*)malloc(sizeof(ConfigWriter));
+    if (!w) {
+        printf("Memory allocation for writer failed.\n");
+        config_fd_close(fd);
+        return -1;
+    }
+
+    config_writer_init(w, config_fd_write, &fd, 0);
+    for (size_t i = 0; i < cm->size && !w->failed; ++i) {
+        const KeyValuePair* kv = &cm->records[i];
+        config_writer_put(w, kv->key, strlen(kv->key));
+        config_writer_put(w, " = ", 3);
+        write_ini_value(w, kv);
+        config_writer_put(w, "\n", 1);
+    }
+    int result = config_writer_flush(w);
+    free(w);
+    if (config_fd_close(fd) != 0) {
+        result = -1;
+    }
+    if (result != 0) {
+        printf("Error writing file: %s\n", filename);
+    }
+    return result;
+}
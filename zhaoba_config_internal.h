@@ -0,0 +1,327 @@
+#ifndef zhaoba_CONFIG_INTERNAL_H
+#define zhaoba_CONFIG_INTERNAL_H
+
+// Private definitions shared by the config manager translation units.
+// Include this header first in every zhaoba_config_*.c file, before any system header.
+
+#if !defined(_CRT_SECURE_NO_DEPRECATE) && defined(_MSC_VER)
+#define _CRT_SECURE_NO_DEPRECATE
+#endif
+
+// POSIX 2008 declarations (strdup, O_CLOEXEC, clock_gettime, fseeko, st_mtim) also under -std=c11
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "zhaoba_config_manager.h"
+#include <stdio.h>
+#include "cJSON.h"
+#include "zhaoba_config_thread.h"
+
+#ifndef _WIN32
+#define _strdup strdup
+#endif
+
+// returned by find_record_index when the key is not stored
+#define CONFIG_NPOS ((size_t)-1)
+
+// write-ahead journal state, see zhaoba_config_journal.c
+typedef struct ConfigJournal ConfigJournal;
+
+// one named layer of a layered manager, see zhaoba_config_layers.c
+typedef struct ConfigLayer {
+    char* name;
+    ConfigManager* cm;
+} ConfigLayer;
+
+// What the file system tells about a file's current contents: writing it in place changes the size or the
+// modification time (kept to the nanosecond, or 100ns on Windows), replacing it changes the file id.
+// exists is 0 for a missing file, the other fields are then 0.
+typedef struct ConfigFileStamp {
+    int exists;
+    long long size;
+    long long mtimeNs;
+    unsigned long long fileId;   // inode, or the NTFS file index
+    unsigned long long device;   // device, or the volume serial number
+} ConfigFileStamp;
+
+// Union to store values of different types (int, float, string, and arrays of them)
+union Value {
+    int intValue;
+    float floatValue;
+    char* stringValue;
+    int* intArrayValue;
+    float* floatArrayValue;
+    char** stringArrayValue;
+};
+
+// Struct to store a key-value pair
+//
+// rendered caches the record's serialized JSON object for the layout in renderedFlags, NULL while the
+// record is dirty (new, or changed since its last save).
+// changeStamp is the ConfigManager.changeCount of the record's last add or change notification.
+struct KeyValuePair {
+    char* key;
+    Value value;
+    ValueType type;
+    size_t arraySize;
+    unsigned int keyHash;
+    unsigned int valueHash;
+    char* rendered;
+    size_t renderedLength;
+    unsigned int renderedFlags;
+    unsigned long changeStamp;
+};
+
+// Struct to represent the configuration manager
+//
+// index is an open-addressing hash table over records, each slot holds a record position + 1 (0 means empty).
+// indexCapacity is always a power of two and at least twice size, so probes stay short.
+// In bulk-load mode only records[0, bulkStart) are indexed, later ones are appended unchecked
+// and may repeat keys until config_bulk_resolve folds them in.
+struct ConfigManager {
+    KeyValuePair* records;
+    size_t size;
+    size_t capacity;
+    size_t* index;
+    size_t indexCapacity;
+    int bulkMode;
+    size_t bulkStart;
+    ConfigChangeCallback onChange;
+    void* onChangeData;
+    ConfigJournal* journal;  // NULL unless open_config_journal was called
+    // changeCount grows with every notified change; a save of savedFile with savedFlags that saw
+    // savedChangeCount and left the file at savedStamp is repeated only once something changed
+    // in cm or in the file.
+    // saveLock serializes saves of this manager, they fill the rendered caches.
+    unsigned long changeCount;
+    char* savedFile;
+    unsigned int savedFlags;
+    unsigned long savedChangeCount;
+    ConfigFileStamp savedStamp;
+    config_mutex_t saveLock;
+    // changeCount of the last removal or type change, which an appended JSON Lines record cannot express
+    unsigned long rewriteChangeCount;
+    // a manager with layers holds their flattened view in records, layers[layerCount - 1] wins;
+    // each layer points back at the manager holding its view
+    ConfigLayer* layers;
+    size_t layerCount;
+    ConfigManager* layerView;
+    ConfigBinding* bindings;  // structs bound with bind_config_struct, a singly linked list
+};
+
+// Create a new key-value pair, copying value. key is NULL in the result on failure.
+KeyValuePair create_key_value_pair(const char* key, void* value, ValueType type, size_t arraySize);
+
+// Free the key and value owned by a key-value pair and reset it to empty.
+void free_key_value_pair(KeyValuePair* kv);
+
+// Deep copy of cm's records into a new manager with no callback, journal or caches (bulk records resolved first).
+// return NULL on allocation failure.
+ConfigManager* config_clone(ConfigManager* cm);
+
+// Drop the cached serialization of a record whose value changed
+void config_record_dirty(KeyValuePair* kv);
+
+// FNV-1a hash of a key, the value stored in KeyValuePair.keyHash
+unsigned int config_hash_key(const char* key);
+
+// Content hash over type, arraySize and value, the value stored in KeyValuePair.valueHash
+unsigned int config_hash_value(const KeyValuePair* kv);
+
+// Whether two records hold the same type and value (keys are not compared)
+int config_values_equal(const KeyValuePair* a, const KeyValuePair* b);
+
+// Position of key in cm->records, or CONFIG_NPOS if it is not stored.
+size_t find_record_index(const ConfigManager* cm, const char* key);
+
+// Rebuild the whole index from cm->records in one pass.
+// return 0 on success, -1 if the table cannot be allocated.
+int config_index_rebuild(ConfigManager* cm);
+
+// Resolve the records appended in bulk-load mode (duplicates folded, index rebuilt) without leaving the mode.
+// Anything that needs unique keys, such as delete, reload or save, calls this first. No-op outside bulk mode.
+// return 0 on success, -1 if the index cannot be allocated.
+int config_bulk_resolve(ConfigManager* cm);
+
+// Move an owned key-value pair into cm, last writer wins.
+// kv is consumed in every case: on a type mismatch or error its memory is freed.
+// return 0 when stored, -1 on type mismatch or allocation failure, or if the journal could not record the change.
+int config_put_record(ConfigManager* cm, KeyValuePair* kv);
+
+// Replace the record at position pos with kv's type and value, consuming kv. Notifies CONFIG_KEY_CHANGED.
+// return 0, or -1 if the change could not be written to cm's journal (it is made in memory all the same).
+int config_replace_record(ConfigManager* cm, size_t pos, KeyValuePair* kv);
+
+// Remove every record among the first maskSize whose removeMask entry is non-zero, keeping the order of the rest.
+// The index is rebuilt once and CONFIG_KEY_REMOVED is sent for each removed key.
+// return 0 on success, -1 on allocation failure (nothing is removed).
+int config_remove_records(ConfigManager* cm, const unsigned char* removeMask, size_t maskSize);
+
+// Whether filename still holds the last save of cm with these flags and nothing changed since
+int config_save_is_current(ConfigManager* cm, const char* filename, unsigned int flags);
+// Remember a successful save of filename that saw changeCount, for skipping and appending later saves
+void config_remember_save(ConfigManager* cm, const char* filename, unsigned int flags, unsigned long changeCount);
+
+// Send a change notification to the journal and the registered callback, if any.
+// return 0, or -1 if the change could not be made durable in cm's journal.
+int config_notify(ConfigManager* cm, const char* key, ConfigChangeKind kind);
+
+// Append the change to cm's journal and sync it, checkpointing when the journal has grown too large.
+// Write errors are reported and recovered by an immediate checkpoint.
+int config_journal_record(ConfigManager* cm, const char* key, ConfigChangeKind kind);
+// Close cm's journal without a checkpoint, every change is already on disk
+void config_journal_free(ConfigManager* cm);
+
+// Records parsed off the manager, in file order, waiting to be merged with config_put_record
+typedef struct ConfigRecordList {
+    KeyValuePair* records;
+    size_t count;
+    size_t capacity;
+} ConfigRecordList;
+
+// Move kv to the end of list. return 0 on success, -1 on allocation failure (kv is left to the caller).
+int config_record_list_append(ConfigRecordList* list, KeyValuePair* kv);
+// Free every record still in list and the list storage
+void config_record_list_free(ConfigRecordList* list);
+
+// Build an owned key-value pair from one {key, type, value} JSON record.
+// return 0 on success, -1 if the record is malformed (kv is left empty).
+int config_record_from_json(const cJSON* item, KeyValuePair* kv);
+
+// Fixed-size output buffer in front of a ConfigWriteCallback.
+// failed sticks once a write has failed, later output is dropped.
+#define CONFIG_WRITER_BUFFER_SIZE 65536
+
+typedef struct ConfigWriter {
+    unsigned int flags;
+    ConfigWriteCallback write;
+    void* context;
+    size_t used;
+    int failed;
+    char buffer[CONFIG_WRITER_BUFFER_SIZE];
+} ConfigWriter;
+
+// the ConfigSaveFlags that change the bytes of a record, the key of KeyValuePair.rendered
+#define CONFIG_SAVE_LAYOUT_MASK (CONFIG_SAVE_MINIFIED | CONFIG_SAVE_OMIT_ARRAY_SIZE | CONFIG_SAVE_SHORTEST_FLOATS)
+
+// flags is a combination of ConfigSaveFlags selecting the layout
+void config_writer_init(ConfigWriter* w, ConfigWriteCallback write, void* context, unsigned int flags);
+void config_writer_put(ConfigWriter* w, const char* data, size_t length);
+// return 0 on success, -1 if any write so far has failed
+int config_writer_flush(ConfigWriter* w);
+
+// Shortest decimal text that reads back to exactly d (double) or value (float32), NUL-terminated.
+// buffer needs CONFIG_NUMBER_BUFFER_SIZE bytes. NaN and infinity give "null" like cJSON. return the length.
+#define CONFIG_NUMBER_BUFFER_SIZE 32
+int config_format_double(double d, char* buffer);
+int config_format_float(float value, char* buffer);
+
+// JSON renderers matching cJSON_Print (or cJSON_PrintUnformatted when minified) byte for byte
+void config_write_string(ConfigWriter* w, const char* str);
+void config_write_number(ConfigWriter* w, double d);
+// a FLOAT value: shortest float32 text with CONFIG_SAVE_SHORTEST_FLOATS, otherwise config_write_number
+void config_write_float(ConfigWriter* w, float value);
+void config_write_record(ConfigWriter* w, const KeyValuePair* kv);
+// a record from its cached bytes, rendering and caching them first if it is dirty. *scratch is allocated
+// on first use and freed by the caller. call with cm->saveLock held.
+void config_write_cached_record(ConfigWriter* w, KeyValuePair* kv, ConfigWriter** scratch);
+// write the whole top-level array and flush, rendering only dirty records and streaming the cached
+// bytes of the rest, on worker threads with CONFIG_SAVE_PARALLEL. call with cm->saveLock held.
+// return 0 on success, -1 on a write error.
+int config_write_records(ConfigWriter* w, ConfigManager* cm);
+
+// Unbuffered file helpers for the durable save paths. return 0 / a descriptor on success, -1 on error.
+// binary skips the newline translation of text mode on Windows
+int config_file_open_write(const char* path, int binary);
+// open an existing file for binary writes at its end
+int config_file_open_append(const char* path);
+// ConfigWriteCallback over a file descriptor, context is an int*
+int config_fd_write(void* context, const char* data, size_t length);
+// write count buffers in order with as few system calls as possible (writev where available)
+typedef struct ConfigBytes {
+    const char* data;
+    size_t length;
+} ConfigBytes;
+int config_fd_writev(int fd, const ConfigBytes* parts, size_t count);
+int config_fd_sync(int fd);
+int config_fd_close(int fd);
+// size of the file at path, -1 if it does not exist
+long long config_file_size(const char* path);
+// stamp of the file at path now (stamp->exists is 0 if it cannot be read)
+void config_file_stamp(const char* path, ConfigFileStamp* stamp);
+// whether two stamps describe the same existing file with the same contents as far as the file system tells
+int config_file_stamp_equal(const ConfigFileStamp* a, const ConfigFileStamp* b);
+// atomically replace target with source
+int config_replace_file(const char* source, const char* target);
+// flush the directory entry of path to disk
+int config_sync_parent_dir(const char* path);
+// heap-allocated unique temp file name next to filename, NULL on allocation failure
+char* config_temp_path(const char* filename);
+
+// Save through a temp file, fsync and rename, sharing the fsync with concurrent saves (CONFIG_SAVE_ATOMIC)
+int config_save_atomic(ConfigManager* cm, const char* filename, unsigned int flags);
+
+// Compressed files (CONFIG_SAVE_COMPRESSED), see zhaoba_config_compress.c
+#define CONFIG_COMPRESSED_MAGIC "ZCZ1"
+#define CONFIG_COMPRESSED_MAGIC_SIZE 4
+
+typedef struct ConfigCompressor ConfigCompressor;
+// Start a compressed stream on write(context, ...), the magic is written at once. return NULL on allocation failure.
+ConfigCompressor* config_compressor_create(ConfigWriteCallback write, void* context);
+// ConfigWriteCallback taking the ConfigCompressor* as context
+int config_compressor_write(void* context, const char* data, size_t length);
+// Write the last block and the end marker, then free c. return 0 on success, -1 if any write failed.
+int config_compressor_finish(ConfigCompressor* c);
+
+// whether data starts with the compressed magic
+int config_is_compressed(const char* data, size_t size);
+// whether the file at filename starts with the compressed magic (0 if it cannot be read)
+int config_file_is_compressed(const char* filename);
+// Decompress a whole compressed image into a NUL-terminated heap buffer. return NULL if it is corrupt.
+char* config_inflate(const char* data, size_t size, size_t* sizeOut);
+// Load a compressed file into cm, parsing records while blocks are decompressed, so only a window of
+// the text is in memory. return 0 on success, -1 on error (cm keeps none of the file's records).
+int config_load_compressed(ConfigManager* cm, const char* filename);
+
+// C string literal of str, quotes included, safe for any bytes (zhaoba_config_bake.c)
+void config_write_c_string(ConfigWriter* w, const char* str);
+// Braced initializer of a char array holding str and its NUL, for strings too long for a literal
+void config_write_c_bytes(ConfigWriter* w, const char* str);
+// longest string written as a literal in generated C, C only guarantees 4095 characters per literal
+#define CONFIG_MAX_C_LITERAL 4000
+
+// Re-resolve key in the flattened view of a layered manager after one of its layers changed it
+void config_layer_changed(ConfigManager* view, const char* key);
+// Free the layers of cm
+void config_layers_free(ConfigManager* cm);
+
+// Refresh every struct bound to cm, after a load or reload (zhaoba_config_binding.c)
+void config_bindings_refresh(ConfigManager* cm);
+// Free the bindings still attached to cm
+void config_bindings_free(ConfigManager* cm);
+
+// Codecs, see zhaoba_config_codec.c
+// the built-in JSON codec
+extern const ConfigCodec config_json_codec;
+// Load a JSON record array with one cJSON tree. return 0 on success, -1 on error.
+int config_load_json(ConfigManager* cm, const char* filename);
+// Write a JSON record array, no skip check. return 0 on success, -1 on error.
+int config_save_json(ConfigManager* cm, const char* filename, unsigned int flags);
+// Copy a binary snapshot into cm. return 0 on success, -1 on error (cm keeps none of the file's records).
+int config_load_snapshot(ConfigManager* cm, const char* filename);
+// the codec that saves filename by its extension, NULL when it is JSON
+const ConfigCodec* config_codec_for_save(const char* filename);
+// Save through codec, providing CONFIG_SAVE_ATOMIC for it. return 0 on success, -1 on error.
+int config_codec_save(const ConfigCodec* codec, ConfigManager* cm, const char* filename, unsigned int flags);
+
+// Set kv's type and value from text written as an INI value (zhaoba_config_ini.c), surrounding blanks ignored.
+// kv->key must be set so free_key_value_pair can release a partial value. return 0 on success, -1 on allocation failure.
+int config_parse_text_value(const char* text, size_t length, KeyValuePair* kv);
+
+// Read a whole file into a NUL-terminated heap buffer, binary mode, 64-bit sizes.
+// A compressed file is returned decompressed.
+// return the buffer (caller frees) and its length in sizeOut, or NULL on error.
+char* config_read_file(const char* filename, size_t* sizeOut);
+
+#endif // zhaoba_CONFIG_INTERNAL_H
@@ -0,0 +1,511 @@
+#include "zhaoba_config_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#if !defined(_WIN32) && !defined(O_CLOEXEC)
+#define O_CLOEXEC 0
+#endif
+
+// Write-ahead journal for a ConfigManager.
+//
+// The journal file starts with JOURNAL_MAGIC and then holds one entry per change:
+//      u32 payload length, u32 FNV-1a checksum of the payload, payload
+// with a payload of
+//      u8 op, u32 key length, key bytes                        (JOURNAL_DELETE)
+//      u8 op, u32 key length, key bytes, u8 type, u32 count, value   (JOURNAL_PUT)
+// All integers are little-endian; INT and FLOAT values are 4 bytes each, strings are a u32 length and bytes.
+// Every entry carries the full new value of its key, so replaying entries that are already part of the
+// checkpoint (a crash between checkpoint and truncation) converges on the same state.
+
+#define JOURNAL_MAGIC "ZCJ1"
+#define JOURNAL_HEADER_SIZE 4
+#define JOURNAL_ENTRY_HEADER_SIZE 8
+#define JOURNAL_DEFAULT_CHECKPOINT_BYTES ((size_t)4 * 1024 * 1024)
+
+enum {
+    JOURNAL_PUT = 1,
+    JOURNAL_DELETE = 2
+};
+
+struct ConfigJournal {
+    char* checkpointFile;
+    char* journalFile;
+    int fd;
+    size_t size;             // bytes in the journal file, header included
+    size_t checkpointBytes;
+    char* buffer;            // entry encoding scratch, reused between appends
+    size_t bufferCapacity;
+    size_t bufferUsed;
+    int failed;
+};
+
+
+static int journal_open(const char* path) {
+#ifdef _WIN32
+    return _open(path, _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    return open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+#endif
+}
+
+
+static int journal_truncate(int fd, size_t size) {
+#ifdef _WIN32
+    return _chsize_s(fd, (long long)size) == 0 ? 0 : -1;
+#else
+    return ftruncate(fd, (off_t)size) == 0 ? 0 : -1;
+#endif
+}
+
+
+static unsigned int checksum(const unsigned char* data, size_t length) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+static int buffer_reserve(ConfigJournal* j, size_t extra) {
+    if (j->bufferUsed + extra <= j->bufferCapacity) {
+        return 0;
+    }
+    size_t capacity = j->bufferCapacity ? j->bufferCapacity : 256;
+    while (capacity < j->bufferUsed + extra) {
+        capacity *= 2;
+    }
+    char* buffer = (char*)realloc(j->buffer, capacity);
+    if (!buffer) {
+        return -1;
+    }
+    j->buffer = buffer;
+    j->bufferCapacity = capacity;
+    return 0;
+}
+
+
+static void put_u32(unsigned char* out, unsigned int v) {
+    out[0] = (unsigned char)v;
+    out[1] = (unsigned char)(v >> 8);
+    out[2] = (unsigned char)(v >> 16);
+    out[3] = (unsigned char)(v >> 24);
+}
+
+
+static unsigned int get_u32(const unsigned char* in) {
+    return (unsigned int)in[0] | ((unsigned int)in[1] << 8) | ((unsigned int)in[2] << 16) | ((unsigned int)in[3] << 24);
+}
+
+
+static int append_bytes(ConfigJournal* j, const void* data, size_t length) {
+    if (buffer_reserve(j, length) != 0) {
+        return -1;
+    }
+    memcpy(j->buffer + j->bufferUsed, data, length);
+    j->bufferUsed += length;
+    return 0;
+}
+
+
+static int append_u32(ConfigJournal* j, unsigned int v) {
+    unsigned char bytes[4];
+    put_u32(bytes, v);
+    return append_bytes(j, bytes, 4);
+}
+
+
+static int append_string(ConfigJournal* j, const char* str) {
+    size_t length = str ? strlen(str) : 0;
+    return append_u32(j, (unsigned int)length) || append_bytes(j, str, length);
+}
+
+
+// Encode one entry for key into j->buffer. kv is NULL for a delete.
+static int encode_entry(ConfigJournal* j, const char* key, const KeyValuePair* kv) {
+    j->bufferUsed = 0;
+    if (buffer_reserve(j, JOURNAL_ENTRY_HEADER_SIZE) != 0) {
+        return -1;
+    }
+    j->bufferUsed = JOURNAL_ENTRY_HEADER_SIZE;
+
+    unsigned char op = kv ? JOURNAL_PUT : JOURNAL_DELETE;
+    int error = append_bytes(j, &op, 1) || append_string(j, key);
+    if (kv && !error) {
+        unsigned char type = (unsigned char)kv->type;
+        int scalar = kv->type == INT || kv->type == FLOAT || kv->type == STRING;
+        error = append_bytes(j, &type, 1) || append_u32(j, scalar ? 0 : (unsigned int)kv->arraySize);
+        unsigned int bits;
+        switch (kv->type) {
+        case INT:
+            error = error || append_u32(j, (unsigned int)kv->value.intValue);
+            break;
+        case FLOAT:
+            memcpy(&bits, &kv->value.floatValue, 4);
+            error = error || append_u32(j, bits);
+            break;
+        case STRING:
+            error = error || append_string(j, kv->value.stringValue);
+            break;
+        case INT_ARRAY:
+            for (size_t i = 0; i < kv->arraySize && !error; ++i) {
+                error = append_u32(j, (unsigned int)kv->value.intArrayValue[i]);
+            }
+            break;
+        case FLOAT_ARRAY:
+            for (size_t i = 0; i < kv->arraySize && !error; ++i) {
+                memcpy(&bits, &kv->value.floatArrayValue[i], 4);
+                error = append_u32(j, bits);
+            }
+            break;
+        case STRING_ARRAY:
+            for (size_t i = 0; i < kv->arraySize && !error; ++i) {
+                error = append_string(j, kv->value.stringArrayValue[i]);
+            }
+            break;
+        default:
+            error = 1;
+            break;
+        }
+    }
+    if (error) {
+        return -1;
+    }
+
+    unsigned char* header = (unsigned char*)j->buffer;
+    size_t payloadLength = j->bufferUsed - JOURNAL_ENTRY_HEADER_SIZE;
+    put_u32(header, (unsigned int)payloadLength);
+    put_u32(header + 4, checksum(header + JOURNAL_ENTRY_HEADER_SIZE, payloadLength));
+    return 0;
+}
+
+
+// Bounds-checked reader over one entry payload
+typedef struct PayloadReader {
+    const unsigned char* p;
+    const unsigned char* end;
+} PayloadReader;
+
+static int read_u32(PayloadReader* r, unsigned int* v) {
+    if (r->end - r->p < 4) {
+        return -1;
+    }
+    *v = get_u32(r->p);
+    r->p += 4;
+    return 0;
+}
+
+// a NUL-terminated heap copy of the next string
+static char* read_string(PayloadReader* r) {
+    unsigned int length;
+    if (read_u32(r, &length) != 0 || (size_t)(r->end - r->p) < length) {
+        return NULL;
+    }
+    char* str = (char*)malloc((size_t)length + 1);
+    if (str) {
+        memcpy(str, r->p, length);
+        str[length] = '\0';
+        r->p += length;
+    }
+    return str;
+}
+
+
+// Decode the value part of a put entry into an owned kv (key already set)
+static int decode_value(PayloadReader* r, KeyValuePair* kv) {
+    unsigned int count, bits;
+    if (r->p >= r->end) {
+        return -1;
+    }
+    kv->type = (ValueType)*r->p++;
+    if (read_u32(r, &count) != 0) {
+        return -1;
+    }
+    kv->arraySize = 0;
+    kv->value.stringValue = NULL;
+
+    switch (kv->type) {
+    case INT:
+        if (read_u32(r, &bits) != 0) return -1;
+        kv->value.intValue = (int)bits;
+        break;
+    case FLOAT:
+        if (read_u32(r, &bits) != 0) return -1;
+        memcpy(&kv->value.floatValue, &bits, 4);
+        break;
+    case STRING:
+        kv->value.stringValue = read_string(r);
+        if (!kv->value.stringValue) return -1;
+        break;
+    case INT_ARRAY:
+    case FLOAT_ARRAY:
+        if ((size_t)(r->end - r->p) / 4 < count) return -1;
+        kv->value.intArrayValue = (int*)malloc(((size_t)count + 1) * 4);
+        if (!kv->value.intArrayValue) return -1;
+        kv->arraySize = count;
+        for (size_t i = 0; i < count; ++i) {
+            if (read_u32(r, &bits) != 0) return -1;
+            memcpy(&kv->value.intArrayValue[i], &bits, 4);  // float bits are copied the same way
+        }
+        break;
+    case STRING_ARRAY:
+        if ((size_t)(r->end - r->p) / 4 < count) return -1;
+        kv->value.stringArrayValue = (char**)calloc((size_t)count + 1, sizeof(char*));
+        if (!kv->value.stringArrayValue) return -1;
+        kv->arraySize = count;
+        for (size_t i = 0; i < count; ++i) {
+            kv->value.stringArrayValue[i] = read_string(r);
+            if (!kv->value.stringArrayValue[i]) return -1;
+        }
+        break;
+    default:
+        kv->type = INT;  // nothing to free
+        return -1;
+    }
+    return 0;
+}
+
+
+// Apply one entry payload to cm. return -1 if the payload is malformed.
+static int replay_entry(ConfigManager* cm, const unsigned char* payload, size_t length) {
+    PayloadReader r = { payload, payload + length };
+    if (length < 1) {
+        return -1;
+    }
+    unsigned char op = *r.p++;
+
+    KeyValuePair kv;
+    kv.key = read_string(&r);
+    kv.type = INT;
+    kv.arraySize = 0;
+    kv.value.stringValue = NULL;
+    kv.rendered = NULL;
+    kv.changeStamp = 0;
+    if (!kv.key) {
+        return -1;
+    }
+
+    if (op == JOURNAL_DELETE) {
+        int result = r.p == r.end ? 0 : -1;
+        if (result == 0 && find_record_index(cm, kv.key) != CONFIG_NPOS) {
+            delete_value_by_key(cm, kv.key);
+        }
+        free(kv.key);
+        return result;
+    }
+    if (op != JOURNAL_PUT || decode_value(&r, &kv) != 0 || r.p != r.end) {
+        free_key_value_pair(&kv);
+        return -1;
+    }
+
+    kv.keyHash = config_hash_key(kv.key);
+    kv.valueHash = config_hash_value(&kv);
+    size_t pos = find_record_index(cm, kv.key);
+    if (pos != CONFIG_NPOS) {
+        config_replace_record(cm, pos, &kv);
+        return 0;
+    }
+    return config_put_record(cm, &kv);
+}
+
+
+// Replay journalFile into cm. return the length of the valid prefix to keep, 0 for a missing
+// or empty journal, or -1 if the file is not a journal.
+static long long replay_journal(ConfigManager* cm, const char* journalFile) {
+    FILE* probe = fopen(journalFile, "rb");
+    if (!probe) {
+        return 0;
+    }
+    fclose(probe);
+
+    size_t size = 0;
+    unsigned char* data = (unsigned char*)config_read_file(journalFile, &size);
+    if (!data) {
+        return -1;
+    }
+    if (size == 0) {
+        free(data);
+        return 0;
+    }
+    if (size < JOURNAL_HEADER_SIZE || memcmp(data, JOURNAL_MAGIC, JOURNAL_HEADER_SIZE) != 0) {
+        printf("Error: %s is not a configuration journal.\n", journalFile);
+        free(data);
+        return -1;
+    }
+
+    size_t offset = JOURNAL_HEADER_SIZE;
+    while (size - offset >= JOURNAL_ENTRY_HEADER_SIZE) {
+        size_t payloadLength = get_u32(data + offset);
+        unsigned int sum = get_u32(data + offset + 4);
+        const unsigned char* payload = data + offset + JOURNAL_ENTRY_HEADER_SIZE;
+        if (size - offset - JOURNAL_ENTRY_HEADER_SIZE < payloadLength || checksum(payload, payloadLength) != sum) {
+            break;  // torn write at the tail
+        }
+        if (replay_entry(cm, payload, payloadLength) != 0) {
+            break;
+        }
+        offset += JOURNAL_ENTRY_HEADER_SIZE + payloadLength;
+    }
+    if (offset < size) {
+        printf("Discarding %zu trailing bytes of journal %s.\n", size - offset, journalFile);
+    }
+    free(data);
+    return (long long)offset;
+}
+
+
+static void journal_free(ConfigJournal* j) {
+    if (j->fd >= 0) {
+        config_fd_close(j->fd);
+    }
+    free(j->checkpointFile);
+    free(j->journalFile);
+    free(j->buffer);
+    free(j);
+}
+
+
+// Start journaling cm, after recovering from the checkpoint and the journal
+int open_config_journal(ConfigManager* cm, const char* checkpointFile, const char* journalFile, size_t checkpointBytes) {
+    if (!cm || !checkpointFile || !journalFile || cm->journal || config_bulk_resolve(cm) != 0) {
+        return -1;
+    }
+
+    FILE* probe = fopen(checkpointFile, "rb");
+    if (probe) {
+        fclose(probe);
+        if (load_config_from_file(cm, checkpointFile) != 0) {
+            return -1;
+        }
+    }
+    long long validSize = replay_journal(cm, journalFile);
+    if (validSize < 0) {
+        return -1;
+    }
+
+    ConfigJournal* j = (ConfigJournal*)calloc(1, sizeof(ConfigJournal));
+    if (!j) {
+        printf("Memory allocation for ConfigJournal failed.\n");
+        return -1;
+    }
+    j->checkpointFile = _strdup(checkpointFile);
+    j->journalFile = _strdup(journalFile);
+    j->checkpointBytes = checkpointBytes > 0 ? checkpointBytes : JOURNAL_DEFAULT_CHECKPOINT_BYTES;
+    j->fd = journal_open(journalFile);
+    if (!j->checkpointFile || !j->journalFile || j->fd < 0) {
+        printf("Error opening journal: %s\n", journalFile);
+        journal_free(j);
+        return -1;
+    }
+
+    int result = 0;
+    if (validSize == 0) {
+        // new journal: the header has to be on disk before any entry is
+        result = journal_truncate(j->fd, 0) != 0
+            || config_fd_write(&j->fd, JOURNAL_MAGIC, JOURNAL_HEADER_SIZE) != 0
+            || config_fd_sync(j->fd) != 0
+            || config_sync_parent_dir(journalFile) != 0 ? -1 : 0;
+        validSize = JOURNAL_HEADER_SIZE;
+    }
+    else {
+        result = journal_truncate(j->fd, (size_t)validSize) != 0 || config_fd_sync(j->fd) != 0 ? -1 : 0;
+    }
+    if (result != 0) {
+        printf("Error writing journal: %s\n", journalFile);
+        journal_free(j);
+        return -1;
+    }
+    j->size = (size_t)validSize;
+    cm->journal = j;
+    return 0;
+}
+
+
+// Save everything to the checkpoint file, then empty the journal
+int config_journal_checkpoint(ConfigManager* cm) {
+    if (!cm || !cm->journal) {
+        return -1;
+    }
+    ConfigJournal* j = cm->journal;
+    // compact with shortest floats still reads back bit for bit
+    if (config_save_atomic(cm, j->checkpointFile, CONFIG_SAVE_COMPACT) != 0) {
+        return -1;
+    }
+    if (journal_truncate(j->fd, JOURNAL_HEADER_SIZE) != 0 || config_fd_sync(j->fd) != 0) {
+        // entries left behind are replayed onto the newer checkpoint, which is harmless
+        printf("Error truncating journal: %s\n", j->journalFile);
+        return -1;
+    }
+    j->size = JOURNAL_HEADER_SIZE;
+    j->failed = 0;
+    return 0;
+}
+
+
+// Write a final checkpoint and stop journaling
+int close_config_journal(ConfigManager* cm) {
+    if (!cm || !cm->journal) {
+        return -1;
+    }
+    int result = config_journal_checkpoint(cm);
+    config_journal_free(cm);
+    return result;
+}
+
+
+void config_journal_free(ConfigManager* cm) {
+    if (cm->journal) {
+        journal_free(cm->journal);
+        cm->journal = NULL;
+    }
+}
+
+
+// Append and sync the entry for one change, called from config_notify.
+// return 0 once the change is on disk, in the journal or a checkpoint; -1 if it is only in memory.
+int config_journal_record(ConfigManager* cm, const char* key, ConfigChangeKind kind) {
+    ConfigJournal* j = cm->journal;
+    if (j->failed) {
+        // a partial entry may sit at the tail, only a checkpoint makes later changes replayable again
+        return config_journal_checkpoint(cm);
+    }
+
+    const KeyValuePair* kv = NULL;
+    if (kind != CONFIG_KEY_REMOVED) {
+        size_t pos = find_record_index(cm, key);
+        if (pos == CONFIG_NPOS) {
+            return 0;
+        }
+        kv = &cm->records[pos];
+    }
+
+    if (encode_entry(j, key, kv) != 0
+        || config_fd_write(&j->fd, j->buffer, j->bufferUsed) != 0
+        || config_fd_sync(j->fd) != 0) {
+        printf("Error writing journal: %s\n", j->journalFile);
+        j->failed = 1;
+        return config_journal_checkpoint(cm);
+    }
+    j->size += j->bufferUsed;
+
+    // the entry is already synced, a failed checkpoint only leaves the journal longer
+    if (j->size >= j->checkpointBytes) {
+        config_journal_checkpoint(cm);
+    }
+    return 0;
+}
+
+
+// Whether cm holds changes its journal could not make durable
+int config_journal_failed(ConfigManager* cm) {
+    return cm && cm->journal && cm->journal->failed;
+}
@@ -0,0 +1,279 @@
+#include "zhaoba_config_internal.h"
+#include "zhaoba_config_thread.h"
+#include <stdlib.h>
+#include <string.h>
+
+// JSON Lines: one minified {key, type, value} record per line, the same bytes a minified save puts
+// between its separators. A JSON string cannot hold a raw newline, so every '\n' ends a record: the
+// loader cuts the file at newlines and parses the pieces on separate threads, and a save can append.
+//
+// An append writes only the records whose changeStamp is newer than the last save or append of the
+// same file. Loading keeps the last line of a repeated key, so the file still reads as the current state.
+// What a line cannot express (a removed key, a changed type), or a file that is not the one last written,
+// turns the append into a rewrite.
+
+// ConfigManager.savedFlags bit that tells JSON Lines saves apart from array saves of the same file
+#define JSONL_SAVE_MARK (1u << 30)
+// below this many bytes per worker, thread start-up costs more than the parse it saves
+#define JSONL_MIN_CHUNK_BYTES (1 << 20)
+
+
+// ---- saving ----
+
+// Write the records changed after since (all of them when all is set), one per line
+static int write_lines(ConfigManager* cm, int fd, unsigned int flags, int all, unsigned long since) {
+    ConfigWriter* w = (ConfigWriter*)malloc(sizeof(ConfigWriter));
+    if (!w) {
+        printf("Memory allocation for writer failed.\n");
+        return -1;
+    }
+    ConfigWriter* scratch = NULL;
+    config_writer_init(w, config_fd_write, &fd, flags);
+
+    config_mutex_lock(&cm->saveLock);
+    for (size_t i = 0; i < cm->size && !w->failed; ++i) {
+        KeyValuePair* kv = &cm->records[i];
+        if (all || kv->changeStamp > since) {
+            config_write_cached_record(w, kv, &scratch);
+            config_writer_put(w, "\n", 1);
+        }
+    }
+    config_mutex_unlock(&cm->saveLock);
+
+    int result = config_writer_flush(w);
+    free(scratch);
+    free(w);
+    return result;
+}
+
+
+// Whether filename is exactly what the last JSON Lines save of cm with these flags left (same size,
+// modification time and file id), and every change since then can be written as a new line
+static int can_append(ConfigManager* cm, const char* filename, unsigned int flags) {
+    config_mutex_lock(&cm->saveLock);
+    int ok = cm->savedFile
+        && cm->savedFlags == flags
+        && cm->rewriteChangeCount <= cm->savedChangeCount
+        && strcmp(cm->savedFile, filename) == 0;
+    if (ok) {
+        ConfigFileStamp stamp;
+        config_file_stamp(filename, &stamp);
+        ok = config_file_stamp_equal(&stamp, &cm->savedStamp);
+    }
+    config_mutex_unlock(&cm->saveLock);
+    return ok;
+}
+
+
+static int save_lines(ConfigManager* cm, const char* filename, unsigned int flags, int append) {
+    if (!cm || !filename || config_bulk_resolve(cm) != 0) {
+        return -1;
+    }
+    // records are always minified, the layout flags that remain pick array sizes and float text
+    flags = (flags & (CONFIG_SAVE_OMIT_ARRAY_SIZE | CONFIG_SAVE_SHORTEST_FLOATS)) | CONFIG_SAVE_MINIFIED;
+    unsigned int savedFlags = flags | JSONL_SAVE_MARK;
+    if (config_save_is_current(cm, filename, savedFlags)) {
+        return 0;
+    }
+    unsigned long changeCount = cm->changeCount;
+
+    int fd = -1;
+    unsigned long since = 0;
+    if (append && can_append(cm, filename, savedFlags)) {
+        since = cm->savedChangeCount;
+        fd = config_file_open_append(filename);
+    }
+    int all = fd < 0;
+    if (all) {
+        fd = config_file_open_write(filename, 1);
+    }
+    if (fd < 0) {
+        printf("Error opening file: %s\n", filename);
+        return -1;
+    }
+
+    int result = write_lines(cm, fd, flags, all, since);
+    if (config_fd_close(fd) != 0) {
+        result = -1;
+    }
+    if (result != 0) {
+        printf("Error writing file: %s\n", filename);
+        return -1;
+    }
+    config_remember_save(cm, filename, savedFlags, changeCount);
+    return 0;
+}
+
+
+// Save configuration data as JSON Lines
+int save_config_to_jsonl(ConfigManager* cm, const char* filename, unsigned int flags) {
+    return save_lines(cm, filename, flags, 0);
+}
+
+
+// Append the records changed since the last JSON Lines save of the same file
+int append_config_to_jsonl(ConfigManager* cm, const char* filename, unsigned int flags) {
+    return save_lines(cm, filename, flags, 1);
+}
+
+
+// ---- loading ----
+
+// Whole lines [start, end) of the file, parsed by one worker
+typedef struct LineChunk {
+    const char* text;
+    size_t start;
+    size_t end;
+    int last;            // the chunk holding the end of the file, where a torn line may be
+    ConfigRecordList list;
+    int failed;
+    size_t errorOffset;
+    int torn;
+} LineChunk;
+
+
+static int is_line_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static void parse_lines(void* arg) {
+    LineChunk* chunk = (LineChunk*)arg;
+    const char* text = chunk->text;
+    size_t pos = chunk->start;
+
+    while (pos < chunk->end) {
+        const char* newline = (const char*)memchr(text + pos, '\n', chunk->end - pos);
+        size_t lineEnd = newline ? (size_t)(newline - text) : chunk->end;
+        size_t first = pos;
+        while (first < lineEnd && is_line_space(text[first])) ++first;
+        if (first == lineEnd) {
+            pos = lineEnd + 1;
+            continue;
+        }
+
+        const char* parseEnd = NULL;
+        cJSON* item = cJSON_ParseWithLengthOptsReentrant(text + first, lineEnd - first, &parseEnd, 0);
+        size_t rest = item ? (size_t)(parseEnd - text) : lineEnd;
+        while (rest < lineEnd && is_line_space(text[rest])) ++rest;
+        if (!item || rest != lineEnd) {
+            cJSON_Delete(item);
+            if (!newline && chunk->last) {
+                chunk->torn = 1;   // a write cut short, the lines before it are complete
+            }
+            else {
+                chunk->failed = 1;
+                chunk->errorOffset = pos;
+            }
+            break;
+        }
+
+        KeyValuePair kv;
+        if (config_record_from_json(item, &kv) == 0 && config_record_list_append(&chunk->list, &kv) != 0) {
+            free_key_value_pair(&kv);
+            chunk->failed = 1;
+            chunk->errorOffset = pos;
+        }
+        cJSON_Delete(item);
+        if (chunk->failed) {
+            break;
+        }
+        pos = lineEnd + 1;
+    }
+}
+
+
+// Load configuration data from a JSON Lines file using several worker threads
+int load_config_from_jsonl(ConfigManager* cm, const char* filename, unsigned int threadCount) {
+    if (!cm || !filename) {
+        return -1;
+    }
+    size_t size = 0;
+    char* text = config_read_file(filename, &size);
+    if (!text) {
+        return -1;
+    }
+
+    if (threadCount == 0) {
+        threadCount = config_cpu_count();
+    }
+    size_t maxChunks = size / JSONL_MIN_CHUNK_BYTES + 1;
+    size_t chunkCount = threadCount < maxChunks ? threadCount : maxChunks;
+
+    LineChunk* chunks = (LineChunk*)calloc(chunkCount, sizeof(LineChunk));
+    config_thread_t* threads = (config_thread_t*)calloc(chunkCount, sizeof(config_thread_t));
+    int* started = (int*)calloc(chunkCount, sizeof(int));
+    if (!chunks || !threads || !started) {
+        free(chunks);
+        free(threads);
+        free(started);
+        free(text);
+        return -1;
+    }
+
+    // every chunk starts right after a newline, so the cuts are exact record boundaries
+    for (size_t c = 0; c < chunkCount; ++c) {
+        size_t start = 0;
+        if (c > 0) {
+            size_t from = size / chunkCount * c;
+            const char* newline = (const char*)memchr(text + from, '\n', size - from);
+            start = newline ? (size_t)(newline - text) + 1 : size;
+            if (start < chunks[c - 1].start) {
+                start = chunks[c - 1].start;
+            }
+        }
+        chunks[c].text = text;
+        chunks[c].start = start;
+    }
+    for (size_t c = 0; c < chunkCount; ++c) {
+        chunks[c].end = c + 1 < chunkCount ? chunks[c + 1].start : size;
+        chunks[c].last = chunks[c].end == size;
+    }
+
+    for (size_t c = 1; c < chunkCount; ++c) {
+        started[c] = config_thread_create(&threads[c], parse_lines, &chunks[c]) == 0;
+        if (!started[c]) {
+            parse_lines(&chunks[c]);
+        }
+    }
+    parse_lines(&chunks[0]);
+    for (size_t c = 1; c < chunkCount; ++c) {
+        if (started[c]) {
+            config_thread_join(threads[c]);
+        }
+    }
+
+    int result = 0;
+    for (size_t c = 0; c < chunkCount; ++c) {
+        if (chunks[c].failed) {
+            printf("Error parsing JSON Lines record at offset %zu in %s\n", chunks[c].errorOffset, filename);
+            result = -1;
+            break;
+        }
+        if (chunks[c].torn) {
+            printf("Ignoring incomplete last line of %s\n", filename);
+        }
+    }
+
+    // merge in file order, so a later line for the same key wins
+    if (result == 0) {
+        int bulk = begin_config_bulk_load(cm) == 0;
+        for (size_t c = 0; c < chunkCount; ++c) {
+            for (size_t i = 0; i < chunks[c].list.count; ++i) {
+                config_put_record(cm, &chunks[c].list.records[i]);
+            }
+            chunks[c].list.count = 0;
+        }
+        if (bulk) {
+            result = end_config_bulk_load(cm);
+        }
+    }
+
+    for (size_t c = 0; c < chunkCount; ++c) {
+        config_record_list_free(&chunks[c].list);
+    }
+    free(chunks);
+    free(threads);
+    free(started);
+    free(text);
+    return result;
+}
@@ -0,0 +1,143 @@
+#include "zhaoba_config_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Layered configuration: defaults, site file, host file, runtime overrides, each in its own manager.
+//
+// The manager holding the layers keeps their flattened view as its ordinary records, so fetch,
+// save and watch work on it unchanged and a fetch is one index lookup however many layers there are.
+// Every change notified by a layer (store, delete, load, reload, journal replay) re-resolves just
+// that key: the layers are probed from the top, and the view takes the winner's value, or drops the
+// key when no layer has it. The view notifies its own callback only when its value really changed.
+
+
+// Layer position of name, CONFIG_NPOS if cm has no such layer
+static size_t find_layer(const ConfigManager* cm, const char* name) {
+    for (size_t i = 0; i < cm->layerCount; ++i) {
+        if (strcmp(cm->layers[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return CONFIG_NPOS;
+}
+
+
+// Re-resolve key in the flattened view after a layer changed it
+void config_layer_changed(ConfigManager* view, const char* key) {
+    const KeyValuePair* winner = NULL;
+    for (size_t l = view->layerCount; l-- > 0 && !winner; ) {
+        ConfigManager* layer = view->layers[l].cm;
+        size_t i = find_record_index(layer, key);
+        if (i != CONFIG_NPOS) {
+            winner = &layer->records[i];
+        }
+    }
+
+    size_t pos = find_record_index(view, key);
+    if (!winner) {
+        if (pos != CONFIG_NPOS) {
+            delete_value_by_key(view, key);
+        }
+        return;
+    }
+    if (pos != CONFIG_NPOS && view->records[pos].valueHash == winner->valueHash
+        && config_values_equal(&view->records[pos], winner)) {
+        return;
+    }
+
+    void* value = winner->type == INT || winner->type == FLOAT ? (void*)&winner->value : (void*)winner->value.stringValue;
+    KeyValuePair kv = create_key_value_pair(winner->key, value, winner->type, winner->arraySize);
+    if (!kv.key) {
+        return;
+    }
+    if (pos != CONFIG_NPOS) {
+        config_replace_record(view, pos, &kv);
+    }
+    else {
+        config_put_record(view, &kv);
+    }
+}
+
+
+// Add a layer on top of the layers of cm
+ConfigManager* add_config_layer(ConfigManager* cm, const char* name) {
+    if (!cm || !name) {
+        return NULL;
+    }
+    if (find_layer(cm, name) != CONFIG_NPOS) {
+        printf("Error: configuration layer '%s' already exists.\n", name);
+        return NULL;
+    }
+
+    ConfigLayer* layers = (ConfigLayer*)realloc(cm->layers, (cm->layerCount + 1) * sizeof(ConfigLayer));
+    if (!layers) {
+        printf("Memory allocation for configuration layer failed.\n");
+        return NULL;
+    }
+    cm->layers = layers;
+
+    ConfigManager* layer = create_config_manager();
+    char* layerName = _strdup(name);
+    if (!layer || !layerName) {
+        free_config_manager(layer);
+        free(layerName);
+        return NULL;
+    }
+    layer->layerView = cm;
+    cm->layers[cm->layerCount].name = layerName;
+    cm->layers[cm->layerCount].cm = layer;
+    cm->layerCount++;
+    return layer;
+}
+
+
+// Find a layer of cm by name
+ConfigManager* get_config_layer(ConfigManager* cm, const char* name) {
+    if (!cm || !name) {
+        return NULL;
+    }
+    size_t i = find_layer(cm, name);
+    return i == CONFIG_NPOS ? NULL : cm->layers[i].cm;
+}
+
+
+// Remove a layer and free it
+int remove_config_layer(ConfigManager* cm, const char* name) {
+    if (!cm || !name) {
+        return -1;
+    }
+    size_t i = find_layer(cm, name);
+    if (i == CONFIG_NPOS) {
+        printf("Configuration layer '%s' not found.\n", name);
+        return -1;
+    }
+
+    ConfigLayer removed = cm->layers[i];
+    memmove(&cm->layers[i], &cm->layers[i + 1], (cm->layerCount - i - 1) * sizeof(ConfigLayer));
+    cm->layerCount--;
+
+    // the keys of the removed layer now resolve to the layers left, or leave the view
+    ConfigManager* layer = removed.cm;
+    if (config_bulk_resolve(layer) == 0) {
+        for (size_t r = 0; r < layer->size; ++r) {
+            config_layer_changed(cm, layer->records[r].key);
+        }
+    }
+    layer->layerView = NULL;
+    free_config_manager(layer);
+    free(removed.name);
+    return 0;
+}
+
+
+// Free the layers of cm
+void config_layers_free(ConfigManager* cm) {
+    for (size_t i = 0; i < cm->layerCount; ++i) {
+        cm->layers[i].cm->layerView = NULL;
+        free_config_manager(cm->layers[i].cm);
+        free(cm->layers[i].name);
+    }
+    free(cm->layers);
+    cm->layers = NULL;
+    cm->layerCount = 0;
+}
@@ -1,562 +1,1239 @@
-#include "zhaoba_config_manager.h"
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include "cJSON.h"
-
-#define CONFIG_FILE_PATH "config.json"
-
-
-
-// Union to store values of different types (int, float, string, and arrays of them)
-union Value {
-    int intValue;
-    float floatValue;
-    char* stringValue;
-    int* intArrayValue;
-    float* floatArrayValue;
-    char** stringArrayValue;
-};
-
-// Struct to store a key-value pair
-struct KeyValuePair {
-    char* key;
-    Value value;
-    ValueType type;
-    size_t arraySize;
-};
-
-// Struct to represent the configuration manager
-struct ConfigManager {
-    KeyValuePair* records;
-    size_t size;
-    size_t capacity;
-};
-
-// Create a new key-value pair
-KeyValuePair create_key_value_pair(const char* key, void* value, ValueType type, size_t arraySize) {
-    KeyValuePair kv;
-    kv.key = NULL;
-    kv.arraySize = 0;
-    int error = 0;
-
-    if (!key) {
-        printf("Key cannot be NULL.\n");
-        return kv;
-    }
-
-    kv.key = _strdup(key);
-    kv.type = type;
-    kv.arraySize = arraySize;
-
-    switch (type) {
-    case INT:
-        kv.value.intValue = *(int*)value;
-        break;
-    case FLOAT:
-        kv.value.floatValue = *(float*)value;
-        break;
-    case STRING:
-        kv.value.stringValue = _strdup((char*)value);
-        if (!kv.value.stringValue) error = 1;
-        break;
-    case INT_ARRAY:
-        kv.value.intArrayValue = (int*)malloc(arraySize * sizeof(int));
-        if (!kv.value.intArrayValue) {
-            printf("Memory allocation for int array failed.\n");
-            error = 1;
-        }
-        else {
-            memcpy(kv.value.intArrayValue, value, arraySize * sizeof(int));
-        }
-        break;
-    case FLOAT_ARRAY:
-        kv.value.floatArrayValue = (float*)malloc(arraySize * sizeof(float));
-        if (!kv.value.floatArrayValue) {
-            printf("Memory allocation for float array failed.\n");
-            error = 1;
-        }
-        else {
-            memcpy(kv.value.floatArrayValue, value, arraySize * sizeof(float));
-        }
-        break;
-    case STRING_ARRAY:
-        kv.value.stringArrayValue = (char**)malloc(arraySize * sizeof(char*));
-        if (!kv.value.stringArrayValue) {
-            printf("Memory allocation for string array failed.\n");
-            error = 1;
-        }
-        else {
-            for (size_t i = 0; i < arraySize; ++i) {
-                kv.value.stringArrayValue[i] = _strdup(((char**)value)[i]);
-                if (!kv.value.stringArrayValue[i]) {
-                    printf("Memory allocation for string array element failed.\n");
-                    for (size_t j = 0; j < i; ++j) {
-                        free(kv.value.stringArrayValue[j]);
-                    }
-                    free(kv.value.stringArrayValue);
-                    kv.value.stringArrayValue = NULL;
-                    error = 1;
-                    break;
-                }
-            }
-        }
-        break;
-    default:
-        printf("Error: Unsupported ValueType.\n");
-        error = 1;
-        break;
-    }
-
-    if (error) {
-        free(kv.key);
-        kv.key = NULL;  // Mark as invalid
-    }
-
-    return kv;
-}
-
-
-// Initialize a new configuration manager
-ConfigManager* create_config_manager() {
-    ConfigManager* cm = (ConfigManager*)malloc(sizeof(ConfigManager));
-    if (!cm) {
-        printf("Memory allocation for ConfigManager failed.\n");
-        return NULL;
-    }
-
-    cm->capacity = 10;   
-    cm->size = 0;
-
-    cm->records = (KeyValuePair*)malloc(cm->capacity * sizeof(KeyValuePair));
-    if (!cm->records) {
-        printf("Memory allocation for records array failed.\n");
-        free(cm);  
-        return NULL;
-    }
-
-    for (size_t i = 0; i < cm->capacity; ++i) {
-        cm->records[i].key = NULL;
-        cm->records[i].value.stringValue = NULL;
-        cm->records[i].type = -1;  
-        cm->records[i].arraySize = 0;
-    }
-
-    return cm;
-}
-
-
-
-// Free the memory used by a configuration manager
-    void free_config_manager(ConfigManager* cm) {
-        if (cm != NULL) {
-            for (size_t i = 0; i < cm->size; ++i) {
-                if (cm->records[i].key) {
-                    free(cm->records[i].key);
-                }
-
-                switch (cm->records[i].type) {
-                case STRING:
-                    if (cm->records[i].value.stringValue) {
-                        free(cm->records[i].value.stringValue);
-                    }
-                    break;
-
-                case STRING_ARRAY:
-                    if (cm->records[i].value.stringArrayValue) {
-                        for (size_t j = 0; j < cm->records[i].arraySize; ++j) {
-                            if (cm->records[i].value.stringArrayValue[j]) {
-                                free(cm->records[i].value.stringArrayValue[j]);
-                            }
-                        }
-                        free(cm->records[i].value.stringArrayValue);
-                    }
-                    break;
-
-                case INT_ARRAY:
-                    if (cm->records[i].value.intArrayValue) {
-                        free(cm->records[i].value.intArrayValue);
-                    }
-                    break;
-
-                case FLOAT_ARRAY:
-                    if (cm->records[i].value.floatArrayValue) {
-                        free(cm->records[i].value.floatArrayValue);
-                    }
-                    break;
-
-                case INT:
-                case FLOAT:
-                    break;
-
-                default:
-                    printf("Warning: Unrecognized type in free_config_manager.\n");
-                    break;
-                }
-            }
-            free(cm->records);
-            free(cm);
-        }
-    }
-
-
-// Store a value by key
-    int store_value_by_key(ConfigManager* cm, const char* key, void* value, ValueType type, size_t arraySize) {
-        if (!cm || !key || !value) {
-            return -1;  
-        }
-
-        for (size_t i = 0; i < cm->size; ++i) {
-            if (strcmp(cm->records[i].key, key) == 0) {
-                if (cm->records[i].type != type) {
-                    printf("Type mismatch. Cannot store value of type %d for key %s (current type: %d).\n", type, key, cm->records[i].type);
-                    return -1;
-                }
-
-                switch (type) {
-                case INT:
-                    cm->records[i].value.intValue = *(int*)value;
-                    break;
-
-                case FLOAT:
-
-                    cm->records[i].value.floatValue = *(float*)value;
-                    break;
-
-                case STRING:
-                    free(cm->records[i].value.stringValue);  
-                    cm->records[i].value.stringValue = _strdup((char*)value); 
-                    break;
-
-                case INT_ARRAY:
-                    free(cm->records[i].value.intArrayValue);  
-                    cm->records[i].value.intArrayValue = (int*)malloc(arraySize * sizeof(int));
-                    if (!cm->records[i].value.intArrayValue) {
-                        return -1;  
-                    }
-                    memcpy(cm->records[i].value.intArrayValue, value, arraySize * sizeof(int));  
-                    cm->records[i].arraySize = arraySize;
-                    break;
-
-                case FLOAT_ARRAY:
-                    free(cm->records[i].value.floatArrayValue);  
-                    cm->records[i].value.floatArrayValue = (float*)malloc(arraySize * sizeof(float));
-                    if (!cm->records[i].value.floatArrayValue) {
-                        return -1;  
-                    }
-                    memcpy(cm->records[i].value.floatArrayValue, value, arraySize * sizeof(float));  
-                    cm->records[i].arraySize = arraySize;
-                    break;
-
-                case STRING_ARRAY:
-                    if (cm->records[i].value.stringArrayValue) {
-                        for (size_t j = 0; j < cm->records[i].arraySize; ++j) {
-                            free(cm->records[i].value.stringArrayValue[j]);
-                        }
-                        free(cm->records[i].value.stringArrayValue);
-                    }
-
-                    cm->records[i].value.stringArrayValue = (char**)malloc(arraySize * sizeof(char*));
-                    if (!cm->records[i].value.stringArrayValue ) {
-                        return -1; 
-                    }
-
-                    for (size_t j = 0; j < arraySize; ++j) {
-                        cm->records[i].value.stringArrayValue[j] = _strdup(((char**)value)[j]);
-                    }
-                    cm->records[i].arraySize = arraySize;
-                    break;
-
-                default:
-                    return -1; 
-                }
-                return 0; 
-            }
-        }
-
-        if (cm->size >= cm->capacity) {
-            cm->capacity *= 2;  
-            cm->records = realloc(cm->records, cm->capacity * sizeof(KeyValuePair));
-            if (!cm->records) {
-                return -1; 
-            }
-        }
-
-        cm->records[cm->size++] = create_key_value_pair(key, value, type, arraySize);
-        return 0;  
-    }
-
-
-// Fetch a value by key with error handling
-int fetch_value_by_key(ConfigManager* cm, const char* key, void* valueOut, ValueType expectedType) {
-    if (!cm || !key || !valueOut ) {
-        return -1;  
-    }
-
-    for (size_t i = 0; i < cm->size; ++i) {
-        if (cm->records[i].key && strcmp(cm->records[i].key, key) == 0) {
-
-
-            if (cm->records[i].type != expectedType) {
-                printf("Type mismatch: Expected type does not match stored type for key '%s'.\n", key);
-                return -1;
-            }
-
-            switch (expectedType) {
-            case INT:
-                *(int*)valueOut = cm->records[i].value.intValue;
-                break;
-            case FLOAT:
-                *(float*)valueOut = cm->records[i].value.floatValue;
-                break;
-            case STRING:
-                *(char**)valueOut = cm->records[i].value.stringValue;
-                break;
-            case INT_ARRAY:
-                memcpy(valueOut, cm->records[i].value.intArrayValue, cm->records[i].arraySize * sizeof(int));
-                break;
-            case FLOAT_ARRAY:
-                memcpy(valueOut, cm->records[i].value.floatArrayValue, cm->records[i].arraySize * sizeof(float));
-                break;
-            case STRING_ARRAY:
-                memcpy(valueOut, cm->records[i].value.stringArrayValue, cm->records[i].arraySize * sizeof(char*));
-                break;
-            default:
-                return -1;
-            }
-
-            return 0;  
-        }
-    }
-
-    printf("Key '%s' not found.\n", key);
-    return -1;  
-}
-
-int load_config_from_file(ConfigManager* cm, const char* filename) {
-    if (!cm || !filename) {
-        return -1;  
-    }
-
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        printf("Error opening file: %s\n", filename);
-        return -1;
-    }
-
-
-    fseek(file, 0, SEEK_END);
-    long fileSize = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    char* fileContent = (char*)malloc(fileSize + 1);
-    if (!fileContent) {
-        fclose(file);
-        return -1;  
-    }
-    fread(fileContent, 1, fileSize, file);
-    fileContent[fileSize] = '\0';  
-    fclose(file);
-
-
-    cJSON* root = cJSON_Parse(fileContent);
-    free(fileContent);  
-    if (!root) {
-        printf("Error parsing JSON: %s\n", cJSON_GetErrorPtr());
-        return -1;
-    }
-
-    cJSON* item = NULL;
-    cJSON_ArrayForEach(item, root) {
-        if (!cJSON_IsObject(item)) continue;
-
-        const char* key = cJSON_GetObjectItem(item, "key")->valuestring;
-        const char* typeStr = cJSON_GetObjectItem(item, "type")->valuestring;
-        ValueType type;
-
-        if (strcmp(typeStr, "INT") == 0) {
-            type = INT;
-            int intValue = cJSON_GetObjectItem(item, "value")->valueint;
-            store_value_by_key(cm, key, &intValue, INT, 0);
-        }
-        else if (strcmp(typeStr, "FLOAT") == 0) {
-            type = FLOAT;
-            float floatValue = (float)cJSON_GetObjectItem(item, "value")->valuedouble;
-            store_value_by_key(cm, key, &floatValue, FLOAT, 0);
-        }
-        else if (strcmp(typeStr, "STRING") == 0) {
-            type = STRING;
-            const char* stringValue = cJSON_GetObjectItem(item, "value")->valuestring;
-            store_value_by_key(cm, key, (void*)stringValue, STRING, 0);
-        }
-        else if (strcmp(typeStr, "INT_ARRAY") == 0) {
-            type = INT_ARRAY;
-            cJSON* arrayItem = cJSON_GetObjectItem(item, "value");
-            size_t arraySize = cJSON_GetArraySize(arrayItem);
-            int* intArray = (int*)malloc(arraySize * sizeof(int));
-            for (size_t i = 0; i < arraySize; ++i) {
-                intArray[i] = cJSON_GetArrayItem(arrayItem, i)->valueint;
-            }
-            store_value_by_key(cm, key, intArray, INT_ARRAY, arraySize);
-            free(intArray);
-        }
-        else if (strcmp(typeStr, "FLOAT_ARRAY") == 0) {
-            type = FLOAT_ARRAY;
-            cJSON* arrayItem = cJSON_GetObjectItem(item, "value");
-            size_t arraySize = cJSON_GetArraySize(arrayItem);
-            float* floatArray = (float*)malloc(arraySize * sizeof(float));
-            for (size_t i = 0; i < arraySize; ++i) {
-                floatArray[i] = (float)cJSON_GetArrayItem(arrayItem, i)->valuedouble;
-            }
-            store_value_by_key(cm, key, floatArray, FLOAT_ARRAY, arraySize);
-            free(floatArray);
-        }
-        else if (strcmp(typeStr, "STRING_ARRAY") == 0) {
-            type = STRING_ARRAY;
-            cJSON* arrayItem = cJSON_GetObjectItem(item, "value");
-            size_t arraySize = cJSON_GetArraySize(arrayItem);
-            char** stringArray = (char**)malloc(arraySize * sizeof(char*));
-            for (size_t i = 0; i < arraySize; ++i) {
-                const char* strValue = cJSON_GetArrayItem(arrayItem, i)->valuestring;
-                stringArray[i] = _strdup(strValue);
-            }
-            store_value_by_key(cm, key, stringArray, STRING_ARRAY, arraySize);
-
-            for (size_t i = 0; i < arraySize; ++i) {
-                free(stringArray[i]);
-            }
-            free(stringArray);
-        }
-    }
-
-    cJSON_Delete(root);  
-    return 0;  
-}
-
-
-
-// Save configuration data to a file
-int save_config_to_file(ConfigManager* cm, const char* filename) {
-    if (!cm || !filename) {
-        return -1;  
-    }
-
-
-    cJSON* root = cJSON_CreateArray();
-    if (!root) {
-        return -1;  
-    }
-
-    for (size_t i = 0; i < cm->size; ++i) {
-        cJSON* item = cJSON_CreateObject();
-        if (!item) continue;
-
-        cJSON_AddStringToObject(item, "key", cm->records[i].key);
-
-        const char* typeStr = NULL;
-        switch (cm->records[i].type) {
-        case INT: typeStr = "INT"; break;
-        case FLOAT: typeStr = "FLOAT"; break;
-        case STRING: typeStr = "STRING"; break;
-        case INT_ARRAY: typeStr = "INT_ARRAY"; break;
-        case FLOAT_ARRAY: typeStr = "FLOAT_ARRAY"; break;
-        case STRING_ARRAY: typeStr = "STRING_ARRAY"; break;
-        default: break;
-        }
-        cJSON_AddStringToObject(item, "type", typeStr);
-
-        cJSON* valueItem = NULL;
-        if (cm->records[i].type == INT) {
-            valueItem = cJSON_CreateNumber(cm->records[i].value.intValue);
-        }
-        else if (cm->records[i].type == FLOAT) {
-            valueItem = cJSON_CreateNumber(cm->records[i].value.floatValue);
-        }
-        else if (cm->records[i].type == STRING) {
-            valueItem = cJSON_CreateString(cm->records[i].value.stringValue);
-        }
-        else if (cm->records[i].type == INT_ARRAY) {
-            valueItem = cJSON_CreateArray();
-            for (size_t j = 0; j < cm->records[i].arraySize; ++j) {
-                cJSON_AddItemToArray(valueItem, cJSON_CreateNumber(cm->records[i].value.intArrayValue[j]));
-            }
-        }
-        else if (cm->records[i].type == FLOAT_ARRAY) {
-            valueItem = cJSON_CreateArray();
-            for (size_t j = 0; j < cm->records[i].arraySize; ++j) {
-                cJSON_AddItemToArray(valueItem, cJSON_CreateNumber(cm->records[i].value.floatArrayValue[j]));
-            }
-        }
-        else if (cm->records[i].type == STRING_ARRAY) {
-            valueItem = cJSON_CreateArray();
-            for (size_t j = 0; j < cm->records[i].arraySize; ++j) {
-                cJSON_AddItemToArray(valueItem, cJSON_CreateString(cm->records[i].value.stringArrayValue[j]));
-            }
-        }
-
-        cJSON_AddItemToObject(item, "value", valueItem);
-        cJSON_AddNumberToObject(item, "arraySize", cm->records[i].arraySize);  
-        cJSON_AddItemToArray(root, item);
-    }
-
-    FILE* file = fopen(filename, "w");
-    if (!file) {
-        cJSON_Delete(root);
-        return -1;  
-    }
-
-    char* jsonString = cJSON_Print(root);
-    fwrite(jsonString, sizeof(char), strlen(jsonString), file);
-    fclose(file);
-
-
-    free(jsonString);
-    cJSON_Delete(root);
-    return 0;  
-}
-
-// fetch and print all values from the configuration
-void print_config_values(ConfigManager* cm) {
-
-    int fetchedInt;
-    if (fetch_value_by_key(cm, "key_int", &fetchedInt, INT) == 0) {
-        printf("Fetched INT value: %d\n", fetchedInt);
-    }
-
-    float fetchedFloat;
-    if (fetch_value_by_key(cm, "key_float", &fetchedFloat, FLOAT) == 0) {
-        printf("Fetched FLOAT value: %.2f\n", fetchedFloat);
-    }
-
-    char* fetchedString;
-    if (fetch_value_by_key(cm, "key_string", &fetchedString, STRING) == 0) {
-        printf("Fetched STRING value: %s\n", fetchedString);
-    }
-
-    int fetchedIntArray[5];
-    if (fetch_value_by_key(cm, "key_int_array", fetchedIntArray, INT_ARRAY) == 0) {
-        printf("Fetched INT_ARRAY value: ");
-        for (int i = 0; i < 5; ++i) {
-            printf("%d ", fetchedIntArray[i]);
-        }
-        printf("\n");
-    }
-
-    float fetchedFloatArray[3];
-    if (fetch_value_by_key(cm, "key_float_array", fetchedFloatArray, FLOAT_ARRAY) == 0) {
-        printf("Fetched FLOAT_ARRAY value: ");
-        for (int i = 0; i < 3; ++i) {
-            printf("%.2f ", fetchedFloatArray[i]);
-        }
-        printf("\n");
-    }
-
-    char* fetchedStringArray[3];
-    if (fetch_value_by_key(cm, "key_string_array", fetchedStringArray, STRING_ARRAY) == 0) {
-        printf("Fetched STRING_ARRAY value: ");
-        for (int i = 0; i < 3; ++i) {
-            printf("%s ", fetchedStringArray[i]);
-        }
-        printf("\n");
-    }
-}
-
+#include "zhaoba_config_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CONFIG_FILE_PATH "config.json"
+
+
+
+// Create a new key-value pair
+KeyValuePair create_key_value_pair(const char* key, void* value, ValueType type, size_t arraySize) {
+    KeyValuePair kv;
+    kv.key = NULL;
+    kv.arraySize = 0;
+    kv.rendered = NULL;
+    kv.changeStamp = 0;
+    int error = 0;
+
+    if (!key) {
+        printf("Key cannot be NULL.\n");
+        return kv;
+    }
+
+    kv.key = _strdup(key);
+    kv.keyHash = config_hash_key(key);
+    kv.type = type;
+    kv.arraySize = arraySize;
+
+    switch (type) {
+    case INT:
+        kv.value.intValue = *(int*)value;
+        break;
+    case FLOAT:
+        kv.value.floatValue = *(float*)value;
+        break;
+    case STRING:
+        kv.value.stringValue = _strdup((char*)value);
+        if (!kv.value.stringValue) error = 1;
+        break;
+    case INT_ARRAY:
+        kv.value.intArrayValue = (int*)malloc(arraySize ? arraySize * sizeof(int) : 1);
+        if (!kv.value.intArrayValue) {
+            printf("Memory allocation for int array failed.\n");
+            error = 1;
+        }
+        else {
+            if (arraySize > 0) memcpy(kv.value.intArrayValue, value, arraySize * sizeof(int));
+        }
+        break;
+    case FLOAT_ARRAY:
+        kv.value.floatArrayValue = (float*)malloc(arraySize ? arraySize * sizeof(float) : 1);
+        if (!kv.value.floatArrayValue) {
+            printf("Memory allocation for float array failed.\n");
+            error = 1;
+        }
+        else {
+            if (arraySize > 0) memcpy(kv.value.floatArrayValue, value, arraySize * sizeof(float));
+        }
+        break;
+    case STRING_ARRAY:
+        kv.value.stringArrayValue = (char**)malloc(arraySize ? arraySize * sizeof(char*) : 1);
+        if (!kv.value.stringArrayValue) {
+            printf("Memory allocation for string array failed.\n");
+            error = 1;
+        }
+        else {
+            for (size_t i = 0; i < arraySize; ++i) {
+                kv.value.stringArrayValue[i] = _strdup(((char**)value)[i]);
+                if (!kv.value.stringArrayValue[i]) {
+                    printf("Memory allocation for string array element failed.\n");
+                    for (size_t j = 0; j < i; ++j) {
+                        free(kv.value.stringArrayValue[j]);
+                    }
+                    free(kv.value.stringArrayValue);
+                    kv.value.stringArrayValue = NULL;
+                    error = 1;
+                    break;
+                }
+            }
+        }
+        break;
+    default:
+        printf("Error: Unsupported ValueType.\n");
+        error = 1;
+        break;
+    }
+
+    if (error) {
+        free(kv.key);
+        kv.key = NULL;  // Mark as invalid
+    }
+    else {
+        kv.valueHash = config_hash_value(&kv);
+    }
+
+    return kv;
+}
+
+
+// Free the key and value owned by a key-value pair
+void free_key_value_pair(KeyValuePair* kv) {
+    if (!kv) {
+        return;
+    }
+
+    if (kv->key) {
+        switch (kv->type) {
+        case STRING:
+            free(kv->value.stringValue);
+            break;
+
+        case STRING_ARRAY:
+            if (kv->value.stringArrayValue) {
+                for (size_t j = 0; j < kv->arraySize; ++j) {
+                    free(kv->value.stringArrayValue[j]);
+                }
+                free(kv->value.stringArrayValue);
+            }
+            break;
+
+        case INT_ARRAY:
+            free(kv->value.intArrayValue);
+            break;
+
+        case FLOAT_ARRAY:
+            free(kv->value.floatArrayValue);
+            break;
+
+        case INT:
+        case FLOAT:
+            break;
+
+        default:
+            printf("Warning: Unrecognized type in free_key_value_pair.\n");
+            break;
+        }
+        free(kv->key);
+    }
+    free(kv->rendered);
+
+    kv->key = NULL;
+    kv->value.stringValue = NULL;
+    kv->arraySize = 0;
+    kv->rendered = NULL;
+}
+
+
+void config_record_dirty(KeyValuePair* kv) {
+    free(kv->rendered);
+    kv->rendered = NULL;
+}
+
+
+// Notify an added or changed record, stamping it with the change number it is about to get
+static int notify_record(ConfigManager* cm, KeyValuePair* kv, ConfigChangeKind kind) {
+    kv->changeStamp = cm->changeCount + 1;
+    return config_notify(cm, kv->key, kind);
+}
+
+
+// FNV-1a, cheap and well distributed for short ASCII keys
+unsigned int config_hash_key(const char* key) {
+    unsigned int hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)key; *p; ++p) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+static unsigned int hash_bytes(unsigned int hash, const void* data, size_t length) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+// Hash of a record's type and value, so reloads can skip unchanged records without a deep compare
+unsigned int config_hash_value(const KeyValuePair* kv) {
+    unsigned int hash = 2166136261u;
+    hash = hash_bytes(hash, &kv->type, sizeof(kv->type));
+    hash = hash_bytes(hash, &kv->arraySize, sizeof(kv->arraySize));
+
+    switch (kv->type) {
+    case INT:
+        return hash_bytes(hash, &kv->value.intValue, sizeof(int));
+    case FLOAT:
+        return hash_bytes(hash, &kv->value.floatValue, sizeof(float));
+    case STRING:
+        return kv->value.stringValue ? hash_bytes(hash, kv->value.stringValue, strlen(kv->value.stringValue)) : hash;
+    case INT_ARRAY:
+        return hash_bytes(hash, kv->value.intArrayValue, kv->arraySize * sizeof(int));
+    case FLOAT_ARRAY:
+        return hash_bytes(hash, kv->value.floatArrayValue, kv->arraySize * sizeof(float));
+    case STRING_ARRAY:
+        for (size_t i = 0; i < kv->arraySize; ++i) {
+            // include the terminator so {"ab","c"} and {"a","bc"} differ
+            const char* element = kv->value.stringArrayValue[i];
+            hash = element ? hash_bytes(hash, element, strlen(element) + 1) : hash;
+        }
+        return hash;
+    default:
+        return hash;
+    }
+}
+
+
+// Deep compare of two values of any type
+int config_values_equal(const KeyValuePair* a, const KeyValuePair* b) {
+    if (a->type != b->type || a->arraySize != b->arraySize) {
+        return 0;
+    }
+
+    switch (a->type) {
+    case INT:
+        return a->value.intValue == b->value.intValue;
+    case FLOAT:
+        return memcmp(&a->value.floatValue, &b->value.floatValue, sizeof(float)) == 0;
+    case STRING:
+        return strcmp(a->value.stringValue, b->value.stringValue) == 0;
+    case INT_ARRAY:
+        return memcmp(a->value.intArrayValue, b->value.intArrayValue, a->arraySize * sizeof(int)) == 0;
+    case FLOAT_ARRAY:
+        return memcmp(a->value.floatArrayValue, b->value.floatArrayValue, a->arraySize * sizeof(float)) == 0;
+    case STRING_ARRAY:
+        for (size_t i = 0; i < a->arraySize; ++i) {
+            if (strcmp(a->value.stringArrayValue[i], b->value.stringArrayValue[i]) != 0) {
+                return 0;
+            }
+        }
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+
+// Look up a key through the index
+size_t find_record_index(const ConfigManager* cm, const char* key) {
+    if (!cm || !key) {
+        return CONFIG_NPOS;
+    }
+
+    unsigned int hash = config_hash_key(key);
+    if (cm->bulkMode) {
+        // unindexed bulk records, newest first so the last write wins
+        for (size_t i = cm->size; i-- > cm->bulkStart; ) {
+            if (cm->records[i].keyHash == hash && strcmp(cm->records[i].key, key) == 0) {
+                return i;
+            }
+        }
+    }
+    if (cm->indexCapacity == 0) {
+        return CONFIG_NPOS;
+    }
+
+    size_t mask = cm->indexCapacity - 1;
+    for (size_t slot = hash & mask; cm->index[slot] != 0; slot = (slot + 1) & mask) {
+        const KeyValuePair* kv = &cm->records[cm->index[slot] - 1];
+        if (kv->keyHash == hash && strcmp(kv->key, key) == 0) {
+            return cm->index[slot] - 1;
+        }
+    }
+    return CONFIG_NPOS;
+}
+
+
+// Empty index table for count records, NULL on allocation failure
+static size_t* index_alloc(size_t count, size_t* capacityOut) {
+    size_t capacity = 16;
+    while (capacity < count * 2) {
+        capacity *= 2;
+    }
+    size_t* index = (size_t*)calloc(capacity, sizeof(size_t));
+    if (!index) {
+        printf("Memory allocation for key index failed.\n");
+        return NULL;
+    }
+    *capacityOut = capacity;
+    return index;
+}
+
+// Fill an empty table from cm->records and make it cm's index
+static void index_install(ConfigManager* cm, size_t* index, size_t capacity) {
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < cm->size; ++i) {
+        size_t slot = cm->records[i].keyHash & mask;
+        while (index[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        index[slot] = i + 1;
+    }
+
+    free(cm->index);
+    cm->index = index;
+    cm->indexCapacity = capacity;
+}
+
+
+// Rebuild the index from scratch, sized for the current records
+int config_index_rebuild(ConfigManager* cm) {
+    size_t capacity;
+    size_t* index = index_alloc(cm->size, &capacity);
+    if (!index) {
+        return -1;
+    }
+    index_install(cm, index, capacity);
+    return 0;
+}
+
+
+// Add the record at position pos to the index, growing the table when it passes half full
+static int index_insert(ConfigManager* cm, size_t pos) {
+    if (cm->indexCapacity < cm->size * 2) {
+        return config_index_rebuild(cm);
+    }
+
+    size_t mask = cm->indexCapacity - 1;
+    size_t slot = cm->records[pos].keyHash & mask;
+    while (cm->index[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+    cm->index[slot] = pos + 1;
+    return 0;
+}
+
+
+// Append a new record, growing records[] and the index as needed
+static int append_record(ConfigManager* cm, KeyValuePair* kv) {
+    if (cm->size >= cm->capacity) {
+        size_t capacity = cm->capacity * 2;
+        KeyValuePair* records = realloc(cm->records, capacity * sizeof(KeyValuePair));
+        if (!records) {
+            printf("Memory allocation for records array failed.\n");
+            return -1;
+        }
+        cm->records = records;
+        cm->capacity = capacity;
+    }
+
+    cm->records[cm->size++] = *kv;
+    if (!cm->bulkMode && index_insert(cm, cm->size - 1) != 0) {
+        cm->size--;
+        return -1;
+    }
+    return 0;
+}
+
+
+// Initialize a new configuration manager
+ConfigManager* create_config_manager() {
+    ConfigManager* cm = (ConfigManager*)malloc(sizeof(ConfigManager));
+    if (!cm) {
+        printf("Memory allocation for ConfigManager failed.\n");
+        return NULL;
+    }
+
+    cm->capacity = 10;   
+    cm->size = 0;
+    cm->index = NULL;
+    cm->indexCapacity = 0;
+    cm->onChange = NULL;
+    cm->onChangeData = NULL;
+    cm->journal = NULL;
+    cm->changeCount = 0;
+    cm->rewriteChangeCount = 0;
+    cm->savedFile = NULL;
+    cm->savedFlags = 0;
+    cm->savedChangeCount = 0;
+    memset(&cm->savedStamp, 0, sizeof(cm->savedStamp));
+    cm->bulkMode = 0;
+    cm->bulkStart = 0;
+    cm->layers = NULL;
+    cm->layerCount = 0;
+    cm->layerView = NULL;
+    cm->bindings = NULL;
+
+    cm->records = (KeyValuePair*)malloc(cm->capacity * sizeof(KeyValuePair));
+    if (!cm->records) {
+        printf("Memory allocation for records array failed.\n");
+        free(cm);  
+        return NULL;
+    }
+
+    for (size_t i = 0; i < cm->capacity; ++i) {
+        cm->records[i].key = NULL;
+        cm->records[i].value.stringValue = NULL;
+        cm->records[i].type = -1;  
+        cm->records[i].arraySize = 0;
+        cm->records[i].rendered = NULL;
+    }
+    config_mutex_init(&cm->saveLock);
+
+    return cm;
+}
+
+
+
+// Free the memory used by a configuration manager
+void free_config_manager(ConfigManager* cm) {
+    if (cm != NULL) {
+        for (size_t i = 0; i < cm->size; ++i) {
+            free_key_value_pair(&cm->records[i]);
+        }
+        config_journal_free(cm);
+        config_layers_free(cm);
+        config_bindings_free(cm);
+        config_mutex_destroy(&cm->saveLock);
+        free(cm->savedFile);
+        free(cm->records);
+        free(cm->index);
+        free(cm);
+    }
+}
+
+
+// Copy every record into a new, independent manager
+ConfigManager* config_clone(ConfigManager* cm) {
+    if (config_bulk_resolve(cm) != 0) {
+        return NULL;
+    }
+    ConfigManager* copy = create_config_manager();
+    if (!copy) {
+        return NULL;
+    }
+    if (cm->size > copy->capacity) {
+        KeyValuePair* records = (KeyValuePair*)realloc(copy->records, cm->size * sizeof(KeyValuePair));
+        if (!records) {
+            free_config_manager(copy);
+            return NULL;
+        }
+        copy->records = records;
+        copy->capacity = cm->size;
+    }
+
+    for (size_t i = 0; i < cm->size; ++i) {
+        KeyValuePair* kv = &cm->records[i];
+        void* value = kv->type == INT || kv->type == FLOAT ? (void*)&kv->value : (void*)kv->value.stringValue;
+        copy->records[i] = create_key_value_pair(kv->key, value, kv->type, kv->arraySize);
+        if (!copy->records[i].key) {
+            free_config_manager(copy);
+            return NULL;
+        }
+        copy->size = i + 1;
+    }
+    if (config_index_rebuild(copy) != 0) {
+        free_config_manager(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+
+// Store a value by key
+    int store_value_by_key(ConfigManager* cm, const char* key, void* value, ValueType type, size_t arraySize) {
+        if (!cm || !key || !value) {
+            return -1;  
+        }
+
+        size_t i = cm->bulkMode ? CONFIG_NPOS : find_record_index(cm, key);
+        if (i != CONFIG_NPOS) {
+            if (cm->records[i].type != type) {
+                printf("Type mismatch. Cannot store value of type %d for key %s (current type: %d).\n", type, key, cm->records[i].type);
+                return -1;
+            }
+
+            switch (type) {
+            case INT:
+                cm->records[i].value.intValue = *(int*)value;
+                break;
+
+            case FLOAT:
+
+                cm->records[i].value.floatValue = *(float*)value;
+                break;
+
+            case STRING:
+                free(cm->records[i].value.stringValue);  
+                cm->records[i].value.stringValue = _strdup((char*)value); 
+                break;
+
+            case INT_ARRAY:
+                free(cm->records[i].value.intArrayValue);  
+                cm->records[i].value.intArrayValue = (int*)malloc(arraySize * sizeof(int));
+                if (!cm->records[i].value.intArrayValue) {
+                    return -1;  
+                }
+                memcpy(cm->records[i].value.intArrayValue, value, arraySize * sizeof(int));  
+                cm->records[i].arraySize = arraySize;
+                break;
+
+            case FLOAT_ARRAY:
+                free(cm->records[i].value.floatArrayValue);  
+                cm->records[i].value.floatArrayValue = (float*)malloc(arraySize * sizeof(float));
+                if (!cm->records[i].value.floatArrayValue) {
+                    return -1;  
+                }
+                memcpy(cm->records[i].value.floatArrayValue, value, arraySize * sizeof(float));  
+                cm->records[i].arraySize = arraySize;
+                break;
+
+            case STRING_ARRAY:
+                if (cm->records[i].value.stringArrayValue) {
+                    for (size_t j = 0; j < cm->records[i].arraySize; ++j) {
+                        free(cm->records[i].value.stringArrayValue[j]);
+                    }
+                    free(cm->records[i].value.stringArrayValue);
+                }
+
+                cm->records[i].value.stringArrayValue = (char**)malloc(arraySize * sizeof(char*));
+                if (!cm->records[i].value.stringArrayValue ) {
+                    return -1; 
+                }
+
+                for (size_t j = 0; j < arraySize; ++j) {
+                    cm->records[i].value.stringArrayValue[j] = _strdup(((char**)value)[j]);
+                }
+                cm->records[i].arraySize = arraySize;
+                break;
+
+            default:
+                return -1; 
+            }
+            cm->records[i].valueHash = config_hash_value(&cm->records[i]);
+            config_record_dirty(&cm->records[i]);
+            return notify_record(cm, &cm->records[i], CONFIG_KEY_CHANGED);
+        }
+
+        KeyValuePair kv = create_key_value_pair(key, value, type, arraySize);
+        if (!kv.key) {
+            return -1;
+        }
+        if (append_record(cm, &kv) != 0) {
+            free_key_value_pair(&kv);
+            return -1;
+        }
+        if (!cm->bulkMode) {
+            return notify_record(cm, &cm->records[cm->size - 1], CONFIG_KEY_ADDED);
+        }
+        return 0;  
+    }
+
+
+// Fetch a value by key with error handling
+int fetch_value_by_key(ConfigManager* cm, const char* key, void* valueOut, ValueType expectedType) {
+    if (!cm || !key || !valueOut ) {
+        return -1;  
+    }
+
+    size_t i = find_record_index(cm, key);
+    if (i != CONFIG_NPOS) {
+        if (cm->records[i].type != expectedType) {
+            printf("Type mismatch: Expected type does not match stored type for key '%s'.\n", key);
+            return -1;
+        }
+
+        switch (expectedType) {
+        case INT:
+            *(int*)valueOut = cm->records[i].value.intValue;
+            break;
+        case FLOAT:
+            *(float*)valueOut = cm->records[i].value.floatValue;
+            break;
+        case STRING:
+            *(char**)valueOut = cm->records[i].value.stringValue;
+            break;
+        case INT_ARRAY:
+            memcpy(valueOut, cm->records[i].value.intArrayValue, cm->records[i].arraySize * sizeof(int));
+            break;
+        case FLOAT_ARRAY:
+            memcpy(valueOut, cm->records[i].value.floatArrayValue, cm->records[i].arraySize * sizeof(float));
+            break;
+        case STRING_ARRAY:
+            memcpy(valueOut, cm->records[i].value.stringArrayValue, cm->records[i].arraySize * sizeof(char*));
+            break;
+        default:
+            return -1;
+        }
+
+        return 0;  
+    }
+
+    printf("Key '%s' not found.\n", key);
+    return -1;  
+}
+
+// Fold the unchecked bulk records into the store in one pass
+//
+// a table over all positions is built once; a repeated key moves its newer value into the first
+// record with that key and the newer record is dropped, which gives the same result, order and
+// type-mismatch handling as storing the records one by one.
+int config_bulk_resolve(ConfigManager* cm) {
+    if (!cm->bulkMode || cm->bulkStart == cm->size) {
+        return 0;
+    }
+
+    size_t capacity = 16;
+    while (capacity < cm->size * 2) {
+        capacity *= 2;
+    }
+    size_t* table = (size_t*)calloc(capacity, sizeof(size_t));
+    // state[i]: 1 = dropped duplicate, 2 = existing record that took a new value
+    unsigned char* state = (unsigned char*)calloc(cm->size, 1);
+    if (!table || !state) {
+        printf("Memory allocation for key index failed.\n");
+        free(table);
+        free(state);
+        return -1;
+    }
+
+    size_t mask = capacity - 1;
+    size_t dropped = 0;
+    for (size_t i = 0; i < cm->size; ++i) {
+        KeyValuePair* kv = &cm->records[i];
+        size_t slot = kv->keyHash & mask;
+        size_t found = CONFIG_NPOS;
+        if (i >= cm->bulkStart) {
+            for (; table[slot] != 0; slot = (slot + 1) & mask) {
+                const KeyValuePair* other = &cm->records[table[slot] - 1];
+                if (other->keyHash == kv->keyHash && strcmp(other->key, kv->key) == 0) {
+                    found = table[slot] - 1;
+                    break;
+                }
+            }
+        }
+        if (found == CONFIG_NPOS) {
+            while (table[slot] != 0) {
+                slot = (slot + 1) & mask;
+            }
+            table[slot] = i + 1;
+            continue;
+        }
+
+        KeyValuePair* target = &cm->records[found];
+        if (target->type != kv->type) {
+            printf("Type mismatch. Cannot store value of type %d for key %s (current type: %d).\n", kv->type, kv->key, target->type);
+        }
+        else {
+            Value oldValue = target->value;
+            size_t oldSize = target->arraySize;
+            target->value = kv->value;
+            target->arraySize = kv->arraySize;
+            target->valueHash = kv->valueHash;
+            kv->value = oldValue;
+            kv->arraySize = oldSize;
+            config_record_dirty(target);
+            if (found < cm->bulkStart) {
+                state[found] = 2;
+            }
+        }
+        free_key_value_pair(kv);
+        state[i] = 1;
+        dropped++;
+    }
+
+    if (dropped == 0) {
+        free(cm->index);
+        cm->index = table;
+        cm->indexCapacity = capacity;
+    }
+    else {
+        free(table);
+        size_t kept = 0;
+        for (size_t i = 0; i < cm->size; ++i) {
+            if (state[i] != 1) {
+                state[kept] = state[i];
+                cm->records[kept++] = cm->records[i];
+            }
+        }
+        cm->size = kept;
+        if (config_index_rebuild(cm) != 0) {
+            free(state);
+            return -1;
+        }
+    }
+
+    size_t firstNew = cm->bulkStart;
+    cm->bulkStart = cm->size;
+    for (size_t i = 0; i < cm->size; ++i) {
+        if (state[i] == 2) {
+            notify_record(cm, &cm->records[i], CONFIG_KEY_CHANGED);
+        }
+        else if (i >= firstNew) {
+            notify_record(cm, &cm->records[i], CONFIG_KEY_ADDED);
+        }
+    }
+    free(state);
+    return 0;
+}
+
+
+// Enter bulk-load mode
+int begin_config_bulk_load(ConfigManager* cm) {
+    if (!cm || cm->bulkMode) {
+        return -1;
+    }
+    cm->bulkMode = 1;
+    cm->bulkStart = cm->size;
+    return 0;
+}
+
+
+// Resolve everything appended in bulk-load mode and leave the mode
+int end_config_bulk_load(ConfigManager* cm) {
+    if (!cm || !cm->bulkMode) {
+        return -1;
+    }
+    int result = config_bulk_resolve(cm);
+    cm->bulkMode = 0;
+    return result;
+}
+
+
+// Move an owned key-value pair into the manager
+int config_put_record(ConfigManager* cm, KeyValuePair* kv) {
+    size_t i = cm->bulkMode ? CONFIG_NPOS : find_record_index(cm, kv->key);
+    if (i != CONFIG_NPOS) {
+        if (cm->records[i].type != kv->type) {
+            printf("Type mismatch. Cannot store value of type %d for key %s (current type: %d).\n", kv->type, kv->key, cm->records[i].type);
+            free_key_value_pair(kv);
+            return -1;
+        }
+        return config_replace_record(cm, i, kv);
+    }
+
+    if (append_record(cm, kv) != 0) {
+        free_key_value_pair(kv);
+        return -1;
+    }
+    if (!cm->bulkMode) {
+        return notify_record(cm, &cm->records[cm->size - 1], CONFIG_KEY_ADDED);
+    }
+    return 0;
+}
+
+
+// Replace a stored value, the type may change
+int config_replace_record(ConfigManager* cm, size_t pos, KeyValuePair* kv) {
+    KeyValuePair* record = &cm->records[pos];
+
+    // keep the stored key, swap in the new value and free the old one together with the incoming key
+    Value oldValue = record->value;
+    ValueType oldType = record->type;
+    size_t oldSize = record->arraySize;
+    record->value = kv->value;
+    record->type = kv->type;
+    record->arraySize = kv->arraySize;
+    record->valueHash = kv->valueHash;
+    kv->value = oldValue;
+    kv->type = oldType;
+    kv->arraySize = oldSize;
+    free_key_value_pair(kv);
+    config_record_dirty(record);
+
+    int result = notify_record(cm, record, CONFIG_KEY_CHANGED);
+    if (record->type != oldType) {
+        cm->rewriteChangeCount = cm->changeCount;
+    }
+    return result;
+}
+
+
+// Compact records[] around the removed entries, then notify and free them
+int config_remove_records(ConfigManager* cm, const unsigned char* removeMask, size_t maskSize) {
+    if (maskSize > cm->size) {
+        maskSize = cm->size;
+    }
+    size_t removedCount = 0;
+    for (size_t i = 0; i < maskSize; ++i) {
+        if (removeMask[i]) removedCount++;
+    }
+    if (removedCount == 0) {
+        return 0;
+    }
+
+    // everything that can fail is allocated before the records move
+    size_t capacity;
+    size_t* index = index_alloc(cm->size - removedCount, &capacity);
+    KeyValuePair* removed = (KeyValuePair*)malloc(removedCount * sizeof(KeyValuePair));
+    if (!index || !removed) {
+        free(index);
+        free(removed);
+        return -1;
+    }
+
+    size_t kept = 0;
+    size_t r = 0;
+    for (size_t i = 0; i < cm->size; ++i) {
+        if (i >= maskSize || !removeMask[i]) {
+            cm->records[kept++] = cm->records[i];
+        }
+        else {
+            removed[r++] = cm->records[i];
+        }
+    }
+    cm->size = kept;
+    index_install(cm, index, capacity);
+
+    for (size_t i = 0; i < r; ++i) {
+        config_notify(cm, removed[i].key, CONFIG_KEY_REMOVED);
+        free_key_value_pair(&removed[i]);
+    }
+    free(removed);
+    return 0;
+}
+
+
+int config_notify(ConfigManager* cm, const char* key, ConfigChangeKind kind) {
+    cm->changeCount++;
+    if (kind == CONFIG_KEY_REMOVED) {
+        cm->rewriteChangeCount = cm->changeCount;
+    }
+    int result = 0;
+    if (cm->journal) {
+        result = config_journal_record(cm, key, kind);
+    }
+    if (cm->layerView) {
+        config_layer_changed(cm->layerView, key);
+    }
+    if (cm->onChange) {
+        cm->onChange(cm, key, kind, cm->onChangeData);
+    }
+    return result;
+}
+
+
+// Get the type and element count of a stored value
+int config_value_info(ConfigManager* cm, const char* key, ValueType* typeOut, size_t* arraySizeOut) {
+    if (!cm || !key) {
+        return -1;
+    }
+    size_t i = find_record_index(cm, key);
+    if (i == CONFIG_NPOS) {
+        return -1;
+    }
+    if (typeOut) {
+        *typeOut = cm->records[i].type;
+    }
+    if (arraySizeOut) {
+        *arraySizeOut = cm->records[i].arraySize;
+    }
+    return 0;
+}
+
+
+// Delete a value by key
+int delete_value_by_key(ConfigManager* cm, const char* key) {
+    if (!cm || !key || config_bulk_resolve(cm) != 0) {
+        return -1;
+    }
+
+    size_t i = find_record_index(cm, key);
+    if (i == CONFIG_NPOS) {
+        printf("Key '%s' not found.\n", key);
+        return -1;
+    }
+
+    // the new index is allocated first, so a failure leaves cm untouched
+    size_t capacity;
+    size_t* index = index_alloc(cm->size - 1, &capacity);
+    if (!index) {
+        return -1;
+    }
+    KeyValuePair removed = cm->records[i];
+    memmove(&cm->records[i], &cm->records[i + 1], (cm->size - i - 1) * sizeof(KeyValuePair));
+    cm->size--;
+    index_install(cm, index, capacity);
+
+    int result = config_notify(cm, removed.key, CONFIG_KEY_REMOVED);
+    free_key_value_pair(&removed);
+    return result;
+}
+
+
+// Register a change callback
+void set_config_change_callback(ConfigManager* cm, ConfigChangeCallback callback, void* userData) {
+    if (!cm) {
+        return;
+    }
+    cm->onChange = callback;
+    cm->onChangeData = userData;
+}
+
+
+// Map a "type" string from a saved record to its ValueType
+static int parse_type_string(const char* typeStr, ValueType* type) {
+    static const char* const names[] = { "INT", "FLOAT", "STRING", "INT_ARRAY", "FLOAT_ARRAY", "STRING_ARRAY" };
+    for (int t = INT; t <= STRING_ARRAY; ++t) {
+        if (strcmp(typeStr, names[t]) == 0) {
+            *type = (ValueType)t;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+
+// Build an owned key-value pair from one JSON record
+int config_record_from_json(const cJSON* item, KeyValuePair* kv) {
+    kv->key = NULL;
+    kv->value.stringValue = NULL;
+    kv->arraySize = 0;
+    kv->rendered = NULL;
+    kv->changeStamp = 0;
+
+    if (!cJSON_IsObject(item)) {
+        return -1;
+    }
+
+    const cJSON* keyItem = cJSON_GetObjectItem(item, "key");
+    const cJSON* typeItem = cJSON_GetObjectItem(item, "type");
+    const cJSON* valueItem = cJSON_GetObjectItem(item, "value");
+    if (!cJSON_IsString(keyItem) || !cJSON_IsString(typeItem) || !valueItem) {
+        return -1;
+    }
+
+    ValueType type;
+    if (parse_type_string(typeItem->valuestring, &type) != 0) {
+        return -1;
+    }
+
+    size_t arraySize = 0;
+    if (type >= INT_ARRAY) {
+        if (!cJSON_IsArray(valueItem)) {
+            return -1;
+        }
+        arraySize = (size_t)cJSON_GetArraySize(valueItem);
+    }
+    else if ((type == STRING && !cJSON_IsString(valueItem)) || (type != STRING && !cJSON_IsNumber(valueItem))) {
+        return -1;
+    }
+
+    kv->key = _strdup(keyItem->valuestring);
+    if (!kv->key) {
+        return -1;
+    }
+    kv->keyHash = config_hash_key(kv->key);
+    kv->type = type;
+    kv->arraySize = arraySize;
+
+    int error = 0;
+    size_t n = 0;
+    const cJSON* element = NULL;
+    switch (type) {
+    case INT:
+        kv->value.intValue = valueItem->valueint;
+        break;
+    case FLOAT:
+        kv->value.floatValue = (float)valueItem->valuedouble;
+        break;
+    case STRING:
+        kv->value.stringValue = _strdup(valueItem->valuestring);
+        if (!kv->value.stringValue) error = 1;
+        break;
+    case INT_ARRAY:
+        kv->value.intArrayValue = (int*)malloc(arraySize * sizeof(int) + 1);
+        if (!kv->value.intArrayValue) {
+            error = 1;
+            break;
+        }
+        cJSON_ArrayForEach(element, valueItem) {
+            kv->value.intArrayValue[n++] = element->valueint;
+        }
+        break;
+    case FLOAT_ARRAY:
+        kv->value.floatArrayValue = (float*)malloc(arraySize * sizeof(float) + 1);
+        if (!kv->value.floatArrayValue) {
+            error = 1;
+            break;
+        }
+        cJSON_ArrayForEach(element, valueItem) {
+            kv->value.floatArrayValue[n++] = (float)element->valuedouble;
+        }
+        break;
+    case STRING_ARRAY:
+        kv->value.stringArrayValue = (char**)calloc(arraySize + 1, sizeof(char*));
+        if (!kv->value.stringArrayValue) {
+            error = 1;
+            break;
+        }
+        cJSON_ArrayForEach(element, valueItem) {
+            const char* strValue = cJSON_GetStringValue(element);
+            kv->value.stringArrayValue[n] = _strdup(strValue ? strValue : "");
+            if (!kv->value.stringArrayValue[n++]) error = 1;
+        }
+        break;
+    default:
+        error = 1;
+        break;
+    }
+
+    if (error) {
+        printf("Memory allocation for record '%s' failed.\n", kv->key);
+        free_key_value_pair(kv);
+        return -1;
+    }
+    kv->valueHash = config_hash_value(kv);
+    return 0;
+}
+
+
+// Read a whole file into memory, sizes beyond 2GB included
+char* config_read_file(const char* filename, size_t* sizeOut) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        printf("Error opening file: %s\n", filename);
+        return NULL;
+    }
+
+#ifdef _WIN32
+    _fseeki64(file, 0, SEEK_END);
+    long long fileSize = _ftelli64(file);
+    _fseeki64(file, 0, SEEK_SET);
+#else
+    fseeko(file, 0, SEEK_END);
+    long long fileSize = (long long)ftello(file);
+    fseeko(file, 0, SEEK_SET);
+#endif
+    if (fileSize < 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    char* fileContent = (char*)malloc((size_t)fileSize + 1);
+    if (!fileContent) {
+        printf("Memory allocation for file contents failed.\n");
+        fclose(file);
+        return NULL;
+    }
+    size_t readSize = fread(fileContent, 1, (size_t)fileSize, file);
+    fileContent[readSize] = '\0';
+    fclose(file);
+
+    if (config_is_compressed(fileContent, readSize)) {
+        char* inflated = config_inflate(fileContent, readSize, &readSize);
+        free(fileContent);
+        fileContent = inflated;
+        if (!fileContent) {
+            return NULL;
+        }
+    }
+
+    if (sizeOut) {
+        *sizeOut = readSize;
+    }
+    return fileContent;
+}
+
+
+// Load configuration data from a file in whichever format it is
+int load_config_from_file(ConfigManager* cm, const char* filename) {
+    if (!cm || !filename) {
+        return -1;  
+    }
+    const ConfigCodec* codec = detect_config_codec(filename);
+    if (!codec) {
+        return -1;
+    }
+    int result = codec->load(cm, filename);
+    if (result == 0) {
+        config_bindings_refresh(cm);
+    }
+    return result;
+}
+
+
+// Load a JSON record array into cm with a single cJSON tree (the JSON codec for small files)
+int config_load_json(ConfigManager* cm, const char* filename) {
+    if (config_file_is_compressed(filename)) {
+        return config_load_compressed(cm, filename);
+    }
+
+    size_t fileSize = 0;
+    char* fileContent = config_read_file(filename, &fileSize);
+    if (!fileContent) {
+        return -1;
+    }
+
+
+    cJSON* root = cJSON_ParseWithLength(fileContent, fileSize);
+    if (!root) {
+        // the error pointer points into fileContent, so report before freeing it
+        printf("Error parsing JSON: %s\n", cJSON_GetErrorPtr());
+        free(fileContent);
+        return -1;
+    }
+    free(fileContent);  
+
+    // records go in unchecked and duplicates are resolved once at the end
+    int bulk = begin_config_bulk_load(cm) == 0;
+    cJSON* item = NULL;
+    cJSON_ArrayForEach(item, root) {
+        KeyValuePair kv;
+        if (config_record_from_json(item, &kv) != 0) continue;
+        config_put_record(cm, &kv);
+    }
+    int result = bulk ? end_config_bulk_load(cm) : 0;
+
+    cJSON_Delete(root);  
+    return result;  
+}
+
+
+
+static int write_to_file(void* context, const char* data, size_t length) {
+    return fwrite(data, 1, length, (FILE*)context) == length ? 0 : -1;
+}
+
+
+// Save configuration data to a file
+int save_config_to_file(ConfigManager* cm, const char* filename) {
+    return save_config_to_file_with_flags(cm, filename, CONFIG_SAVE_DEFAULT);
+}
+
+
+// Whether filename still holds the last save of cm, made with the same flags and no change since
+int config_save_is_current(ConfigManager* cm, const char* filename, unsigned int flags) {
+    config_mutex_lock(&cm->saveLock);
+    int current = cm->savedFile
+        && cm->savedChangeCount == cm->changeCount
+        && cm->savedFlags == flags
+        && strcmp(cm->savedFile, filename) == 0;
+    if (current) {
+        // the file must also be untouched since: not rewritten in place, not replaced
+        ConfigFileStamp stamp;
+        config_file_stamp(filename, &stamp);
+        current = config_file_stamp_equal(&stamp, &cm->savedStamp);
+    }
+    config_mutex_unlock(&cm->saveLock);
+    return current;
+}
+
+
+// Record a finished save of filename for config_save_is_current
+void config_remember_save(ConfigManager* cm, const char* filename, unsigned int flags, unsigned long changeCount) {
+    char* savedFile = _strdup(filename);
+    ConfigFileStamp savedStamp;
+    config_file_stamp(filename, &savedStamp);
+    config_mutex_lock(&cm->saveLock);
+    free(cm->savedFile);
+    cm->savedFile = savedFile;
+    cm->savedFlags = flags;
+    cm->savedChangeCount = changeCount;
+    cm->savedStamp = savedStamp;
+    config_mutex_unlock(&cm->saveLock);
+}
+
+
+// Save configuration data to a file with a selected layout
+int save_config_to_file_with_flags(ConfigManager* cm, const char* filename, unsigned int flags) {
+    if (!cm || !filename || config_bulk_resolve(cm) != 0) {
+        return -1;  
+    }
+    // a file named for another format is written by that format's codec
+    const ConfigCodec* codec = config_codec_for_save(filename);
+    if (codec) {
+        return config_codec_save(codec, cm, filename, flags);
+    }
+    if (config_save_is_current(cm, filename, flags)) {
+        return 0;
+    }
+    unsigned long changeCount = cm->changeCount;
+
+    int result = config_save_json(cm, filename, flags);
+    if (result == 0) {
+        config_remember_save(cm, filename, flags, changeCount);
+    }
+    return result;  
+}
+
+
+// Write cm as a JSON record array (the JSON codec's save)
+int config_save_json(ConfigManager* cm, const char* filename, unsigned int flags) {
+    if (flags & CONFIG_SAVE_ATOMIC) {
+        return config_save_atomic(cm, filename, flags);
+    }
+    FILE* file = fopen(filename, (flags & CONFIG_SAVE_COMPRESSED) ? "wb" : "w");
+    if (!file) {
+        return -1;  
+    }
+
+    int result = save_config_to_stream(cm, write_to_file, file, flags);
+    if (fclose(file) != 0) {
+        printf("Error writing file: %s\n", filename);
+        result = -1;
+    }
+    return result;
+}
+
+// fetch and print all values from the configuration
+void print_config_values(ConfigManager* cm) {
+
+    int fetchedInt;
+    if (fetch_value_by_key(cm, "key_int", &fetchedInt, INT) == 0) {
+        printf("Fetched INT value: %d\n", fetchedInt);
+    }
+
+    float fetchedFloat;
+    if (fetch_value_by_key(cm, "key_float", &fetchedFloat, FLOAT) == 0) {
+        printf("Fetched FLOAT value: %.2f\n", fetchedFloat);
+    }
+
+    char* fetchedString;
+    if (fetch_value_by_key(cm, "key_string", &fetchedString, STRING) == 0) {
+        printf("Fetched STRING value: %s\n", fetchedString);
+    }
+
+    int fetchedIntArray[5];
+    if (fetch_value_by_key(cm, "key_int_array", fetchedIntArray, INT_ARRAY) == 0) {
+        printf("Fetched INT_ARRAY value: ");
+        for (int i = 0; i < 5; ++i) {
+            printf("%d ", fetchedIntArray[i]);
+        }
+        printf("\n");
+    }
+
+    float fetchedFloatArray[3];
+    if (fetch_value_by_key(cm, "key_float_array", fetchedFloatArray, FLOAT_ARRAY) == 0) {
+        printf("Fetched FLOAT_ARRAY value: ");
+        for (int i = 0; i < 3; ++i) {
+            printf("%.2f ", fetchedFloatArray[i]);
+        }
+        printf("\n");
+    }
+
+    char* fetchedStringArray[3];
+    if (fetch_value_by_key(cm, "key_string_array", fetchedStringArray, STRING_ARRAY) == 0) {
+        printf("Fetched STRING_ARRAY value: ");
+        for (int i = 0; i < 3; ++i) {
+            printf("%s ", fetchedStringArray[i]);
+        }
+        printf("\n");
+    }
+}
+
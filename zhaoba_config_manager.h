@@ -1,87 +1,813 @@
-#ifndef zhaoba_CONFIG_MANAGER_H
-#define zhaoba_CONFIG_MANAGER_H
-
-#include <stddef.h>  
-
-// Forward declarations of the structs and union
-typedef struct KeyValuePair KeyValuePair;
-typedef struct ConfigManager ConfigManager;
-typedef union Value Value;
-
-// Enum to define the type of the value
-typedef enum ValueType {
-    INT,
-    FLOAT,
-    STRING,
-    INT_ARRAY,
-    FLOAT_ARRAY,
-    STRING_ARRAY
-} ValueType;
-
-// Function Prototypes
-
-
-// Initialize a new configuration manager
-// 
-// Create and populate the initial ConfigManager, set initial value of size to 0, initial capasity to 10, initialize records[]
-// memory allocation failed, return NULL;
-//
-ConfigManager* create_config_manager();
-
-// Free the memory used by a configuration manager
-
-void free_config_manager(ConfigManager* cm);
-
-// Store a value by key
-//
-// input existing configManage name, keyname, value, ValueType and unsigned arraySize, 
-// then store supported data to configmanager. 
-// supported ValueType:INT,FLOAT,STRING,INT_ARRAY,FLOAT_ARRAY, and STRING_ARRAY. standing int, float, string and their arrays.
-// return 0 stands for store successfully.
-// return -1 for unsupported ValueType or invalid input. 
-// *****Example*****
-//     int intValue = 42;
-//      store_value_by_key(cm, "key_int", &intValue, INT, 0);
-//     const char* stringArray[] = { "apple", "banana", "cherry" };
-//      store_value_by_key(cm, "key_string_array", stringArray, STRING_ARRAY, 3);
-//
-int store_value_by_key(ConfigManager* cm, const char* key, void* value, ValueType type, size_t arraySize);
-
-// Fetch a value by key
-// 
-// input existing configManage name, keyname,expectedType, and expected valueoutput variable name valueOut, then you can get value in ValueOut
-// return 0 for fetch successfully.
-// return -1 for invalid parameter, type mismatch, or key not found.
-// ****Example****
-//          int fetchedInt;
-//          if (fetch_value_by_key(cm, "key_int", &fetchedInt, INT) == 0) {
-//           printf("Fetched INT value: %d\n", fetchedInt);
-//          }
-//
-
-int fetch_value_by_key(ConfigManager* cm, const char* key, void* valueOut, ValueType expectedType);
-
-// Load configuration data from a file
-//
-// using the third party library cJSON.h, load from JSON file filename to an existing config manager cm
-// return 0 for load successfully
-// return -1 for invalid parameters, error opening file, error parsing JSON file
-//
-int load_config_from_file(ConfigManager* cm, const char* filename);
-
-// Save configuration data to a file
-//
-// using the third party library cJSON.h, save a config manager cm to a JSON file filename
-// return 0 for load successfully
-// return -1 for invalid parameters, error writting file
-//
-int save_config_to_file(ConfigManager* cm, const char* filename);
-
-//helper function for test, fetch and print all values from the configuration
-// 
-// input exist config manager cm, print all items.
-// if cm is null, exit the function.
-//
-void print_config_values(ConfigManager* cm);
-
-#endif // zhaoba_CONFIG_MANAGER_H
+#ifndef zhaoba_CONFIG_MANAGER_H
+#define zhaoba_CONFIG_MANAGER_H
+
+#include <stddef.h>  
+
+// Forward declarations of the structs and union
+typedef struct KeyValuePair KeyValuePair;
+typedef struct ConfigManager ConfigManager;
+typedef union Value Value;
+typedef struct ConfigWatcher ConfigWatcher;
+typedef struct ConfigSaveHandle ConfigSaveHandle;
+typedef struct ConfigSnapshot ConfigSnapshot;
+typedef struct ConfigBinding ConfigBinding;
+
+// Enum to define the type of the value
+typedef enum ValueType {
+    INT,
+    FLOAT,
+    STRING,
+    INT_ARRAY,
+    FLOAT_ARRAY,
+    STRING_ARRAY
+} ValueType;
+
+// Kind of change reported to a ConfigChangeCallback
+typedef enum ConfigChangeKind {
+    CONFIG_KEY_ADDED,
+    CONFIG_KEY_CHANGED,
+    CONFIG_KEY_REMOVED
+} ConfigChangeKind;
+
+// Called after a key is added, changed or removed. key is only valid during the call.
+typedef void (*ConfigChangeCallback)(ConfigManager* cm, const char* key, ConfigChangeKind kind, void* userData);
+
+// Options for the save functions, combine with |
+typedef enum ConfigSaveFlags {
+    CONFIG_SAVE_DEFAULT = 0,             // pretty-printed with tabs and newlines, the classic cJSON_Print layout
+    CONFIG_SAVE_MINIFIED = 1 << 0,       // no whitespace at all
+    CONFIG_SAVE_OMIT_ARRAY_SIZE = 1 << 1,// leave out "arraySize", the loader takes it from the array length
+    CONFIG_SAVE_ATOMIC = 1 << 2,         // temp file + fsync + rename, see save_config_to_file_atomic
+    CONFIG_SAVE_SHORTEST_FLOATS = 1 << 3,// FLOAT values in the fewest digits that read back to the same float (3.14, not 3.1400001049041748)
+    CONFIG_SAVE_COMPRESSED = 1 << 4,     // compress with the built-in LZ codec, the loaders recognize such files by their first bytes
+    CONFIG_SAVE_PARALLEL = 1 << 5,       // render the records on one worker thread per processor, same bytes; pays off from ~100k records
+    CONFIG_SAVE_COMPACT = CONFIG_SAVE_MINIFIED | CONFIG_SAVE_OMIT_ARRAY_SIZE | CONFIG_SAVE_SHORTEST_FLOATS
+} ConfigSaveFlags;
+
+// Receives the serialized bytes of a streaming save in order.
+// return 0 when all length bytes were written, -1 to abort the save.
+typedef int (*ConfigWriteCallback)(void* context, const char* data, size_t length);
+
+// One record of a baked table, see save_config_to_c_source
+typedef struct ConfigBakedRecord {
+    const char* key;
+    unsigned int keyHash;    // hash of key, compared before the key
+    ValueType type;
+    unsigned int bits;       // INT value, or the IEEE-754 bits of a FLOAT value
+    const void* data;        // STRING: const char*; INT_ARRAY, FLOAT_ARRAY: const unsigned int[] (bits as above);
+                             // STRING_ARRAY: const char* const[]; NULL otherwise and for an empty array
+    size_t arraySize;
+} ConfigBakedRecord;
+
+// A configuration compiled into the program, generated by save_config_to_c_source
+typedef struct ConfigBakedTable {
+    const ConfigBakedRecord* records;  // recordCount records in store order
+    size_t recordCount;
+    const unsigned int* seeds;         // perfect hash: one seed per bucket
+    size_t bucketCount;
+    const unsigned int* slots;         // record + 1 for each slot, 0 = empty
+    size_t slotCount;
+} ConfigBakedTable;
+
+// How sure a codec's probe is that a file is in its format
+typedef enum ConfigProbeResult {
+    CONFIG_PROBE_NO = 0,     // cannot be this format
+    CONFIG_PROBE_MAYBE = 1,  // plausible, the file extension decides
+    CONFIG_PROBE_YES = 2     // the format's magic bytes
+} ConfigProbeResult;
+
+// A file format for load_config_from_file, reload_config_from_file and save_config_to_file_with_flags
+typedef struct ConfigCodec {
+    const char* name;        // "json", "jsonl", "msgpack", "snapshot", "ini" for the built-in ones
+    const char* extensions;  // space-separated, with the dot: ".json .cfg" (may be NULL)
+    // look at the first bytes of a file (up to 64, fewer for a short file), return a ConfigProbeResult
+    int (*probe)(const unsigned char* head, size_t length);
+    // load filename into cm like load_config_from_file. return 0 on success, -1 on error
+    int (*load)(ConfigManager* cm, const char* filename);
+    // write cm to filename (may be NULL for a read-only format). return 0 on success, -1 on error
+    int (*save)(ConfigManager* cm, const char* filename, unsigned int flags);
+} ConfigCodec;
+
+// One field of a struct bound with bind_config_struct
+typedef struct ConfigBindingField {
+    const char* key;
+    ValueType type;   // INT, FLOAT, STRING (a char buffer), INT_ARRAY or FLOAT_ARRAY (an int or float array)
+    size_t offset;    // offsetof(struct, field)
+    size_t size;      // sizeof the field
+} ConfigBindingField;
+
+// Descriptor for field of structType bound to key: CONFIG_BIND(ServerSettings, port, "server.port", INT)
+#define CONFIG_BIND(structType, field, key, type) \
+    { (key), (type), offsetof(structType, field), sizeof(((structType*)0)->field) }
+
+// Function Prototypes
+
+
+// Initialize a new configuration manager
+// 
+// Create and populate the initial ConfigManager, set initial value of size to 0, initial capasity to 10, initialize records[]
+// memory allocation failed, return NULL;
+//
+ConfigManager* create_config_manager();
+
+// Free the memory used by a configuration manager
+
+void free_config_manager(ConfigManager* cm);
+
+// Store a value by key
+//
+// input existing configManage name, keyname, value, ValueType and unsigned arraySize, 
+// then store supported data to configmanager. 
+// supported ValueType:INT,FLOAT,STRING,INT_ARRAY,FLOAT_ARRAY, and STRING_ARRAY. standing int, float, string and their arrays.
+// return 0 stands for store successfully.
+// return -1 for unsupported ValueType or invalid input. 
+// with a journal open (open_config_journal), -1 also means the value is stored but could not be made durable.
+// *****Example*****
+//     int intValue = 42;
+//      store_value_by_key(cm, "key_int", &intValue, INT, 0);
+//     const char* stringArray[] = { "apple", "banana", "cherry" };
+//      store_value_by_key(cm, "key_string_array", stringArray, STRING_ARRAY, 3);
+//
+int store_value_by_key(ConfigManager* cm, const char* key, void* value, ValueType type, size_t arraySize);
+
+// Fetch a value by key
+// 
+// input existing configManage name, keyname,expectedType, and expected valueoutput variable name valueOut, then you can get value in ValueOut
+// return 0 for fetch successfully.
+// return -1 for invalid parameter, type mismatch, or key not found.
+// ****Example****
+//          int fetchedInt;
+//          if (fetch_value_by_key(cm, "key_int", &fetchedInt, INT) == 0) {
+//           printf("Fetched INT value: %d\n", fetchedInt);
+//          }
+//
+
+int fetch_value_by_key(ConfigManager* cm, const char* key, void* valueOut, ValueType expectedType);
+
+// Get the type and element count of a stored value
+//
+// tells whether key is stored and how to fetch it: fetch_value_by_key needs the type, and arraySize
+// elements of room for an array. typeOut or arraySizeOut may be NULL. nothing is printed for a missing key.
+// return 0 for key found, -1 for invalid parameters or key not found.
+// ****Example****
+//          ValueType type;
+//          size_t count;
+//          if (config_value_info(cm, "key_int_array", &type, &count) == 0 && type == INT_ARRAY) {
+//              int* values = (int*)malloc(count * sizeof(int) + 1);
+//              fetch_value_by_key(cm, "key_int_array", values, INT_ARRAY);
+//          }
+//
+int config_value_info(ConfigManager* cm, const char* key, ValueType* typeOut, size_t* arraySizeOut);
+
+// Start bulk-load mode
+//
+// while in bulk-load mode, store_value_by_key and the loaders append records without searching for an existing key.
+// duplicates are resolved once by end_config_bulk_load with the same result as storing one by one: the last value wins,
+// the key keeps its first position, and a value whose type differs from the first one is rejected.
+// fetch still works in bulk-load mode but scans the records added since the mode started.
+// change notifications for the appended records are sent when the mode ends.
+// return 0 for success, -1 for invalid parameters or if cm is already in bulk-load mode.
+// *****Example*****
+//      begin_config_bulk_load(cm);
+//      for (...) store_value_by_key(cm, key, &value, INT, 0);
+//      end_config_bulk_load(cm);
+//
+int begin_config_bulk_load(ConfigManager* cm);
+
+// Finish bulk-load mode
+//
+// resolve duplicate keys and build the lookup index in one pass over the records.
+// return 0 for success, -1 for invalid parameters, cm not in bulk-load mode or a failed index allocation.
+//
+int end_config_bulk_load(ConfigManager* cm);
+
+// Delete a value by key
+//
+// remove key and its value from cm, the order of the remaining records is kept.
+// return 0 for delete successfully.
+// return -1 for invalid parameters or key not found, or a journaled delete that could not be made durable.
+//
+int delete_value_by_key(ConfigManager* cm, const char* key);
+
+// Typed fetch
+//
+// one getter per ValueType, the same lookup as fetch_value_by_key without the runtime type switch and
+// without printing: a missing key or another stored type is only the -1 return. the _view getters and
+// config_get_string give pointers into the stored value, valid until the key is next stored, deleted or reloaded.
+// return 0 for fetch successfully.
+// return -1 for invalid parameters, type mismatch, or key not found.
+// ****Example****
+//          int port = 8080;                       // default when the key is missing
+//          config_get_int(cm, "port", &port);
+//          const float* weights;
+//          size_t count;
+//          if (config_get_float_view(cm, "weights", &weights, &count) == 0) {
+//              for (size_t i = 0; i < count; ++i) total += weights[i];
+//          }
+//
+int config_get_int(ConfigManager* cm, const char* key, int* valueOut);
+int config_get_float(ConfigManager* cm, const char* key, float* valueOut);
+int config_get_string(ConfigManager* cm, const char* key, const char** valueOut);
+int config_get_int_view(ConfigManager* cm, const char* key, const int** valuesOut, size_t* countOut);
+int config_get_float_view(ConfigManager* cm, const char* key, const float** valuesOut, size_t* countOut);
+int config_get_string_view(ConfigManager* cm, const char* key, const char* const** valuesOut, size_t* countOut);
+
+// Typed store
+//
+// same result as store_value_by_key with the matching ValueType: the value is copied, a new key is added,
+// an existing key of the same type is changed and notified. an INT or FLOAT is assigned in place.
+// return 0 for store successfully.
+// return -1 for invalid parameters, key stored with another type (nothing is printed), allocation failure,
+// or a journaled change that is stored but could not be made durable.
+// *****Example*****
+//      config_set_int(cm, "port", 8080);
+//      const char* hosts[] = { "a.example", "b.example" };
+//      config_set_strings(cm, "hosts", hosts, 2);
+//
+int config_set_int(ConfigManager* cm, const char* key, int value);
+int config_set_float(ConfigManager* cm, const char* key, float value);
+int config_set_string(ConfigManager* cm, const char* key, const char* value);
+int config_set_ints(ConfigManager* cm, const char* key, const int* values, size_t count);
+int config_set_floats(ConfigManager* cm, const char* key, const float* values, size_t count);
+int config_set_strings(ConfigManager* cm, const char* key, const char* const* values, size_t count);
+
+// Typed fetch and store picked by the argument type (C11 _Generic)
+//
+// config_get(cm, key, &out)              out is int, float or const char*
+// config_get_view(cm, key, &values, &n)  values is const int*, const float* or const char* const*
+// config_set(cm, key, value)             value is int, float, double (stored as FLOAT) or a string
+// config_set_array(cm, key, values, n)   values points to int, float or strings
+// the call resolves to the typed function at compile time; a type with no accessor does not compile.
+// *****Example*****
+//      int port = 8080;
+//      config_get(cm, "port", &port);
+//      config_set(cm, "ratio", 0.75);
+//
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define config_get(cm, key, out) _Generic((out), \
+    int*: config_get_int, \
+    float*: config_get_float, \
+    const char**: config_get_string)(cm, key, out)
+
+#define config_get_view(cm, key, values, count) _Generic((values), \
+    const int**: config_get_int_view, \
+    const float**: config_get_float_view, \
+    const char* const**: config_get_string_view)(cm, key, values, count)
+
+#define config_set(cm, key, value) _Generic((value), \
+    int: config_set_int, \
+    float: config_set_float, \
+    double: config_set_float, \
+    char*: config_set_string, \
+    const char*: config_set_string)(cm, key, value)
+
+#define config_set_array(cm, key, values, count) _Generic((values), \
+    int*: config_set_ints(cm, key, (const int*)(values), count), \
+    const int*: config_set_ints(cm, key, (const int*)(values), count), \
+    float*: config_set_floats(cm, key, (const float*)(values), count), \
+    const float*: config_set_floats(cm, key, (const float*)(values), count), \
+    char**: config_set_strings(cm, key, (const char* const*)(values), count), \
+    const char**: config_set_strings(cm, key, (const char* const*)(values), count), \
+    const char* const*: config_set_strings(cm, key, (const char* const*)(values), count))
+#endif
+
+// Register a change callback
+//
+// callback is called with userData after every store, load, reload or delete that adds, changes or removes a key.
+// pass NULL to stop notifications. only one callback is kept per config manager.
+//
+void set_config_change_callback(ConfigManager* cm, ConfigChangeCallback callback, void* userData);
+
+// Load configuration data from a file
+//
+// load filename to an existing config manager cm, in the format picked by detect_config_codec: JSON,
+// JSON Lines, MessagePack, a binary snapshot, INI, or a registered codec.
+// a JSON file is parsed with the third party library cJSON.h, on several threads when it is large and there
+// are several processors. a file saved with CONFIG_SAVE_COMPRESSED is recognized by its first bytes and
+// decompressed block by block while it is parsed, without holding the whole decompressed text;
+// every other loader accepts it as well.
+// return 0 for load successfully
+// return -1 for invalid parameters, error opening file, no codec for the file, error parsing the file
+//
+int load_config_from_file(ConfigManager* cm, const char* filename);
+
+// Load configuration data from a file using several worker threads
+//
+// same file format and result as load_config_from_file. the top-level array is split at record boundaries,
+// the chunks are parsed on a pool of threadCount workers and the records are merged into cm in file order,
+// so a key repeated in the file keeps its last value. threadCount 0 uses one worker per processor;
+// files under about 1MB per worker use fewer workers, down to parsing on the calling thread.
+// return 0 for load successfully
+// return -1 for invalid parameters, error opening file, error parsing JSON file (cm is left unchanged)
+// *****Example*****
+//      load_config_from_file_parallel(cm, "config.json", 0);
+//
+int load_config_from_file_parallel(ConfigManager* cm, const char* filename, unsigned int threadCount);
+
+// Load every *.json fragment of a directory
+//
+// all regular files ending in .json directly inside dirname (a conf.d style directory) are read and parsed
+// concurrently on threadCount workers (0 means one per processor), then merged into cm in lexical order of
+// their file names. a key set by several fragments keeps the value of the last one, even if its type differs.
+// an empty directory loads nothing and succeeds.
+// return 0 for load successfully
+// return -1 for invalid parameters, error opening the directory, error reading or parsing any fragment (cm is left unchanged)
+// *****Example*****
+//      load_config_from_directory(cm, "conf.d", 0);
+//
+int load_config_from_directory(ConfigManager* cm, const char* dirname, unsigned int threadCount);
+
+// Reload configuration data from a file, applying only the differences
+//
+// the file becomes the new content of cm: records whose content hash and value match the stored record are skipped,
+// changed and new records are stored (a changed type replaces the old value), and keys missing from the file are deleted.
+// change notifications are sent only for keys that were actually added, changed or removed.
+// the file can be in any format load_config_from_file reads.
+// return 0 for reload successfully
+// return -1 for invalid parameters, error opening file, error parsing the file (cm is left unchanged)
+//
+int reload_config_from_file(ConfigManager* cm, const char* filename);
+
+// Save configuration data to a file
+//
+// save a config manager cm to a JSON file filename, in the format read by load_config_from_file.
+// the records are streamed to the file through a fixed-size buffer, without building a cJSON tree;
+// the output is byte for byte what cJSON_Print produces for the same records.
+// each record keeps its serialized bytes, so a save re-renders only the records changed since the last
+// one, and a save to the same file with the same flags is skipped without writing when nothing changed,
+// neither in cm nor in the file (same size, modification time and file id as the last save left).
+// return 0 for save successfully (or skipped)
+// return -1 for invalid parameters, error writting file
+//
+int save_config_to_file(ConfigManager* cm, const char* filename);
+
+// Save configuration data to a file with selected formatting
+//
+// same as save_config_to_file, with flags made of ConfigSaveFlags. CONFIG_SAVE_COMPACT writes one line with
+// no whitespace, no "arraySize" members and shortest floats, roughly half the size of the default layout, for
+// files that are only read by programs. load_config_from_file and the other loaders accept every layout.
+// CONFIG_SAVE_SHORTEST_FLOATS alone keeps the default layout but prints FLOAT values as written (3.14).
+// a filename with the extension of another codec (config.msgpack, app.ini, ...) is written by that codec,
+// which takes the flags it understands; CONFIG_SAVE_ATOMIC works with every codec. other names get JSON.
+// return 0 for save successfully
+// return -1 for invalid parameters, error writting file
+// *****Example*****
+//      save_config_to_file_with_flags(cm, "config.json", CONFIG_SAVE_COMPACT);
+//
+int save_config_to_file_with_flags(ConfigManager* cm, const char* filename, unsigned int flags);
+
+// Save configuration data to a file atomically and durably
+//
+// same output as save_config_to_file, but written to a temporary file next to filename, flushed to disk,
+// renamed over filename and followed by a flush of the directory. a crash leaves either the old or the new
+// file, never a truncated one. saves are committed in groups: saves queued while a flush is in progress, or
+// still being written when one is about to start (the committer waits up to 10ms for them), are flushed
+// together by one thread, and for each file only the newest content is flushed and renamed. a call returns
+// once its own content is durable; a thread that saves repeatedly without waiting for each one uses
+// save_config_to_file_async with CONFIG_SAVE_ATOMIC, whose queued saves of a file share one commit.
+// return 0 for save successfully
+// return -1 for invalid parameters, error writting, flushing or renaming the file (filename is left untouched)
+//
+int save_config_to_file_atomic(ConfigManager* cm, const char* filename);
+
+// Save configuration data to a file in the background
+//
+// take a snapshot of cm and return at once; the snapshot is written by a background thread exactly like
+// save_config_to_file_with_flags(snapshot, filename, flags). cm can be changed or freed as soon as the call returns.
+// if a save of the same filename is still waiting for its turn, it takes this newer snapshot and flags instead
+// of a second write being queued, and the same handle is returned to both callers.
+// every returned handle must be passed to config_save_wait once.
+// return a handle, or NULL for invalid parameters or when the snapshot cannot be allocated
+// *****Example*****
+//      ConfigSaveHandle* save = save_config_to_file_async(cm, "config.json", CONFIG_SAVE_ATOMIC);
+//      ...
+//      if (config_save_wait(save) != 0) printf("save failed\n");
+//
+ConfigSaveHandle* save_config_to_file_async(ConfigManager* cm, const char* filename, unsigned int flags);
+
+// Check whether a background save has finished, without waiting
+//
+// return 1 for finished (or a NULL handle), 0 for still queued or running
+//
+int config_save_done(ConfigSaveHandle* handle);
+
+// Wait for a background save to finish and release the handle
+//
+// return 0 for save successfully
+// return -1 for a NULL handle or the save failed
+//
+int config_save_wait(ConfigSaveHandle* handle);
+
+// Save configuration data through a write callback
+//
+// same output as save_config_to_file_with_flags, delivered to write(context, data, length) in chunks of at most 64KB,
+// so it can target a file descriptor, a socket or memory. CONFIG_SAVE_ATOMIC is ignored. never skipped, but
+// it reuses the cached bytes of unchanged records the same way.
+// return 0 for save successfully
+// return -1 for invalid parameters, or when write returned an error
+// *****Example*****
+//      static int write_fd(void* context, const char* data, size_t length) {
+//          return write(*(int*)context, data, length) == (ssize_t)length ? 0 : -1;
+//      }
+//      save_config_to_stream(cm, write_fd, &fd, CONFIG_SAVE_DEFAULT);
+//
+int save_config_to_stream(ConfigManager* cm, ConfigWriteCallback write, void* context, unsigned int flags);
+
+// Keep a configuration durable through a write-ahead journal
+//
+// recover cm from checkpointFile (if it exists) and the changes recorded in journalFile, then append every later
+// change of cm (store, delete, reload, resolved bulk loads) to journalFile as a small binary entry that is flushed
+// to disk before the call making the change returns, so a durable write costs the size of the change, not of the
+// whole store. once the journal grows past checkpointBytes (0 means 4MB) cm is saved atomically to checkpointFile
+// and the journal is emptied. an entry torn by a crash at the end of the journal is discarded during recovery.
+// return 0 for recovered and journaling
+// return -1 for invalid parameters, cm already journaled, unreadable checkpoint, journalFile not a journal, error opening it
+// *****Example*****
+//      open_config_journal(cm, "config.json", "config.journal", 0);
+//      store_value_by_key(cm, "key_int", &intValue, INT, 0);   // on disk when this returns
+//      close_config_journal(cm);
+//
+int open_config_journal(ConfigManager* cm, const char* checkpointFile, const char* journalFile, size_t checkpointBytes);
+
+// Whether a journaled change is only in memory
+//
+// a change the journal could not write or sync is recovered by an immediate checkpoint; when that fails too,
+// store and delete return -1 and this reports 1 until a later change or config_journal_checkpoint succeeds.
+// loads, reloads and bulk loads journal many keys at once, check this after them.
+// return 1 for changes not on disk, 0 for everything durable or no journal open
+//
+int config_journal_failed(ConfigManager* cm);
+
+// Write a checkpoint now
+//
+// save cm atomically to its checkpoint file and empty the journal.
+// return 0 for checkpoint written
+// return -1 for no journal open, error writing the checkpoint or truncating the journal
+//
+int config_journal_checkpoint(ConfigManager* cm);
+
+// Write a final checkpoint and stop journaling
+//
+// free_config_manager also stops journaling, without the checkpoint; the journal already holds every change.
+// return 0 for checkpoint written, -1 for no journal open or checkpoint error (journaling stops either way)
+//
+int close_config_journal(ConfigManager* cm);
+
+// Watch a configuration file and hot-reload it
+//
+// load filename into a new ConfigManager, then keep watching it on a background thread (inotify on Linux,
+// modification-time polling elsewhere). once the file has been quiet for debounceMs (0 means 100ms),
+// so that an editor's rename-and-write sequence counts as a single change, it is loaded into a fresh
+// ConfigManager and published atomically. a file that fails to load keeps the previous version.
+// return NULL for invalid parameters, error loading the file or starting the watcher.
+// *****Example*****
+//      ConfigWatcher* w = create_config_watcher("config.json", 0);
+//      ConfigManager* cm = config_watcher_acquire(w);   // on a serving thread
+//      fetch_value_by_key(cm, "key_int", &fetchedInt, INT);
+//      config_watcher_release(w, cm);
+//
+ConfigWatcher* create_config_watcher(const char* filename, unsigned int debounceMs);
+
+// Get the current configuration of a watcher
+//
+// the returned manager is complete and never changes while it is held; treat it as read-only.
+// it stays valid until config_watcher_release, even if a newer version is published in between.
+// never waits on a reload in progress.
+//
+ConfigManager* config_watcher_acquire(ConfigWatcher* w);
+
+// Release a configuration returned by config_watcher_acquire
+void config_watcher_release(ConfigWatcher* w, ConfigManager* cm);
+
+// Version number of the current configuration, 1 after creation and +1 for every published reload
+unsigned long config_watcher_version(ConfigWatcher* w);
+
+// Stop the watcher thread and free every version. no configuration from this watcher may still be held.
+void free_config_watcher(ConfigWatcher* w);
+
+// Save configuration data as MessagePack
+//
+// the store is written as one MessagePack map from key to value, in store order, without going through cJSON:
+// INT as the smallest int encoding, FLOAT as float32, STRING as str, STRING_ARRAY as an array of str,
+// INT_ARRAY and FLOAT_ARRAY as packed ext values (type 1 and 2) of big-endian 32-bit elements.
+// return 0 for save successfully
+// return -1 for invalid parameters, error opening or writing the file
+// *****Example*****
+//      save_config_to_msgpack(cm, "config.msgpack");
+//
+int save_config_to_msgpack(ConfigManager* cm, const char* filename);
+
+// Load configuration data from a MessagePack file
+//
+// reads files written by save_config_to_msgpack (compressed ones too) and, from other writers, a top-level map
+// whose values are ints, floats, strings or arrays of them. float64 becomes FLOAT, an array of ints INT_ARRAY,
+// of numbers FLOAT_ARRAY, of strings STRING_ARRAY. a key with any other value is skipped.
+// keys are merged like load_config_from_file, a repeated key keeps its last value.
+// return 0 for load successfully
+// return -1 for invalid parameters, error opening the file, a malformed file (cm is left unchanged)
+//
+int load_config_from_msgpack(ConfigManager* cm, const char* filename);
+
+// Save configuration data as JSON Lines
+//
+// one minified {"key", "type", "value"} object per line instead of one top-level array, so records can be
+// appended and a loader can split the file at any newline. CONFIG_SAVE_OMIT_ARRAY_SIZE and
+// CONFIG_SAVE_SHORTEST_FLOATS apply, the other flags are ignored. skipped when nothing changed since the last save.
+// return 0 for save successfully
+// return -1 for invalid parameters, error opening or writing the file
+//
+int save_config_to_jsonl(ConfigManager* cm, const char* filename, unsigned int flags);
+
+// Append changed records to a JSON Lines file
+//
+// when filename is still what the last save_config_to_jsonl or append_config_to_jsonl of cm with the same flags
+// wrote, only the keys added or changed since are appended, each as a new line that overrides earlier ones on load.
+// otherwise, or when a key was deleted or changed type in between, the whole file is rewritten.
+// return 0 for save successfully
+// return -1 for invalid parameters, error opening or writing the file
+// *****Example*****
+//      save_config_to_jsonl(cm, "config.jsonl", CONFIG_SAVE_DEFAULT);
+//      store_value_by_key(cm, "key_int", &intValue, INT, 0);
+//      append_config_to_jsonl(cm, "config.jsonl", CONFIG_SAVE_DEFAULT);   // writes one line
+//
+int append_config_to_jsonl(ConfigManager* cm, const char* filename, unsigned int flags);
+
+// Load configuration data from a JSON Lines file using several worker threads
+//
+// the file is cut at newlines into one piece per worker (threadCount 0 uses one per processor, files under
+// about 1MB per worker use fewer), the pieces are parsed in parallel and merged in file order, so a key on
+// several lines keeps its last value. blank lines are ignored, and so is an incomplete last line left by an
+// interrupted append.
+// return 0 for load successfully
+// return -1 for invalid parameters, error opening the file, error parsing a line (cm is left unchanged)
+//
+int load_config_from_jsonl(ConfigManager* cm, const char* filename, unsigned int threadCount);
+
+// Load configuration data from an INI or properties file
+//
+// reads key = value (or key: value) lines straight into cm, without converting to JSON first. lines starting
+// with #, ; or ! are comments, a [section] line prefixes the keys after it as "section.key".
+// types are inferred from the text: 42 is an INT, 4.2 or 1e3 a FLOAT, "quoted" or anything else a STRING,
+// and a value with commas a list (1, 2, 3 an INT_ARRAY, 1, 2.5 a FLOAT_ARRAY, a, b a STRING_ARRAY; "5," a list of one).
+// keys are merged like load_config_from_file, a repeated key keeps its last value.
+// return 0 for load successfully
+// return -1 for invalid parameters, error opening the file or allocating memory (cm is left unchanged)
+// *****Example*****
+//      // port = 8080
+//      // hosts = alpha, beta
+//      load_config_from_ini(cm, "service.properties");
+//
+int load_config_from_ini(ConfigManager* cm, const char* filename);
+
+// Save configuration data as an INI or properties file
+//
+// one key = value line per key, no sections. strings that would read back as another type are quoted,
+// so load_config_from_ini returns every value with its type, with one exception: an empty array is written
+// as a lone "," without an element type, so an empty INT_ARRAY or FLOAT_ARRAY comes back as an empty STRING_ARRAY.
+// return 0 for save successfully
+// return -1 for invalid parameters, a key that cannot be written (empty, with =, : or a line break, or
+// starting with #, ;, ! or [), error opening or writing the file
+//
+int save_config_to_ini(ConfigManager* cm, const char* filename);
+
+// Apply overrides from the environment and the command line
+//
+// call after loading the configuration files. every environment variable whose name starts with envPrefix
+// sets the key made of the rest of its name, lowercased, with "__" turned into "." (APP_DB__POOL_SIZE is
+// "db.pool_size"). every argument argv[1..argc-1] starting with argPrefix sets the key written after it,
+// taking the value after '=' or else the next argument. the command line wins over the environment.
+// values are written as in an INI file: 16, 0.5, "quoted text", lists with commas (8080, 8081).
+// a key that exists keeps its type: a STRING takes the value as written, an INT is widened for a FLOAT,
+// a single value fills a one-element array. when cm is a layer, the type is the key's type in the manager
+// the layer belongs to. pass NULL for envPrefix or argPrefix to skip that source.
+// all overrides are stored in one batch (see begin_config_bulk_load), notifications included.
+// return 0 for overrides applied successfully
+// return -1 for invalid parameters, allocation failure, or an override that does not fit the type of its key
+//      (the other overrides are still applied)
+// *****Example*****
+//      // APP_LOG__LEVEL=debug ./service --config.pool_size=16
+//      load_config_from_file(cm, "service.json");
+//      apply_config_overrides(cm, "APP_", argc, argv, "--config.");
+//
+int apply_config_overrides(ConfigManager* cm, const char* envPrefix, int argc, char* argv[], const char* argPrefix);
+
+// Save configuration data as C source
+//
+// write filename as a C file defining "const ConfigBakedTable symbol": every record of cm in static const
+// arrays plus a perfect hash over the keys. compile it into a program and read it with fetch_baked_value,
+// there is nothing to parse or allocate at startup. any file the loaders read can be baked this way.
+// return 0 for save successfully
+// return -1 for invalid parameters, symbol not a C identifier, error writting file
+// *****Example*****
+//      // build step
+//      load_config_from_file(cm, "service.json");
+//      save_config_to_c_source(cm, "service_config.c", "service_config");
+//      // program, linked with service_config.c
+//      extern const ConfigBakedTable service_config;
+//      fetch_baked_value(&service_config, "pool_size", &poolSize, INT);
+//
+int save_config_to_c_source(ConfigManager* cm, const char* filename, const char* symbol);
+
+// Fetch a value from a baked table
+//
+// same as fetch_value_by_key, reading the static table: one hash, one slot, one key compare.
+// STRING gives a const char* into the table. INT_ARRAY and FLOAT_ARRAY are copied into valueOut,
+// STRING_ARRAY fills valueOut with const char* into the table; size it with config_baked_array_size.
+// return 0 for fetch successfully
+// return -1 for invalid parameters, key not found, type mismatch
+//
+int fetch_baked_value(const ConfigBakedTable* table, const char* key, void* valueOut, ValueType expectedType);
+
+// Get the element count of a baked value (0 for INT, FLOAT and STRING)
+//
+// return 0 for size found, -1 for key not found
+//
+int config_baked_array_size(const ConfigBakedTable* table, const char* key, size_t* sizeOut);
+
+// Load configuration data from a baked table
+//
+// copy every record of table into cm like a file load, for a manager that starts from the baked values and
+// changes afterwards, e.g. the defaults layer: load_config_from_baked(add_config_layer(cm, "defaults"), &table).
+// return 0 for load successfully
+// return -1 for invalid parameters, allocation failure (cm keeps none of the table's records)
+//
+int load_config_from_baked(ConfigManager* cm, const ConfigBakedTable* table);
+
+// Generate a typed settings struct from a schema
+//
+// schema holds one record per setting: its key, type and value are the key, field type and default.
+// headerFile gets "typedef struct structName {...} structName;" with one field per record in store order,
+// named after the key (characters other than letters, digits and '_' become '_'), an array field followed
+// by a size_t <field>_count. sourceFile gets the functions, all named with prefix:
+//      int  prefix_init(structName* cfg)                          every field set to its default
+//      int  prefix_refresh(structName* cfg, ConfigManager* cm)    fields whose key cm stores with the schema type
+//      int  prefix_load(structName* cfg, ConfigManager* cm)       init, then refresh
+//      int  prefix_load_file(structName* cfg, const char* file)   init, then refresh from a file of any format
+//      void prefix_free(structName* cfg)
+// the struct owns copies of its strings and arrays, so it stays valid while cm changes or is freed,
+// and hot code reads cfg->pool_size as a plain field. the files need only this header to compile.
+// return 0 for files written successfully
+// return -1 for invalid parameters, structName or prefix not a C identifier, error writting a file
+// *****Example*****
+//      // build step, defaults.json is the schema
+//      load_config_from_file(schema, "defaults.json");
+//      generate_config_struct(schema, "ServiceConfig", "service_config", "service_config.h", "service_config.c");
+//      // program
+//      ServiceConfig cfg;
+//      service_config_load_file(&cfg, "service.json");
+//      for (int i = 0; i < cfg.pool_size; ++i) ...
+//      service_config_free(&cfg);
+//
+int generate_config_struct(ConfigManager* schema, const char* structName, const char* prefix,
+    const char* headerFile, const char* sourceFile);
+
+// Bind a struct to the keys of a manager
+//
+// fields describes the struct once, typically a static const table built with CONFIG_BIND; it and target
+// must stay valid while bound. each field gets the value of its key when the key is stored with the field's
+// type, and is left as it is otherwise, so set the defaults in target first:
+//      INT, FLOAT      an int or float field
+//      STRING          a char buffer of size bytes, truncated and always terminated
+//      INT_ARRAY, FLOAT_ARRAY  an int or float array, the elements that fit and the rest zeroed
+// target is filled at once and again at the end of every load_config_from_file and reload_config_from_file
+// on cm. after other changes (store, delete, overrides) call refresh_config_binding.
+// a refresh is one pass over the table with each key's record position remembered, and copies only
+// the values that changed since the last one; it does nothing at all when cm has not changed.
+// the binding lives until unbind_config_struct or free_config_manager(cm).
+// return the binding, NULL for invalid parameters, a field with an unsupported type or size, allocation failure
+// *****Example*****
+//      typedef struct ServerSettings { int port; float timeout; char host[64]; int ports[4]; } ServerSettings;
+//      static const ConfigBindingField serverFields[] = {
+//          CONFIG_BIND(ServerSettings, port, "server.port", INT),
+//          CONFIG_BIND(ServerSettings, timeout, "server.timeout", FLOAT),
+//          CONFIG_BIND(ServerSettings, host, "server.host", STRING),
+//          CONFIG_BIND(ServerSettings, ports, "server.ports", INT_ARRAY),
+//      };
+//      static ServerSettings settings = { 8080, 1.5f, "localhost", { 0 } };
+//      bind_config_struct(cm, serverFields, 4, &settings);
+//      reload_config_from_file(cm, "server.json");   // settings is current again
+//
+ConfigBinding* bind_config_struct(ConfigManager* cm, const ConfigBindingField* fields, size_t fieldCount, void* target);
+
+// Fill a bound struct from the current values of its manager
+// return 0 for success, -1 for invalid parameters or allocation failure.
+int refresh_config_binding(ConfigBinding* binding);
+
+// Detach a struct from its manager and free the binding, the struct keeps its values
+void unbind_config_struct(ConfigBinding* binding);
+
+// Add a configuration layer
+//
+// create an empty layer called name on top of the existing layers of cm and return it. a layer is an
+// ordinary config manager: load files into it, store, delete or reload its values. cm then holds the
+// flattened view of its layers: each key has the value of the last added layer that has it, so a fetch
+// from cm is one lookup however many layers there are. every change to a layer updates just that key
+// of the view, and cm's change callback hears only about keys whose effective value changed.
+// keys stored in cm directly are overwritten or removed when a layer next changes them; keep runtime
+// overrides in a top layer instead. the layer belongs to cm: it is freed by free_config_manager(cm)
+// or remove_config_layer, never by the caller.
+// return the layer, NULL for invalid parameters, a layer with that name already exists, allocation failure
+// *****Example*****
+//      load_config_from_file(add_config_layer(cm, "defaults"), "defaults.json");
+//      load_config_from_file(add_config_layer(cm, "site"), "site.json");
+//      ConfigManager* runtime = add_config_layer(cm, "runtime");
+//      store_value_by_key(runtime, "pool_size", &poolSize, INT, 0);   // cm now sees this pool_size
+//      fetch_value_by_key(cm, "pool_size", &poolSize, INT);
+//
+ConfigManager* add_config_layer(ConfigManager* cm, const char* name);
+
+// Find a configuration layer by name
+//
+// return the layer added to cm under name, NULL if there is none
+//
+ConfigManager* get_config_layer(ConfigManager* cm, const char* name);
+
+// Remove a configuration layer
+//
+// the keys of the layer fall back to the layers below it, or leave the view of cm. the layer is freed.
+// return 0 for layer removed successfully, -1 for invalid parameters or layer not found
+//
+int remove_config_layer(ConfigManager* cm, const char* name);
+
+// Save configuration data as a binary snapshot
+//
+// a snapshot is a read-only image of cm that open_config_snapshot maps into memory instead of parsing:
+// a hash index, fixed-width records and the key and value bytes, in the byte order of this machine.
+// written to a temp file and renamed over filename, so a snapshot that is open elsewhere stays intact.
+// return 0 for save successfully
+// return -1 for invalid parameters, allocation or write errors
+// *****Example*****
+//      save_config_snapshot(cm, "config.snap");
+//
+int save_config_snapshot(ConfigManager* cm, const char* filename);
+
+// Open a binary snapshot written by save_config_snapshot
+//
+// the file is mapped, not read: opening costs the same for any number of keys and pages load on first use.
+// only the header is checked here, every fetch checks the offsets it follows.
+// return NULL for error opening or mapping the file, or a file that is not a snapshot of this byte order.
+// *****Example*****
+//      ConfigSnapshot* snap = open_config_snapshot("config.snap");
+//      const char* name;
+//      fetch_snapshot_value(snap, "key_string", &name, STRING);
+//      close_config_snapshot(snap);   // name is invalid from here
+//
+ConfigSnapshot* open_config_snapshot(const char* filename);
+
+// Fetch a value from a snapshot
+//
+// same as fetch_value_by_key, except that nothing is allocated: a STRING is returned as a const char*
+// pointing into the mapping, a STRING_ARRAY fills valueOut as an array of arraySize const char* into it.
+// INT_ARRAY and FLOAT_ARRAY are copied into valueOut, size it with config_snapshot_array_size.
+// return 0 for fetch successfully
+// return -1 for key not found, type mismatch or a damaged record
+//
+int fetch_snapshot_value(const ConfigSnapshot* snapshot, const char* key, void* valueOut, ValueType expectedType);
+
+// Get the element count of a snapshot value (0 for INT, FLOAT and STRING)
+//
+// return 0 for size found, -1 for key not found
+//
+int config_snapshot_array_size(const ConfigSnapshot* snapshot, const char* key, size_t* sizeOut);
+
+// Unmap a snapshot, every pointer fetched from it becomes invalid
+void close_config_snapshot(ConfigSnapshot* snapshot);
+
+// Register a file format
+//
+// codec is consulted before the built-in codecs and every codec registered before it, and replaces a codec
+// registered earlier under the same name; registering "json" or "msgpack" swaps in another implementation
+// of that format without changing any call site. codec must stay valid for the rest of the program.
+// up to 32 codecs can be registered, from any thread.
+// return 0 for codec registered successfully
+// return -1 for invalid parameters (name, probe and load are required), too many codecs
+// *****Example*****
+//      static const ConfigCodec yamlCodec = { "yaml", ".yaml .yml", probe_yaml, load_yaml, save_yaml };
+//      register_config_codec(&yamlCodec);
+//      load_config_from_file(cm, "service.yml");
+//
+int register_config_codec(const ConfigCodec* codec);
+
+// Find a codec by name
+//
+// return the registered or built-in codec called name, NULL if there is none
+//
+const ConfigCodec* find_config_codec(const char* name);
+
+// Pick the codec that load_config_from_file uses for a file
+//
+// every codec probes the first bytes of filename. a codec recognizing its magic bytes wins; otherwise a
+// codec that finds the bytes plausible and owns the file extension, then any codec owning the extension,
+// then the first codec that finds the bytes plausible.
+// return the codec, NULL for invalid parameters, error opening file, no codec for the file
+//
+const ConfigCodec* detect_config_codec(const char* filename);
+
+//helper function for test, fetch and print all values from the configuration
+// 
+// input exist config manager cm, print all items.
+// if cm is null, exit the function.
+//
+void print_config_values(ConfigManager* cm);
+
+#endif // zhaoba_CONFIG_MANAGER_H
@@ -0,0 +1,545 @@
+#include "zhaoba_config_internal.h"
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// MessagePack codec for ConfigManager, no cJSON in between.
+//
+// The store is one map from key to value, in store order. Each ValueType has a native encoding:
+//      INT          smallest int family that holds the value (fixint, int8 ... int32, uint8 ... uint32)
+//      FLOAT        float32
+//      STRING       str
+//      STRING_ARRAY array of str
+//      INT_ARRAY    ext type 1, arraySize big-endian int32 back to back
+//      FLOAT_ARRAY  ext type 2, arraySize big-endian IEEE float32 back to back
+// The loader also takes what other MessagePack writers produce for the same data: float64 for FLOAT,
+// 64-bit ints within int range, and plain arrays of ints (INT_ARRAY) or numbers (FLOAT_ARRAY).
+// A value of any other kind (nil, bool, bin, map, other ext types) is skipped with its key, like a
+// malformed record in a JSON file.
+
+#define MSGPACK_EXT_INT_ARRAY 1
+#define MSGPACK_EXT_FLOAT_ARRAY 2
+// nesting accepted while skipping unsupported values
+#define MSGPACK_MAX_DEPTH 64
+
+
+// ---- encoding ----
+
+static void put_byte(ConfigWriter* w, unsigned char c) {
+    config_writer_put(w, (const char*)&c, 1);
+}
+
+// marker byte followed by a big-endian integer of size bytes
+static void put_marked(ConfigWriter* w, unsigned char marker, uint32_t value, int size) {
+    unsigned char bytes[5];
+    bytes[0] = marker;
+    for (int i = 0; i < size; ++i) {
+        bytes[1 + i] = (unsigned char)(value >> (8 * (size - 1 - i)));
+    }
+    config_writer_put(w, (const char*)bytes, (size_t)size + 1);
+}
+
+static void write_int(ConfigWriter* w, int value) {
+    if (value >= 0) {
+        if (value < 128) put_byte(w, (unsigned char)value);
+        else if (value < 256) put_marked(w, 0xcc, (uint32_t)value, 1);
+        else if (value < 65536) put_marked(w, 0xcd, (uint32_t)value, 2);
+        else put_marked(w, 0xce, (uint32_t)value, 4);
+    }
+    else {
+        if (value >= -32) put_byte(w, (unsigned char)(int8_t)value);
+        else if (value >= -128) put_marked(w, 0xd0, (uint8_t)(int8_t)value, 1);
+        else if (value >= -32768) put_marked(w, 0xd1, (uint16_t)(int16_t)value, 2);
+        else put_marked(w, 0xd2, (uint32_t)value, 4);
+    }
+}
+
+static uint32_t float_bits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static void write_str(ConfigWriter* w, const char* str) {
+    size_t length = str ? strlen(str) : 0;
+    if (length < 32) put_byte(w, (unsigned char)(0xa0 | length));
+    else if (length < 256) put_marked(w, 0xd9, (uint32_t)length, 1);
+    else if (length < 65536) put_marked(w, 0xda, (uint32_t)length, 2);
+    else put_marked(w, 0xdb, (uint32_t)length, 4);
+    config_writer_put(w, str ? str : "", length);
+}
+
+// fix, 16 and 32 bit forms of an array (fixBase 0x90) or map (fixBase 0x80) header
+static void write_container(ConfigWriter* w, unsigned char fixBase, unsigned char marker16, size_t count) {
+    if (count < 16) put_byte(w, (unsigned char)(fixBase | count));
+    else if (count < 65536) put_marked(w, marker16, (uint32_t)count, 2);
+    else put_marked(w, (unsigned char)(marker16 + 1), (uint32_t)count, 4);
+}
+
+static void write_ext_header(ConfigWriter* w, unsigned char extType, size_t length) {
+    switch (length) {
+    case 1: put_byte(w, 0xd4); break;
+    case 2: put_byte(w, 0xd5); break;
+    case 4: put_byte(w, 0xd6); break;
+    case 8: put_byte(w, 0xd7); break;
+    case 16: put_byte(w, 0xd8); break;
+    default:
+        if (length < 256) put_marked(w, 0xc7, (uint32_t)length, 1);
+        else if (length < 65536) put_marked(w, 0xc8, (uint32_t)length, 2);
+        else put_marked(w, 0xc9, (uint32_t)length, 4);
+        break;
+    }
+    put_byte(w, extType);
+}
+
+// INT_ARRAY and FLOAT_ARRAY payloads, converted to big-endian a stack chunk at a time
+static void write_packed(ConfigWriter* w, unsigned char extType, const uint32_t* values, size_t count) {
+    unsigned char chunk[1024];
+    write_ext_header(w, extType, count * 4);
+    for (size_t i = 0; i < count; ) {
+        size_t used = 0;
+        for (; i < count && used < sizeof(chunk); ++i, used += 4) {
+            chunk[used] = (unsigned char)(values[i] >> 24);
+            chunk[used + 1] = (unsigned char)(values[i] >> 16);
+            chunk[used + 2] = (unsigned char)(values[i] >> 8);
+            chunk[used + 3] = (unsigned char)values[i];
+        }
+        config_writer_put(w, (const char*)chunk, used);
+    }
+}
+
+static void write_value(ConfigWriter* w, const KeyValuePair* kv) {
+    switch (kv->type) {
+    case INT:
+        write_int(w, kv->value.intValue);
+        break;
+    case FLOAT:
+        put_marked(w, 0xca, float_bits(kv->value.floatValue), 4);
+        break;
+    case STRING:
+        write_str(w, kv->value.stringValue);
+        break;
+    case INT_ARRAY:
+        // int and float are both 32 bits wide here, see the ext layout above
+        write_packed(w, MSGPACK_EXT_INT_ARRAY, (const uint32_t*)kv->value.intArrayValue, kv->arraySize);
+        break;
+    case FLOAT_ARRAY:
+        write_packed(w, MSGPACK_EXT_FLOAT_ARRAY, (const uint32_t*)kv->value.floatArrayValue, kv->arraySize);
+        break;
+    case STRING_ARRAY:
+        write_container(w, 0x90, 0xdc, kv->arraySize);
+        for (size_t j = 0; j < kv->arraySize; ++j) {
+            write_str(w, kv->value.stringArrayValue[j]);
+        }
+        break;
+    default:
+        put_byte(w, 0xc0);  // nil, skipped by the loader
+        break;
+    }
+}
+
+
+// Save configuration data as MessagePack
+int save_config_to_msgpack(ConfigManager* cm, const char* filename) {
+    if (!cm || !filename || config_bulk_resolve(cm) != 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < cm->size; ++i) {
+        if (cm->records[i].arraySize > UINT32_MAX / 4) {
+            printf("Error: value of key '%s' is too large for MessagePack.\n", cm->records[i].key);
+            return -1;
+        }
+    }
+
+    int fd = config_file_open_write(filename, 1);
+    if (fd < 0) {
+        printf("Error opening file: %s\n", filename);
+        return -1;
+    }
+    ConfigWriter* w = (ConfigWriter*)malloc(sizeof(ConfigWriter));
+    if (!w) {
+        printf("Memory allocation for writer failed.\n");
+        config_fd_close(fd);
+        return -1;
+    }
+
+    config_writer_init(w, config_fd_write, &fd, 0);
+    write_container(w, 0x80, 0xde, cm->size);
+    for (size_t i = 0; i < cm->size && !w->failed; ++i) {
+        write_str(w, cm->records[i].key);
+        write_value(w, &cm->records[i]);
+    }
+    int result = config_writer_flush(w);
+    free(w);
+    if (config_fd_close(fd) != 0) {
+        result = -1;
+    }
+    if (result != 0) {
+        printf("Error writing file: %s\n", filename);
+    }
+    return result;
+}
+
+
+// ---- decoding ----
+
+// Bounds-checked cursor over the file. failed sticks on the first structural error.
+typedef struct MsgReader {
+    const unsigned char* p;
+    size_t left;
+    int failed;
+} MsgReader;
+
+static const unsigned char* take(MsgReader* r, size_t length) {
+    if (r->failed || length > r->left) {
+        r->failed = 1;
+        return NULL;
+    }
+    const unsigned char* bytes = r->p;
+    r->p += length;
+    r->left -= length;
+    return bytes;
+}
+
+static uint64_t read_be(MsgReader* r, int size) {
+    const unsigned char* bytes = take(r, (size_t)size);
+    uint64_t value = 0;
+    for (int i = 0; bytes && i < size; ++i) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+static float float_from_bits(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static double double_from_bits(uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+
+// Scalar and header of the next value, decoded into one of these kinds
+typedef enum MsgKind {
+    MSG_INT,      // i
+    MSG_FLOAT,    // f (float32 or float64)
+    MSG_STR,      // bytes, length
+    MSG_ARRAY,    // length elements follow
+    MSG_MAP,      // length pairs follow
+    MSG_EXT,      // extType, bytes, length
+    MSG_OTHER,    // nil, bool or bin, already consumed
+    MSG_BAD       // malformed, r->failed is set
+} MsgKind;
+
+typedef struct MsgItem {
+    MsgKind kind;
+    int64_t i;
+    int intOverflow;   // an integer beyond 64-bit signed range
+    double f;
+    const unsigned char* bytes;
+    size_t length;
+    int extType;
+} MsgItem;
+
+static MsgKind read_item(MsgReader* r, MsgItem* item) {
+    item->intOverflow = 0;
+    const unsigned char* marker = take(r, 1);
+    if (!marker) {
+        return item->kind = MSG_BAD;
+    }
+    unsigned char c = *marker;
+    size_t length = 0;
+
+    if (c < 0x80 || c >= 0xe0) {
+        item->i = (int8_t)c;
+        if (c < 0x80) item->i = c;
+        return item->kind = MSG_INT;
+    }
+    if (c < 0x90) { item->length = c & 0x0f; return item->kind = MSG_MAP; }
+    if (c < 0xa0) { item->length = c & 0x0f; return item->kind = MSG_ARRAY; }
+    if (c < 0xc0) { length = c & 0x1f; goto str; }
+
+    switch (c) {
+    case 0xc0: case 0xc2: case 0xc3:
+        return item->kind = MSG_OTHER;
+    case 0xc4: case 0xc5: case 0xc6:
+        length = (size_t)read_be(r, 1 << (c - 0xc4));
+        take(r, length);
+        return item->kind = r->failed ? MSG_BAD : MSG_OTHER;
+    case 0xc7: case 0xc8: case 0xc9:
+        length = (size_t)read_be(r, 1 << (c - 0xc7));
+        goto ext;
+    case 0xca:
+        item->f = float_from_bits((uint32_t)read_be(r, 4));
+        return item->kind = r->failed ? MSG_BAD : MSG_FLOAT;
+    case 0xcb:
+        item->f = double_from_bits(read_be(r, 8));
+        return item->kind = r->failed ? MSG_BAD : MSG_FLOAT;
+    case 0xcc: case 0xcd: case 0xce: case 0xcf: {
+        uint64_t u = read_be(r, 1 << (c - 0xcc));
+        item->intOverflow = u > (uint64_t)INT64_MAX;
+        item->i = (int64_t)u;
+        return item->kind = r->failed ? MSG_BAD : MSG_INT;
+    }
+    case 0xd0: item->i = (int8_t)read_be(r, 1); return item->kind = r->failed ? MSG_BAD : MSG_INT;
+    case 0xd1: item->i = (int16_t)read_be(r, 2); return item->kind = r->failed ? MSG_BAD : MSG_INT;
+    case 0xd2: item->i = (int32_t)read_be(r, 4); return item->kind = r->failed ? MSG_BAD : MSG_INT;
+    case 0xd3: item->i = (int64_t)read_be(r, 8); return item->kind = r->failed ? MSG_BAD : MSG_INT;
+    case 0xd4: case 0xd5: case 0xd6: case 0xd7: case 0xd8:
+        length = (size_t)1 << (c - 0xd4);
+        goto ext;
+    case 0xd9: case 0xda: case 0xdb:
+        length = (size_t)read_be(r, 1 << (c - 0xd9));
+        goto str;
+    case 0xdc: case 0xdd:
+        item->length = (size_t)read_be(r, c == 0xdc ? 2 : 4);
+        return item->kind = r->failed ? MSG_BAD : MSG_ARRAY;
+    case 0xde: case 0xdf:
+        item->length = (size_t)read_be(r, c == 0xde ? 2 : 4);
+        return item->kind = r->failed ? MSG_BAD : MSG_MAP;
+    default:  // 0xc1 is never used
+        r->failed = 1;
+        return item->kind = MSG_BAD;
+    }
+
+str:
+    item->length = length;
+    item->bytes = take(r, length);
+    return item->kind = r->failed ? MSG_BAD : MSG_STR;
+ext: {
+    const unsigned char* extType = take(r, 1);
+    item->extType = extType ? (int8_t)*extType : 0;
+    item->length = length;
+    item->bytes = take(r, length);
+    return item->kind = r->failed ? MSG_BAD : MSG_EXT;
+}
+}
+
+
+// Consume the elements of a container whose header was just read
+static void skip_children(MsgReader* r, const MsgItem* item, int depth) {
+    if (item->kind != MSG_ARRAY && item->kind != MSG_MAP) {
+        return;
+    }
+    if (depth >= MSGPACK_MAX_DEPTH) {
+        r->failed = 1;
+        return;
+    }
+    if (item->length > r->left) {  // every element takes at least one byte
+        r->failed = 1;
+        return;
+    }
+    size_t count = item->kind == MSG_MAP ? item->length * 2 : item->length;
+    for (size_t n = 0; n < count && !r->failed; ++n) {
+        MsgItem child;
+        read_item(r, &child);
+        skip_children(r, &child, depth + 1);
+    }
+}
+
+
+static int int_in_range(const MsgItem* item) {
+    return !item->intOverflow && item->i >= INT_MIN && item->i <= INT_MAX;
+}
+
+static char* copy_str(const MsgItem* item) {
+    if (memchr(item->bytes, '\0', item->length)) {
+        return NULL;  // would be cut short as a C string
+    }
+    char* str = (char*)malloc(item->length + 1);
+    if (str) {
+        memcpy(str, item->bytes, item->length);
+        str[item->length] = '\0';
+    }
+    return str;
+}
+
+static void unpack_be32(const unsigned char* bytes, uint32_t* out, size_t count) {
+    for (size_t i = 0; i < count; ++i, bytes += 4) {
+        out[i] = (uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 8 | bytes[3];
+    }
+}
+
+
+// Plain array value: all strings give STRING_ARRAY, all ints INT_ARRAY, ints and floats FLOAT_ARRAY.
+// return 0 with kv filled, 1 for an unsupported array (consumed), -1 for allocation failure.
+static int read_plain_array(MsgReader* r, const MsgItem* header, KeyValuePair* kv) {
+    size_t count = header->length;
+    if (count > r->left) {  // every element takes at least one byte
+        r->failed = 1;
+        return 1;
+    }
+
+    // classify on a copy of the cursor, then decode for real
+    MsgReader scan = *r;
+    int strings = 0, ints = 0, floats = 0;
+    for (size_t n = 0; n < count && !scan.failed; ++n) {
+        MsgItem element;
+        read_item(&scan, &element);
+        if (element.kind == MSG_STR && !memchr(element.bytes, '\0', element.length)) strings++;
+        else if (element.kind == MSG_INT && int_in_range(&element)) ints++;
+        else if (element.kind == MSG_FLOAT || element.kind == MSG_INT) floats++;
+        else skip_children(&scan, &element, 1);
+    }
+    if (scan.failed) {
+        r->failed = 1;
+        return 1;
+    }
+    if (strings + ints + floats != (int)count || (strings && (ints || floats))) {
+        *r = scan;
+        return 1;
+    }
+
+    kv->arraySize = count;
+    if (strings || count == 0) {
+        kv->type = STRING_ARRAY;
+        kv->value.stringArrayValue = (char**)calloc(count + 1, sizeof(char*));
+    }
+    else if (floats) {
+        kv->type = FLOAT_ARRAY;
+        kv->value.floatArrayValue = (float*)malloc(count * sizeof(float) + 1);
+    }
+    else {
+        kv->type = INT_ARRAY;
+        kv->value.intArrayValue = (int*)malloc(count * sizeof(int) + 1);
+    }
+    if (!kv->value.stringValue) {
+        return -1;
+    }
+
+    for (size_t n = 0; n < count; ++n) {
+        MsgItem element;
+        read_item(r, &element);
+        if (kv->type == STRING_ARRAY) {
+            kv->value.stringArrayValue[n] = copy_str(&element);
+            if (!kv->value.stringArrayValue[n]) {
+                return -1;
+            }
+        }
+        else if (kv->type == INT_ARRAY) {
+            kv->value.intArrayValue[n] = (int)element.i;
+        }
+        else {
+            kv->value.floatArrayValue[n] = element.kind == MSG_FLOAT ? (float)element.f
+                : element.intOverflow ? (float)(uint64_t)element.i : (float)element.i;
+        }
+    }
+    return 0;
+}
+
+
+// Decode one value into kv (key already set).
+// return 0 when stored in kv, 1 for an unsupported or out-of-range value (consumed), -1 for allocation failure.
+static int read_value(MsgReader* r, KeyValuePair* kv) {
+    MsgItem item;
+    switch (read_item(r, &item)) {
+    case MSG_INT:
+        if (!int_in_range(&item)) return 1;
+        kv->type = INT;
+        kv->value.intValue = (int)item.i;
+        return 0;
+    case MSG_FLOAT:
+        kv->type = FLOAT;
+        kv->value.floatValue = (float)item.f;
+        return 0;
+    case MSG_STR:
+        if (memchr(item.bytes, '\0', item.length)) return 1;
+        kv->type = STRING;
+        kv->value.stringValue = copy_str(&item);
+        return kv->value.stringValue ? 0 : -1;
+    case MSG_ARRAY:
+        return read_plain_array(r, &item, kv);
+    case MSG_EXT: {
+        if ((item.extType != MSGPACK_EXT_INT_ARRAY && item.extType != MSGPACK_EXT_FLOAT_ARRAY) || item.length % 4 != 0) {
+            return 1;
+        }
+        size_t count = item.length / 4;
+        uint32_t* values = (uint32_t*)malloc(count * 4 + 1);
+        if (!values) return -1;
+        unpack_be32(item.bytes, values, count);
+        kv->type = item.extType == MSGPACK_EXT_INT_ARRAY ? INT_ARRAY : FLOAT_ARRAY;
+        kv->value.intArrayValue = (int*)values;
+        kv->arraySize = count;
+        return 0;
+    }
+    default:
+        skip_children(r, &item, 1);
+        return 1;
+    }
+}
+
+
+// Load configuration data from a MessagePack file
+int load_config_from_msgpack(ConfigManager* cm, const char* filename) {
+    if (!cm || !filename) {
+        return -1;
+    }
+    size_t size = 0;
+    char* data = config_read_file(filename, &size);
+    if (!data) {
+        return -1;
+    }
+
+    MsgReader r = { (const unsigned char*)data, size, 0 };
+    MsgItem root;
+    if (read_item(&r, &root) != MSG_MAP || root.length > size) {
+        printf("Error parsing MessagePack: top-level map expected in %s\n", filename);
+        free(data);
+        return -1;
+    }
+
+    int bulk = begin_config_bulk_load(cm) == 0;
+    size_t mark = cm->size;
+    int error = 0;
+    for (size_t n = 0; n < root.length && !error; ++n) {
+        MsgItem keyItem;
+        if (read_item(&r, &keyItem) != MSG_STR || memchr(keyItem.bytes, '\0', keyItem.length)) {
+            // not usable as a key, skip the pair
+            skip_children(&r, &keyItem, 1);
+            if (!r.failed) {
+                read_item(&r, &keyItem);
+                skip_children(&r, &keyItem, 1);
+            }
+            error = r.failed;
+            continue;
+        }
+
+        KeyValuePair kv;
+        memset(&kv, 0, sizeof(kv));
+        kv.key = copy_str(&keyItem);
+        int status = kv.key ? read_value(&r, &kv) : -1;
+        if (r.failed) {
+            error = 1;
+        }
+        else if (status < 0) {
+            printf("Memory allocation for record failed.\n");
+            error = 1;
+        }
+        if (status != 0 || error) {
+            free_key_value_pair(&kv);
+            continue;
+        }
+        kv.keyHash = config_hash_key(kv.key);
+        kv.valueHash = config_hash_value(&kv);
+        config_put_record(cm, &kv);
+    }
+    if (!error && r.left != 0) {
+        error = 1;  // trailing bytes, not a file we wrote
+    }
+
+    if (error) {
+        // in bulk mode the records of this file are still an unchecked tail, drop them all
+        printf("Error parsing MessagePack: %s is malformed near offset %zu\n", filename, size - r.left);
+        while (cm->size > mark) {
+            free_key_value_pair(&cm->records[--cm->size]);
+        }
+    }
+    int result = bulk ? end_config_bulk_load(cm) : 0;
+    free(data);
+    return error ? -1 : result;
+}
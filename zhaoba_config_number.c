@@ -0,0 +1,305 @@
+#include "zhaoba_config_internal.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Shortest round-trip number formatting (Grisu2, after Florian Loitsch's "Printing Floating-Point
+// Numbers Quickly and Accurately with Integers" and the RapidJSON implementation).
+//
+// The digits are generated from the value's own rounding interval, so a FLOAT is formatted against
+// float32 neighbours and prints as 3.14 instead of the widened 3.1400001049041748. One pass of
+// integer arithmetic replaces the sprintf/sscanf/sprintf round trip of cJSON's print_number.
+
+
+// w = f * 2^e
+typedef struct DiyFp {
+    uint64_t f;
+    int e;
+} DiyFp;
+
+// Normalized 64-bit significands and binary exponents of 10^k for k = -348, -340, ..., 340
+static const uint64_t cachedPowersF[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+    0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+    0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+    0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+    0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+    0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL, 0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+    0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+    0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+    0x9c40000000000000ULL, 0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+    0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+    0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+    0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+    0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+    0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+    0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+static const int16_t cachedPowersE[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066
+};
+
+static const uint64_t pow10Table[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+    10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+    1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+
+static DiyFp diyfp_multiply(DiyFp a, DiyFp b) {
+    const uint64_t mask32 = 0xFFFFFFFFu;
+    uint64_t a1 = a.f >> 32, a0 = a.f & mask32;
+    uint64_t b1 = b.f >> 32, b0 = b.f & mask32;
+    uint64_t p11 = a1 * b1, p01 = a0 * b1, p10 = a1 * b0, p00 = a0 * b0;
+    uint64_t middle = (p00 >> 32) + (p10 & mask32) + (p01 & mask32) + (1u << 31);  // round the low half
+    DiyFp r;
+    r.f = p11 + (p10 >> 32) + (p01 >> 32) + (middle >> 32);
+    r.e = a.e + b.e + 64;
+    return r;
+}
+
+
+static DiyFp diyfp_normalize(DiyFp x) {
+    while (!(x.f & ((uint64_t)1 << 63))) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+
+// Cached power c = 10^-K such that the product with a value of binary exponent e lands in [2^-60, 2^-32)
+static DiyFp cached_power(int e, int* K) {
+    double dk = (-61 - e) * 0.30102999566398114 + 347;
+    int k = (int)dk;
+    if (dk - k > 0.0) {
+        k++;
+    }
+    unsigned int index = (unsigned int)((k >> 3) + 1);
+    *K = -(-348 + (int)(index << 3));
+    DiyFp c;
+    c.f = cachedPowersF[index];
+    c.e = cachedPowersE[index];
+    return c;
+}
+
+
+static int count_decimal_digits(uint32_t n) {
+    int digits = 1;
+    while (digits < 10 && n >= pow10Table[digits]) {
+        digits++;
+    }
+    return digits;
+}
+
+
+// Nudge the last digit towards the exact value while it stays inside the rounding interval
+static void grisu_round(char* buffer, int length, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t distance) {
+    while (rest < distance && delta - rest >= tenKappa &&
+           (rest + tenKappa < distance || distance - rest > rest + tenKappa - distance)) {
+        buffer[length - 1]--;
+        rest += tenKappa;
+    }
+}
+
+
+static void digit_gen(DiyFp w, DiyFp upper, uint64_t delta, char* buffer, int* length, int* K) {
+    DiyFp one;
+    one.f = (uint64_t)1 << -upper.e;
+    one.e = upper.e;
+    uint64_t distance = upper.f - w.f;
+    uint32_t p1 = (uint32_t)(upper.f >> -one.e);
+    uint64_t p2 = upper.f & (one.f - 1);
+    int kappa = count_decimal_digits(p1);
+    *length = 0;
+
+    while (kappa > 0) {
+        uint32_t divisor = (uint32_t)pow10Table[kappa - 1];
+        uint32_t d = p1 / divisor;
+        p1 %= divisor;
+        if (d || *length) {
+            buffer[(*length)++] = (char)('0' + d);
+        }
+        kappa--;
+        uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+        if (rest <= delta) {
+            *K += kappa;
+            grisu_round(buffer, *length, delta, rest, (uint64_t)pow10Table[kappa] << -one.e, distance);
+            return;
+        }
+    }
+
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+        char d = (char)(p2 >> -one.e);
+        if (d || *length) {
+            buffer[(*length)++] = (char)('0' + d);
+        }
+        p2 &= one.f - 1;
+        kappa--;
+        if (p2 < delta) {
+            *K += kappa;
+            int index = -kappa;
+            grisu_round(buffer, *length, delta, p2, one.f, distance * (index < 20 ? pow10Table[index] : 0));
+            return;
+        }
+    }
+}
+
+
+// Shortest digits for v = f * 2^e, a positive value with a precision-bit significand (hidden bit included).
+// The digit string times 10^K lies strictly inside v's rounding interval.
+static void grisu2(uint64_t f, int e, int precision, char* buffer, int* length, int* K) {
+    DiyFp v = { f, e };
+
+    DiyFp upper = { (f << 1) + 1, e - 1 };
+    upper = diyfp_normalize(upper);
+    // at a power of two the neighbour below is twice as close
+    DiyFp lower = (f == (uint64_t)1 << (precision - 1)) ? (DiyFp){ (f << 2) - 1, e - 2 } : (DiyFp){ (f << 1) - 1, e - 1 };
+    lower.f <<= lower.e - upper.e;
+    lower.e = upper.e;
+
+    DiyFp c = cached_power(upper.e, K);
+    DiyFp w = diyfp_multiply(diyfp_normalize(v), c);
+    DiyFp wPlus = diyfp_multiply(upper, c);
+    DiyFp wMinus = diyfp_multiply(lower, c);
+    wMinus.f++;
+    wPlus.f--;
+    digit_gen(w, wPlus, wPlus.f - wMinus.f, buffer, length, K);
+}
+
+
+static char* write_exponent(int k, char* out) {
+    if (k < 0) {
+        *out++ = '-';
+        k = -k;
+    }
+    if (k >= 100) {
+        *out++ = (char)('0' + k / 100);
+        k %= 100;
+        *out++ = (char)('0' + k / 10);
+    }
+    else if (k >= 10) {
+        *out++ = (char)('0' + k / 10);
+    }
+    *out++ = (char)('0' + k % 10);
+    return out;
+}
+
+
+// Lay out digits * 10^k as a JSON number: plain integers and decimals up to 21 digits, exponent form beyond
+static int prettify(char* buffer, int length, int k) {
+    int kk = length + k;  // 10^(kk-1) <= v < 10^kk
+    if (k >= 0 && kk <= 21) {
+        // 1234e2 -> 123400
+        memset(buffer + length, '0', (size_t)k);
+        return kk;
+    }
+    if (kk > 0 && kk <= 21) {
+        // 1234e-2 -> 12.34
+        memmove(buffer + kk + 1, buffer + kk, (size_t)(length - kk));
+        buffer[kk] = '.';
+        return length + 1;
+    }
+    if (kk > -6 && kk <= 0) {
+        // 1234e-6 -> 0.001234
+        int offset = 2 - kk;
+        memmove(buffer + offset, buffer, (size_t)length);
+        buffer[0] = '0';
+        buffer[1] = '.';
+        memset(buffer + 2, '0', (size_t)(offset - 2));
+        return length + offset;
+    }
+    if (length == 1) {
+        // 1e30
+        buffer[1] = 'e';
+        return (int)(write_exponent(kk - 1, buffer + 2) - buffer);
+    }
+    // 1234e30 -> 1.234e33
+    memmove(buffer + 2, buffer + 1, (size_t)(length - 1));
+    buffer[1] = '.';
+    buffer[length + 1] = 'e';
+    return (int)(write_exponent(kk - 1, buffer + length + 2) - buffer);
+}
+
+
+// NaN, infinity and zero are spelled the way cJSON prints them
+static int format_special(double d, char* buffer) {
+    if (d != d || d - d != 0.0) {
+        memcpy(buffer, "null", 5);
+        return 4;
+    }
+    buffer[0] = '0';
+    buffer[1] = '\0';
+    return 1;
+}
+
+
+int config_format_double(double d, char* buffer) {
+    if (d == 0.0 || d != d || d - d != 0.0) {
+        return format_special(d, buffer);
+    }
+
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    char* out = buffer;
+    if (bits >> 63) {
+        *out++ = '-';
+    }
+    int biased = (int)((bits >> 52) & 0x7FF);
+    uint64_t significand = bits & (((uint64_t)1 << 52) - 1);
+    uint64_t f = biased ? significand | ((uint64_t)1 << 52) : significand;
+    int e = biased ? biased - 1075 : -1074;
+
+    int length, K;
+    grisu2(f, e, 53, out, &length, &K);
+    length = prettify(out, length, K) + (int)(out - buffer);
+    buffer[length] = '\0';
+    return length;
+}
+
+
+int config_format_float(float value, char* buffer) {
+    if (value == 0.0f || value != value || value - value != 0.0f) {
+        return format_special(value, buffer);
+    }
+
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    char* out = buffer;
+    if (bits >> 31) {
+        *out++ = '-';
+    }
+    int biased = (int)((bits >> 23) & 0xFF);
+    uint32_t significand = bits & ((1u << 23) - 1);
+    uint64_t f = biased ? significand | (1u << 23) : significand;
+    int e = biased ? biased - 150 : -149;
+
+    int length, K;
+    grisu2(f, e, 24, out, &length, &K);
+    length = prettify(out, length, K) + (int)(out - buffer);
+    buffer[length] = '\0';
+
+    // The loader reads numbers as double and then narrows to float. That double rounding can in
+    // theory move a value sitting right on a float rounding boundary, so confirm and fall back to 9 digits.
+    if ((float)strtod(buffer, NULL) != value) {
+        length = sprintf(buffer, "%.9g", value);
+    }
+    return length;
+}
@@ -0,0 +1,252 @@
+#include "zhaoba_config_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Deployment overrides from the environment and the command line, applied on top of loaded files.
+//
+//      APP_DB__POOL_SIZE=16          envPrefix "APP_": the rest lowercased, "__" becomes ".", key "db.pool_size"
+//      --config.db.pool_size=16      argPrefix "--config.": the rest up to '=' is the key as written
+//      --config.db.pool_size 16      without '=', the next argument is the value
+//
+// Values are read like INI values (zhaoba_config_ini.c): int, float, "quoted string", comma lists.
+// A key that already exists takes the override in its stored type: a STRING gets the text as written,
+// an INT becomes a FLOAT, a single value becomes a one-element array, numbers become strings in a
+// STRING_ARRAY. In a layer (add_config_layer) the stored type is looked up in the flattened view, so an
+// override in a top layer keeps the type a lower layer gave the key. Everything is parsed first and stored
+// in one bulk load, so a few hundred variables cost one pass over environ and argv plus one index resolve.
+
+#ifdef _WIN32
+#define config_environ _environ
+#else
+extern char** environ;
+#define config_environ environ
+#endif
+
+
+// Copy of text[0, length) as a new string
+static char* copy_text(const char* text, size_t length) {
+    char* copy = (char*)malloc(length + 1);
+    if (copy) {
+        memcpy(copy, text, length);
+        copy[length] = '\0';
+    }
+    return copy;
+}
+
+
+// Free kv's value, keeping its key
+static void release_value(KeyValuePair* kv) {
+    if (kv->type == STRING) {
+        free(kv->value.stringValue);
+    }
+    else if (kv->type == STRING_ARRAY) {
+        for (size_t i = 0; i < kv->arraySize; ++i) free(kv->value.stringArrayValue[i]);
+        free(kv->value.stringArrayValue);
+    }
+    else if (kv->type == INT_ARRAY || kv->type == FLOAT_ARRAY) {
+        free(kv->value.intArrayValue);
+    }
+    kv->type = INT;
+    kv->arraySize = 0;
+}
+
+
+// Parse text into kv, making it a one-element list when asList is set and text is a single value
+static int parse_override(const char* text, size_t length, int asList, KeyValuePair* kv) {
+    if (config_parse_text_value(text, length, kv) != 0) {
+        return -1;
+    }
+    if (!asList || kv->type == INT_ARRAY || kv->type == FLOAT_ARRAY || kv->type == STRING_ARRAY) {
+        return 0;
+    }
+    // a trailing comma is how the INI syntax writes a one-element list
+    char* list = (char*)malloc(length + 2);
+    if (!list) {
+        return -1;
+    }
+    memcpy(list, text, length);
+    list[length] = ',';
+    release_value(kv);
+    int result = config_parse_text_value(list, length + 1, kv);
+    free(list);
+    return result;
+}
+
+
+// Convert kv (parsed from text) to type. return 0 on success, 1 if it cannot be converted, -1 on allocation failure.
+static int coerce_override(KeyValuePair* kv, ValueType type, const char* text, size_t length) {
+    if (kv->type == type) {
+        return 0;
+    }
+    switch (type) {
+    case STRING: {
+        while (length > 0 && (*text == ' ' || *text == '\t')) { ++text; --length; }
+        while (length > 0 && (text[length - 1] == ' ' || text[length - 1] == '\t')) --length;
+        char* str = copy_text(text, length);
+        if (!str) return -1;
+        release_value(kv);
+        kv->type = STRING;
+        kv->value.stringValue = str;
+        return 0;
+    }
+    case FLOAT:
+        if (kv->type != INT) return 1;
+        kv->value.floatValue = (float)kv->value.intValue;
+        kv->type = FLOAT;
+        return 0;
+    case FLOAT_ARRAY:
+        if (kv->type != INT_ARRAY) return 1;
+        for (size_t i = 0; i < kv->arraySize; ++i) {
+            kv->value.floatArrayValue[i] = (float)kv->value.intArrayValue[i];
+        }
+        kv->type = FLOAT_ARRAY;
+        return 0;
+    case STRING_ARRAY: {
+        if (kv->type != INT_ARRAY && kv->type != FLOAT_ARRAY) return 1;
+        char** strings = (char**)calloc(kv->arraySize + 1, sizeof(char*));
+        if (!strings) return -1;
+        for (size_t i = 0; i < kv->arraySize; ++i) {
+            char buffer[CONFIG_NUMBER_BUFFER_SIZE];
+            if (kv->type == INT_ARRAY) {
+                snprintf(buffer, sizeof(buffer), "%d", kv->value.intArrayValue[i]);
+            }
+            else if (config_format_float(kv->value.floatArrayValue[i], buffer) == 4 && strcmp(buffer, "null") == 0) {
+                snprintf(buffer, sizeof(buffer), "%g", kv->value.floatArrayValue[i]);
+            }
+            strings[i] = _strdup(buffer);
+            if (!strings[i]) {
+                while (i > 0) free(strings[--i]);
+                free(strings);
+                return -1;
+            }
+        }
+        free(kv->value.intArrayValue);
+        kv->value.stringArrayValue = strings;
+        kv->type = STRING_ARRAY;
+        return 0;
+    }
+    default:
+        return 1;
+    }
+}
+
+
+// Parse one override into list. return 0 on success, 1 if it was rejected, -1 on allocation failure.
+static int add_override(ConfigManager* cm, ConfigRecordList* list, char* key, const char* text) {
+    KeyValuePair kv;
+    memset(&kv, 0, sizeof(kv));
+    kv.key = key;
+    size_t length = strlen(text);
+
+    // a layer takes the type the key has in the flattened view, which a lower layer may set
+    ConfigManager* view = cm;
+    while (view->layerView) {
+        view = view->layerView;
+    }
+    size_t i = find_record_index(view, key);
+    int typed = i != CONFIG_NPOS;
+    ValueType type = typed ? view->records[i].type : STRING;
+    int asList = typed && (type == INT_ARRAY || type == FLOAT_ARRAY || type == STRING_ARRAY);
+
+    int result = parse_override(text, length, asList, &kv);
+    if (result == 0 && typed) {
+        result = coerce_override(&kv, type, text, length);
+    }
+    if (result == 0) {
+        kv.keyHash = config_hash_key(kv.key);
+        kv.valueHash = config_hash_value(&kv);
+        result = config_record_list_append(list, &kv);
+    }
+    if (result != 0) {
+        if (result > 0) {
+            printf("Error: override for key '%s' does not fit its type %d, ignored.\n", key, type);
+        }
+        free_key_value_pair(&kv);
+    }
+    return result;
+}
+
+
+// Key for an environment variable name: lowercase, "__" becomes "."
+static char* env_key(const char* name, size_t length) {
+    char* key = (char*)malloc(length + 1);
+    if (!key) {
+        return NULL;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < length; ++i) {
+        char c = name[i];
+        if (c == '_' && i + 1 < length && name[i + 1] == '_') {
+            key[n++] = '.';
+            ++i;
+        }
+        else {
+            key[n++] = (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+        }
+    }
+    key[n] = '\0';
+    return key;
+}
+
+
+// Apply overrides from the environment and the command line
+int apply_config_overrides(ConfigManager* cm, const char* envPrefix, int argc, char* argv[], const char* argPrefix) {
+    if (!cm || (argc > 0 && !argv) || config_bulk_resolve(cm) != 0) {
+        return -1;
+    }
+
+    ConfigRecordList list = { NULL, 0, 0 };
+    int rejected = 0;
+    int error = 0;
+
+    // environment first, so the command line wins
+    size_t envPrefixLength = envPrefix ? strlen(envPrefix) : 0;
+    for (char** env = envPrefix ? config_environ : NULL; env && *env && !error; ++env) {
+        const char* entry = *env;
+        const char* equals = strchr(entry, '=');
+        if (!equals || strncmp(entry, envPrefix, envPrefixLength) != 0 || (size_t)(equals - entry) <= envPrefixLength) {
+            continue;
+        }
+        char* key = env_key(entry + envPrefixLength, (size_t)(equals - entry) - envPrefixLength);
+        int result = key ? add_override(cm, &list, key, equals + 1) : -1;
+        if (result > 0) rejected = 1;
+        if (result < 0) error = 1;
+    }
+
+    size_t argPrefixLength = argPrefix ? strlen(argPrefix) : 0;
+    for (int a = 1; argPrefix && a < argc && !error; ++a) {
+        const char* arg = argv[a];
+        if (!arg || strncmp(arg, argPrefix, argPrefixLength) != 0) {
+            continue;
+        }
+        const char* name = arg + argPrefixLength;
+        const char* equals = strchr(name, '=');
+        const char* value = equals ? equals + 1 : (a + 1 < argc ? argv[a + 1] : NULL);
+        size_t nameLength = equals ? (size_t)(equals - name) : strlen(name);
+        if (nameLength == 0 || !value) {
+            continue;
+        }
+        if (!equals) {
+            ++a;   // the value was the next argument
+        }
+        char* key = copy_text(name, nameLength);
+        int result = key ? add_override(cm, &list, key, value) : -1;
+        if (result > 0) rejected = 1;
+        if (result < 0) error = 1;
+    }
+
+    if (error) {
+        printf("Memory allocation for overrides failed.\n");
+        config_record_list_free(&list);
+        return -1;
+    }
+
+    int bulk = begin_config_bulk_load(cm) == 0;
+    for (size_t i = 0; i < list.count; ++i) {
+        config_put_record(cm, &list.records[i]);
+    }
+    list.count = 0;
+    int result = bulk ? end_config_bulk_load(cm) : 0;
+    config_record_list_free(&list);
+    return result != 0 || rejected ? -1 : 0;
+}
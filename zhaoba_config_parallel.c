@@ -0,0 +1,486 @@
+#include "zhaoba_config_internal.h"
+#include "zhaoba_config_thread.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+// below this many bytes per worker, thread start-up costs more than the parse it saves
+#define PARALLEL_MIN_CHUNK_BYTES (1 << 20)
+
+// One slice of the top-level array, parsed by one worker.
+//
+// start is a speculative record boundary, found by looking for "}, {" without tracking string state.
+// The worker parses whole records from start and stops at the first record beginning at or after limit,
+// so when the next chunk's start is a real boundary this chunk's end lands exactly on it.
+// The merge step only accepts a chunk whose start equals the previous chunk's end, anything else is re-parsed.
+typedef struct ParseChunk {
+    const char* text;
+    size_t textSize;
+    size_t start;
+    size_t limit;
+    size_t end;
+    ConfigRecordList list;
+    int failed;
+} ParseChunk;
+
+// One *.json fragment of a directory load, parsed by whichever worker claims it
+typedef struct FragmentFile {
+    char* path;
+    ConfigRecordList list;
+    int failed;
+} FragmentFile;
+
+// Shared work queue of a directory load
+typedef struct FragmentQueue {
+    FragmentFile* files;
+    size_t count;
+    size_t next;
+    config_mutex_t lock;
+} FragmentQueue;
+
+
+static int is_json_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static size_t skip_space(const char* text, size_t pos, size_t size) {
+    while (pos < size && is_json_space(text[pos])) {
+        ++pos;
+    }
+    return pos;
+}
+
+
+// Find the first '{' at or after from that looks like the start of a record: "}" ws "," ws "{".
+// return size if there is none.
+static size_t find_record_start(const char* text, size_t from, size_t size) {
+    while (from < size) {
+        const char* brace = (const char*)memchr(text + from, '{', size - from);
+        if (!brace) {
+            return size;
+        }
+
+        size_t pos = (size_t)(brace - text);
+        size_t back = pos;
+        while (back > 0 && is_json_space(text[back - 1])) --back;
+        if (back > 0 && text[back - 1] == ',') {
+            --back;
+            while (back > 0 && is_json_space(text[back - 1])) --back;
+            if (back > 0 && text[back - 1] == '}') {
+                return pos;
+            }
+        }
+        from = pos + 1;
+    }
+    return size;
+}
+
+
+int config_record_list_append(ConfigRecordList* list, KeyValuePair* kv) {
+    if (list->count >= list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 64;
+        KeyValuePair* records = (KeyValuePair*)realloc(list->records, capacity * sizeof(KeyValuePair));
+        if (!records) {
+            return -1;
+        }
+        list->records = records;
+        list->capacity = capacity;
+    }
+    list->records[list->count++] = *kv;
+    return 0;
+}
+
+
+void config_record_list_free(ConfigRecordList* list) {
+    for (size_t i = 0; i < list->count; ++i) {
+        free_key_value_pair(&list->records[i]);
+    }
+    free(list->records);
+    list->records = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+
+// Worker body: parse records one at a time from start until limit or the closing bracket
+static void parse_chunk(void* arg) {
+    ParseChunk* chunk = (ParseChunk*)arg;
+    const char* text = chunk->text;
+    size_t size = chunk->textSize;
+    size_t pos = skip_space(text, chunk->start, size);
+
+    while (pos < size && text[pos] != ']' && pos < chunk->limit) {
+        const char* parseEnd = NULL;
+        cJSON* item = cJSON_ParseWithLengthOptsReentrant(text + pos, size - pos, &parseEnd, 0);
+        if (!item) {
+            chunk->failed = 1;
+            break;
+        }
+
+        KeyValuePair kv;
+        if (config_record_from_json(item, &kv) == 0 && config_record_list_append(&chunk->list, &kv) != 0) {
+            free_key_value_pair(&kv);
+            chunk->failed = 1;
+        }
+        cJSON_Delete(item);
+        if (chunk->failed) {
+            break;
+        }
+
+        pos = skip_space(text, (size_t)(parseEnd - text), size);
+        if (pos < size && text[pos] == ',') {
+            pos = skip_space(text, pos + 1, size);
+        }
+        else if (pos < size && text[pos] != ']') {
+            chunk->failed = 1;
+            break;
+        }
+    }
+
+    chunk->end = pos;
+}
+
+
+// Load configuration data from a file using several worker threads
+int load_config_from_file_parallel(ConfigManager* cm, const char* filename, unsigned int threadCount) {
+    if (!cm || !filename) {
+        return -1;
+    }
+
+    size_t size = 0;
+    char* text = config_read_file(filename, &size);
+    if (!text) {
+        return -1;
+    }
+
+    size_t first = skip_space(text, 0, size);
+    if (first >= size || text[first] != '[') {
+        printf("Error parsing JSON: top-level array expected in %s\n", filename);
+        free(text);
+        return -1;
+    }
+    ++first;
+
+    if (threadCount == 0) {
+        threadCount = config_cpu_count();
+    }
+    size_t maxChunks = size / PARALLEL_MIN_CHUNK_BYTES + 1;
+    size_t chunkCount = threadCount < maxChunks ? threadCount : maxChunks;
+
+    ParseChunk* chunks = (ParseChunk*)calloc(chunkCount, sizeof(ParseChunk));
+    config_thread_t* threads = (config_thread_t*)calloc(chunkCount, sizeof(config_thread_t));
+    int* started = (int*)calloc(chunkCount, sizeof(int));
+    if (!chunks || !threads || !started) {
+        free(chunks);
+        free(threads);
+        free(started);
+        free(text);
+        return -1;
+    }
+
+    // speculative boundaries at roughly equal byte offsets
+    for (size_t c = 0; c < chunkCount; ++c) {
+        chunks[c].text = text;
+        chunks[c].textSize = size;
+        chunks[c].start = c == 0 ? first : find_record_start(text, first + (size - first) / chunkCount * c, size);
+        if (c > 0 && chunks[c].start < chunks[c - 1].start) {
+            chunks[c].start = chunks[c - 1].start;
+        }
+    }
+    for (size_t c = 0; c < chunkCount; ++c) {
+        chunks[c].limit = c + 1 < chunkCount ? chunks[c + 1].start : size;
+    }
+
+    for (size_t c = 1; c < chunkCount; ++c) {
+        started[c] = config_thread_create(&threads[c], parse_chunk, &chunks[c]) == 0;
+        if (!started[c]) {
+            parse_chunk(&chunks[c]);
+        }
+    }
+    parse_chunk(&chunks[0]);
+    for (size_t c = 1; c < chunkCount; ++c) {
+        if (started[c]) {
+            config_thread_join(threads[c]);
+        }
+    }
+
+    // validate the chain of chunks, re-parsing on this thread any chunk whose start was not a real boundary
+    int result = 0;
+    size_t pos = first;
+    for (size_t c = 0; c < chunkCount; ++c) {
+        ParseChunk* chunk = &chunks[c];
+        if (chunk->failed || chunk->start != pos) {
+            config_record_list_free(&chunk->list);
+            chunk->failed = 0;
+            chunk->start = pos;
+            parse_chunk(chunk);
+            if (chunk->failed) {
+                printf("Error parsing JSON record near offset %zu in %s\n", chunk->end, filename);
+                result = -1;
+                break;
+            }
+        }
+        pos = chunk->end;
+    }
+
+    if (result == 0 && (pos >= size || text[pos] != ']')) {
+        printf("Error parsing JSON: unterminated array in %s\n", filename);
+        result = -1;
+    }
+
+    // merge in file order, so later duplicates win exactly as with load_config_from_file
+    if (result == 0) {
+        int bulk = begin_config_bulk_load(cm) == 0;
+        for (size_t c = 0; c < chunkCount; ++c) {
+            for (size_t i = 0; i < chunks[c].list.count; ++i) {
+                config_put_record(cm, &chunks[c].list.records[i]);
+            }
+            chunks[c].list.count = 0;
+        }
+        if (bulk) {
+            result = end_config_bulk_load(cm);
+        }
+    }
+
+    for (size_t c = 0; c < chunkCount; ++c) {
+        config_record_list_free(&chunks[c].list);
+    }
+    free(chunks);
+    free(threads);
+    free(started);
+    free(text);
+    return result;
+}
+
+
+static int has_json_extension(const char* name) {
+    size_t length = strlen(name);
+    return length > 5 && strcmp(name + length - 5, ".json") == 0;
+}
+
+static int compare_names(const void* a, const void* b) {
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+static char* join_path(const char* dirname, const char* name) {
+    size_t dirLength = strlen(dirname);
+    char* path = (char*)malloc(dirLength + strlen(name) + 2);
+    if (path) {
+        strcpy(path, dirname);
+        if (dirLength > 0 && dirname[dirLength - 1] != '/' && dirname[dirLength - 1] != '\\') {
+            strcat(path, "/");
+        }
+        strcat(path, name);
+    }
+    return path;
+}
+
+
+// List the *.json regular files of a directory, sorted by name (byte order).
+// return the number of names stored in namesOut (caller frees each and the array), or -1 on error.
+static long list_json_files(const char* dirname, char*** namesOut) {
+    char** names = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    int error = 0;
+
+#ifdef _WIN32
+    char* pattern = join_path(dirname, "*.json");
+    if (!pattern) {
+        return -1;
+    }
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(pattern, &data);
+    free(pattern);
+    if (find == INVALID_HANDLE_VALUE) {
+        if (GetLastError() == ERROR_FILE_NOT_FOUND) {
+            *namesOut = NULL;
+            return 0;
+        }
+        printf("Error opening directory: %s\n", dirname);
+        return -1;
+    }
+    do {
+        const char* name = data.cFileName;
+        if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || !has_json_extension(name)) continue;
+#else
+    DIR* dir = opendir(dirname);
+    if (!dir) {
+        printf("Error opening directory: %s\n", dirname);
+        return -1;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const char* name = entry->d_name;
+        if (!has_json_extension(name)) continue;
+
+        char* path = join_path(dirname, name);
+        struct stat st;
+        int regular = path && stat(path, &st) == 0 && S_ISREG(st.st_mode);
+        free(path);
+        if (!regular) continue;
+#endif
+
+        if (count >= capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            char** grown = (char**)realloc(names, capacity * sizeof(char*));
+            if (!grown) {
+                error = 1;
+                break;
+            }
+            names = grown;
+        }
+        names[count] = _strdup(name);
+        if (!names[count]) {
+            error = 1;
+            break;
+        }
+        count++;
+#ifdef _WIN32
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    }
+    closedir(dir);
+#endif
+
+    if (error) {
+        for (size_t i = 0; i < count; ++i) free(names[i]);
+        free(names);
+        return -1;
+    }
+
+    if (count > 1) {
+        qsort(names, count, sizeof(char*), compare_names);
+    }
+    *namesOut = names;
+    return (long)count;
+}
+
+
+// Parse one fragment file into its record list
+static void parse_fragment(FragmentFile* file) {
+    size_t size = 0;
+    char* text = config_read_file(file->path, &size);
+    if (!text) {
+        file->failed = 1;
+        return;
+    }
+
+    cJSON* root = cJSON_ParseWithLengthOptsReentrant(text, size, NULL, 0);
+    if (!root) {
+        printf("Error parsing JSON in %s\n", file->path);
+        free(text);
+        file->failed = 1;
+        return;
+    }
+    free(text);
+
+    cJSON* item = NULL;
+    cJSON_ArrayForEach(item, root) {
+        KeyValuePair kv;
+        if (config_record_from_json(item, &kv) != 0) continue;
+        if (config_record_list_append(&file->list, &kv) != 0) {
+            free_key_value_pair(&kv);
+            file->failed = 1;
+            break;
+        }
+    }
+    cJSON_Delete(root);
+}
+
+
+// Worker body: claim fragments from the queue until it is empty
+static void parse_fragments(void* arg) {
+    FragmentQueue* queue = (FragmentQueue*)arg;
+    for (;;) {
+        config_mutex_lock(&queue->lock);
+        size_t i = queue->next++;
+        config_mutex_unlock(&queue->lock);
+        if (i >= queue->count) {
+            return;
+        }
+        parse_fragment(&queue->files[i]);
+    }
+}
+
+
+// Load every *.json fragment of a directory
+int load_config_from_directory(ConfigManager* cm, const char* dirname, unsigned int threadCount) {
+    if (!cm || !dirname) {
+        return -1;
+    }
+
+    char** names = NULL;
+    long count = list_json_files(dirname, &names);
+    if (count <= 0) {
+        return (int)count;
+    }
+
+    FragmentQueue queue;
+    queue.files = (FragmentFile*)calloc((size_t)count, sizeof(FragmentFile));
+    queue.count = (size_t)count;
+    queue.next = 0;
+    int result = queue.files ? 0 : -1;
+    for (size_t i = 0; result == 0 && i < queue.count; ++i) {
+        queue.files[i].path = join_path(dirname, names[i]);
+        if (!queue.files[i].path) result = -1;
+    }
+    for (size_t i = 0; i < queue.count; ++i) free(names[i]);
+    free(names);
+
+    if (result == 0) {
+        if (threadCount == 0) {
+            threadCount = config_cpu_count();
+        }
+        size_t workerCount = threadCount < queue.count ? threadCount : queue.count;
+        config_thread_t* threads = (config_thread_t*)calloc(workerCount, sizeof(config_thread_t));
+        int* started = (int*)calloc(workerCount, sizeof(int));
+        config_mutex_init(&queue.lock);
+
+        for (size_t t = 1; threads && started && t < workerCount; ++t) {
+            started[t] = config_thread_create(&threads[t], parse_fragments, &queue) == 0;
+        }
+        parse_fragments(&queue);
+        for (size_t t = 1; threads && started && t < workerCount; ++t) {
+            if (started[t]) config_thread_join(threads[t]);
+        }
+
+        config_mutex_destroy(&queue.lock);
+        free(threads);
+        free(started);
+
+        for (size_t i = 0; i < queue.count; ++i) {
+            if (queue.files[i].failed) result = -1;
+        }
+    }
+
+    // merge in lexical file order, a later fragment overrides earlier ones, type included
+    if (result == 0 && config_bulk_resolve(cm) != 0) {
+        result = -1;
+    }
+    for (size_t i = 0; result == 0 && i < queue.count; ++i) {
+        ConfigRecordList* list = &queue.files[i].list;
+        for (size_t r = 0; r < list->count; ++r) {
+            size_t pos = find_record_index(cm, list->records[r].key);
+            if (pos != CONFIG_NPOS) {
+                config_replace_record(cm, pos, &list->records[r]);
+            }
+            else {
+                config_put_record(cm, &list->records[r]);
+            }
+        }
+        list->count = 0;
+    }
+
+    for (size_t i = 0; queue.files && i < queue.count; ++i) {
+        config_record_list_free(&queue.files[i].list);
+        free(queue.files[i].path);
+    }
+    free(queue.files);
+    return result;
+}
@@ -0,0 +1,119 @@
+#include "zhaoba_config_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+// Store kv unless cm already holds the same value, marking old records that are still in the file
+static void reload_record(ConfigManager* cm, KeyValuePair* kv, unsigned char* seen, size_t oldSize) {
+    size_t i = find_record_index(cm, kv->key);
+    if (i == CONFIG_NPOS) {
+        config_put_record(cm, kv);
+        return;
+    }
+
+    if (i < oldSize) {
+        seen[i] = 1;
+    }
+    const KeyValuePair* current = &cm->records[i];
+    if (current->valueHash == kv->valueHash && config_values_equal(current, kv)) {
+        free_key_value_pair(kv);
+        return;
+    }
+    config_replace_record(cm, i, kv);
+}
+
+
+// Read a file in a format other than JSON through its codec into a scratch manager
+static ConfigManager* load_with_codec(const ConfigCodec* codec, const char* filename) {
+    ConfigManager* loaded = create_config_manager();
+    if (!loaded) {
+        return NULL;
+    }
+    if (codec->load(loaded, filename) != 0 || config_bulk_resolve(loaded) != 0) {
+        free_config_manager(loaded);
+        return NULL;
+    }
+    return loaded;
+}
+
+
+// Reload configuration data from a file, applying only the differences
+int reload_config_from_file(ConfigManager* cm, const char* filename) {
+    if (!cm || !filename || config_bulk_resolve(cm) != 0) {
+        return -1;
+    }
+
+    // JSON is diffed straight from the cJSON tree, other formats are loaded whole first
+    const ConfigCodec* codec = detect_config_codec(filename);
+    if (!codec) {
+        return -1;
+    }
+    cJSON* root = NULL;
+    ConfigManager* loaded = NULL;
+    if (codec == &config_json_codec) {
+        size_t fileSize = 0;
+        char* fileContent = config_read_file(filename, &fileSize);
+        if (!fileContent) {
+            return -1;
+        }
+
+        root = cJSON_ParseWithLength(fileContent, fileSize);
+        if (!root) {
+            printf("Error parsing JSON: %s\n", cJSON_GetErrorPtr());
+            free(fileContent);
+            return -1;
+        }
+        free(fileContent);
+    }
+    else {
+        loaded = load_with_codec(codec, filename);
+        if (!loaded) {
+            return -1;
+        }
+    }
+
+    // seen[i] marks records that existed before the reload and are still in the file
+    size_t oldSize = cm->size;
+    unsigned char* seen = (unsigned char*)calloc(oldSize + 1, 1);
+    if (!seen) {
+        cJSON_Delete(root);
+        free_config_manager(loaded);
+        return -1;
+    }
+
+    if (root) {
+        cJSON* item = NULL;
+        cJSON_ArrayForEach(item, root) {
+            KeyValuePair kv;
+            if (config_record_from_json(item, &kv) != 0) continue;
+            reload_record(cm, &kv, seen, oldSize);
+        }
+        cJSON_Delete(root);
+    }
+    else {
+        // move the records over, the emptied slots are skipped when loaded is freed
+        for (size_t i = 0; i < loaded->size; ++i) {
+            KeyValuePair kv = loaded->records[i];
+            memset(&loaded->records[i], 0, sizeof(KeyValuePair));
+            free(kv.rendered);
+            kv.rendered = NULL;
+            kv.changeStamp = 0;
+            reload_record(cm, &kv, seen, oldSize);
+        }
+        free_config_manager(loaded);
+    }
+
+    // seen becomes the removal mask in place, so nothing is allocated once records were applied;
+    // records appended during the reload sit past oldSize and are never removed
+    for (size_t i = 0; i < oldSize; ++i) {
+        seen[i] = !seen[i];
+    }
+    int result = config_remove_records(cm, seen, oldSize);
+    if (result != 0) {
+        printf("Error: keys missing from %s could not be removed.\n", filename);
+    }
+
+    free(seen);
+    config_bindings_refresh(cm);
+    return result;
+}
@@ -0,0 +1,504 @@
+#include "zhaoba_config_internal.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+#endif
+
+// Binary snapshots, read in place through a memory mapping.
+//
+// Layout, all integers in the byte order of the machine that wrote it (checked through byteOrder):
+//      SnapshotHeader
+//      index:   indexCapacity SnapshotSlots, open addressing on keyHash, record + 1 (0 = empty)
+//      records: recordCount SnapshotRecords in store order
+//      heap:    keys and strings NUL-terminated, INT/FLOAT arrays 4-byte aligned,
+//               STRING_ARRAY values as an 8-byte aligned table of u64 heap offsets followed by the strings
+// Every offset in a record is relative to the heap. Nothing is validated beyond the header at open,
+// so each fetch bounds-checks the offsets it follows and a damaged file fails the fetch, never the process.
+
+#define SNAPSHOT_MAGIC "ZCS1"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+
+typedef struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t recordSize;
+    uint64_t recordCount;
+    uint64_t indexCapacity;
+    uint64_t indexOffset;
+    uint64_t recordsOffset;
+    uint64_t heapOffset;
+    uint64_t heapSize;
+    uint64_t fileSize;
+} SnapshotHeader;
+
+typedef struct SnapshotSlot {
+    uint32_t keyHash;
+    uint32_t record;
+} SnapshotSlot;
+
+// value holds the bits of an INT or FLOAT, otherwise the heap offset of the value
+typedef struct SnapshotRecord {
+    uint32_t keyHash;
+    uint32_t type;
+    uint64_t key;
+    uint64_t value;
+    uint64_t arraySize;
+} SnapshotRecord;
+
+struct ConfigSnapshot {
+    const unsigned char* base;
+    size_t size;
+    const SnapshotSlot* index;
+    uint64_t indexCapacity;
+    const SnapshotRecord* records;
+    uint64_t recordCount;
+    const char* heap;
+    uint64_t heapSize;
+};
+
+
+// ---- writing ----
+
+static const char zeros[8] = { 0 };
+
+// Lay out one record's key and value on the heap from offset h, writing the bytes when w is given.
+// The same code computes the offsets and writes the heap, so both passes always agree.
+// return the heap offset after the record.
+static uint64_t layout_record(const KeyValuePair* kv, uint64_t h, SnapshotRecord* r, ConfigWriter* w) {
+    size_t keyLength = strlen(kv->key) + 1;
+    r->keyHash = kv->keyHash;
+    r->type = (uint32_t)kv->type;
+    r->key = h;
+    r->arraySize = 0;
+    r->value = 0;
+    if (w) config_writer_put(w, kv->key, keyLength);
+    h += keyLength;
+
+    uint64_t padded;
+    switch (kv->type) {
+    case INT:
+        r->value = (uint32_t)kv->value.intValue;
+        break;
+    case FLOAT: {
+        uint32_t bits;
+        memcpy(&bits, &kv->value.floatValue, sizeof(bits));
+        r->value = bits;
+        break;
+    }
+    case STRING: {
+        const char* str = kv->value.stringValue ? kv->value.stringValue : "";
+        size_t length = strlen(str) + 1;
+        r->value = h;
+        if (w) config_writer_put(w, str, length);
+        h += length;
+        break;
+    }
+    case INT_ARRAY:
+    case FLOAT_ARRAY:
+        padded = (h + 3) & ~(uint64_t)3;
+        if (w) config_writer_put(w, zeros, (size_t)(padded - h));
+        h = padded;
+        r->value = h;
+        r->arraySize = kv->arraySize;
+        if (w) config_writer_put(w, (const char*)kv->value.intArrayValue, kv->arraySize * 4);
+        h += (uint64_t)kv->arraySize * 4;
+        break;
+    case STRING_ARRAY: {
+        padded = (h + 7) & ~(uint64_t)7;
+        if (w) config_writer_put(w, zeros, (size_t)(padded - h));
+        h = padded;
+        r->value = h;
+        r->arraySize = kv->arraySize;
+        uint64_t strings = h + (uint64_t)kv->arraySize * 8;
+        for (size_t i = 0; i < kv->arraySize; ++i) {
+            if (w) config_writer_put(w, (const char*)&strings, 8);
+            strings += strlen(kv->value.stringArrayValue[i]) + 1;
+        }
+        h += (uint64_t)kv->arraySize * 8;
+        for (size_t i = 0; i < kv->arraySize; ++i) {
+            size_t length = strlen(kv->value.stringArrayValue[i]) + 1;
+            if (w) config_writer_put(w, kv->value.stringArrayValue[i], length);
+            h += length;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    return h;
+}
+
+
+// Save configuration data as a binary snapshot
+int save_config_snapshot(ConfigManager* cm, const char* filename) {
+    if (!cm || !filename || config_bulk_resolve(cm) != 0) {
+        return -1;
+    }
+
+    uint64_t capacity = 16;
+    while (capacity < (uint64_t)cm->size * 2) {
+        capacity *= 2;
+    }
+    SnapshotSlot* index = (SnapshotSlot*)calloc((size_t)capacity, sizeof(SnapshotSlot));
+    SnapshotRecord* records = (SnapshotRecord*)malloc((cm->size + 1) * sizeof(SnapshotRecord));
+    ConfigWriter* w = (ConfigWriter*)malloc(sizeof(ConfigWriter));
+    char* tempPath = config_temp_path(filename);
+    if (!index || !records || !w || !tempPath) {
+        printf("Memory allocation for snapshot failed.\n");
+        free(index);
+        free(records);
+        free(w);
+        free(tempPath);
+        return -1;
+    }
+
+    // pass 1: heap offsets and the index
+    uint64_t heapSize = 0;
+    uint64_t mask = capacity - 1;
+    for (size_t i = 0; i < cm->size; ++i) {
+        heapSize = layout_record(&cm->records[i], heapSize, &records[i], NULL);
+        uint64_t slot = cm->records[i].keyHash & mask;
+        while (index[slot].record != 0) {
+            slot = (slot + 1) & mask;
+        }
+        index[slot].keyHash = cm->records[i].keyHash;
+        index[slot].record = (uint32_t)(i + 1);
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, 4);
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.recordSize = sizeof(SnapshotRecord);
+    header.recordCount = cm->size;
+    header.indexCapacity = capacity;
+    header.indexOffset = sizeof(SnapshotHeader);
+    header.recordsOffset = header.indexOffset + capacity * sizeof(SnapshotSlot);
+    header.heapOffset = header.recordsOffset + (uint64_t)cm->size * sizeof(SnapshotRecord);
+    header.heapSize = heapSize;
+    header.fileSize = header.heapOffset + heapSize;
+
+    // pass 2: write to a temp file and rename it over filename. renaming, unlike rewriting in place,
+    // leaves processes that have the old snapshot mapped with intact pages.
+    int fd = config_file_open_write(tempPath, 1);
+    int result = -1;
+    if (fd >= 0) {
+        config_writer_init(w, config_fd_write, &fd, 0);
+        config_writer_put(w, (const char*)&header, sizeof(header));
+        config_writer_put(w, (const char*)index, (size_t)capacity * sizeof(SnapshotSlot));
+        config_writer_put(w, (const char*)records, cm->size * sizeof(SnapshotRecord));
+        uint64_t h = 0;
+        for (size_t i = 0; i < cm->size && !w->failed; ++i) {
+            SnapshotRecord unused;
+            h = layout_record(&cm->records[i], h, &unused, w);
+        }
+        result = config_writer_flush(w);
+        if (result == 0) {
+            result = config_fd_sync(fd);
+        }
+        if (config_fd_close(fd) != 0) {
+            result = -1;
+        }
+        if (result == 0) {
+            result = config_replace_file(tempPath, filename);
+        }
+        if (result == 0) {
+            config_sync_parent_dir(filename);
+        }
+        else {
+            remove(tempPath);
+        }
+    }
+    if (result != 0) {
+        printf("Error writing snapshot: %s\n", filename);
+    }
+
+    free(index);
+    free(records);
+    free(w);
+    free(tempPath);
+    return result;
+}
+
+
+// ---- reading ----
+
+static void unmap_file(const void* base, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(base);
+#else
+    munmap((void*)base, size);
+#endif
+}
+
+
+// Map a whole file read-only. return the base address and its size, or NULL.
+static const unsigned char* map_file(const char* filename, size_t* sizeOut) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+    LARGE_INTEGER size;
+    const unsigned char* base = NULL;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && (unsigned long long)size.QuadPart <= (size_t)-1) {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping) {
+            base = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);  // the view keeps the mapping alive
+        }
+        *sizeOut = (size_t)size.QuadPart;
+    }
+    CloseHandle(file);
+    return base;
+#else
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    void* base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        *sizeOut = (size_t)st.st_size;
+    }
+    close(fd);  // the mapping keeps the file alive
+    return base == MAP_FAILED ? NULL : (const unsigned char*)base;
+#endif
+}
+
+
+// Whether [offset, offset + length) lies inside a space of size bytes, without overflow
+static int in_range(uint64_t offset, uint64_t length, uint64_t size) {
+    return offset <= size && length <= size - offset;
+}
+
+
+// Open a binary snapshot for reading
+ConfigSnapshot* open_config_snapshot(const char* filename) {
+    if (!filename) {
+        return NULL;
+    }
+    size_t size = 0;
+    const unsigned char* base = map_file(filename, &size);
+    if (!base) {
+        printf("Error opening file: %s\n", filename);
+        return NULL;
+    }
+
+    SnapshotHeader header;
+    int valid = size >= sizeof(header);
+    if (valid) {
+        memcpy(&header, base, sizeof(header));
+        uint64_t capacity = header.indexCapacity;
+        valid = memcmp(header.magic, SNAPSHOT_MAGIC, 4) == 0
+            && header.version == SNAPSHOT_VERSION
+            && header.byteOrder == SNAPSHOT_BYTE_ORDER
+            && header.recordSize == sizeof(SnapshotRecord)
+            && header.fileSize == size
+            && capacity > 0 && (capacity & (capacity - 1)) == 0 && capacity > header.recordCount
+            && header.indexOffset % 8 == 0 && header.recordsOffset % 8 == 0 && header.heapOffset % 8 == 0
+            && capacity <= size / sizeof(SnapshotSlot) && header.recordCount <= size / sizeof(SnapshotRecord)
+            && in_range(header.indexOffset, capacity * sizeof(SnapshotSlot), size)
+            && in_range(header.recordsOffset, header.recordCount * sizeof(SnapshotRecord), size)
+            && in_range(header.heapOffset, header.heapSize, size);
+    }
+    ConfigSnapshot* snapshot = valid ? (ConfigSnapshot*)malloc(sizeof(ConfigSnapshot)) : NULL;
+    if (!snapshot) {
+        if (!valid) {
+            printf("Error: %s is not a configuration snapshot.\n", filename);
+        }
+        unmap_file(base, size);
+        return NULL;
+    }
+
+    snapshot->base = base;
+    snapshot->size = size;
+    snapshot->index = (const SnapshotSlot*)(base + header.indexOffset);
+    snapshot->indexCapacity = header.indexCapacity;
+    snapshot->records = (const SnapshotRecord*)(base + header.recordsOffset);
+    snapshot->recordCount = header.recordCount;
+    snapshot->heap = (const char*)(base + header.heapOffset);
+    snapshot->heapSize = header.heapSize;
+    return snapshot;
+}
+
+
+// NUL-terminated string at a heap offset, NULL if it runs off the heap
+static const char* heap_string(const ConfigSnapshot* s, uint64_t offset) {
+    if (offset >= s->heapSize) {
+        return NULL;
+    }
+    return memchr(s->heap + offset, '\0', (size_t)(s->heapSize - offset)) ? s->heap + offset : NULL;
+}
+
+
+static const SnapshotRecord* find_snapshot_record(const ConfigSnapshot* s, const char* key) {
+    uint32_t hash = config_hash_key(key);
+    uint64_t mask = s->indexCapacity - 1;
+    uint64_t slot = hash & mask;
+    for (uint64_t probes = 0; probes < s->indexCapacity; ++probes, slot = (slot + 1) & mask) {
+        const SnapshotSlot* entry = &s->index[slot];
+        if (entry->record == 0) {
+            return NULL;
+        }
+        if (entry->keyHash != hash || entry->record > s->recordCount) {
+            continue;
+        }
+        const SnapshotRecord* record = &s->records[entry->record - 1];
+        const char* storedKey = heap_string(s, record->key);
+        if (storedKey && strcmp(storedKey, key) == 0) {
+            return record;
+        }
+    }
+    return NULL;
+}
+
+
+// Read the value of r into valueOut, the way fetch_snapshot_value hands it out
+static int read_snapshot_value(const ConfigSnapshot* snapshot, const SnapshotRecord* r, void* valueOut) {
+    uint32_t bits = (uint32_t)r->value;
+    switch (r->type) {
+    case INT:
+        memcpy(valueOut, &bits, sizeof(int));
+        return 0;
+    case FLOAT:
+        memcpy(valueOut, &bits, sizeof(float));
+        return 0;
+    case STRING: {
+        const char* str = heap_string(snapshot, r->value);
+        if (!str) return -1;
+        *(const char**)valueOut = str;
+        return 0;
+    }
+    case INT_ARRAY:
+    case FLOAT_ARRAY:
+        if (r->arraySize > snapshot->heapSize / 4 || !in_range(r->value, r->arraySize * 4, snapshot->heapSize)) {
+            return -1;
+        }
+        memcpy(valueOut, snapshot->heap + r->value, (size_t)r->arraySize * 4);
+        return 0;
+    case STRING_ARRAY: {
+        if (r->arraySize > snapshot->heapSize / 8 || !in_range(r->value, r->arraySize * 8, snapshot->heapSize)) {
+            return -1;
+        }
+        const char** out = (const char**)valueOut;
+        for (uint64_t i = 0; i < r->arraySize; ++i) {
+            uint64_t offset;
+            memcpy(&offset, snapshot->heap + r->value + i * 8, 8);
+            out[i] = heap_string(snapshot, offset);
+            if (!out[i]) return -1;
+        }
+        return 0;
+    }
+    default:
+        return -1;
+    }
+}
+
+
+// Fetch a value from a snapshot
+int fetch_snapshot_value(const ConfigSnapshot* snapshot, const char* key, void* valueOut, ValueType expectedType) {
+    if (!snapshot || !key || !valueOut) {
+        return -1;
+    }
+
+    const SnapshotRecord* r = find_snapshot_record(snapshot, key);
+    if (!r) {
+        printf("Key '%s' not found.\n", key);
+        return -1;
+    }
+    if (r->type != (uint32_t)expectedType) {
+        printf("Type mismatch: Expected type does not match stored type for key '%s'.\n", key);
+        return -1;
+    }
+    return read_snapshot_value(snapshot, r, valueOut);
+}
+
+
+// Number of elements of an array value, 0 for scalars
+int config_snapshot_array_size(const ConfigSnapshot* snapshot, const char* key, size_t* sizeOut) {
+    if (!snapshot || !key || !sizeOut) {
+        return -1;
+    }
+    const SnapshotRecord* r = find_snapshot_record(snapshot, key);
+    if (!r) {
+        return -1;
+    }
+    *sizeOut = (size_t)r->arraySize;
+    return 0;
+}
+
+
+// Unmap a snapshot
+void close_config_snapshot(ConfigSnapshot* snapshot) {
+    if (!snapshot) {
+        return;
+    }
+    unmap_file(snapshot->base, snapshot->size);
+    free(snapshot);
+}
+
+
+// Copy every record of a snapshot file into cm (the snapshot codec's load)
+int config_load_snapshot(ConfigManager* cm, const char* filename) {
+    if (!cm || !filename) {
+        return -1;
+    }
+    ConfigSnapshot* snapshot = open_config_snapshot(filename);
+    if (!snapshot) {
+        return -1;
+    }
+
+    // large enough for any array in the heap, a STRING_ARRAY needs 8 bytes per element
+    void* buffer = malloc(snapshot->heapSize + sizeof(uint64_t));
+    if (!buffer) {
+        close_config_snapshot(snapshot);
+        return -1;
+    }
+
+    int bulk = begin_config_bulk_load(cm) == 0;
+    size_t mark = cm->size;
+    int result = 0;
+    for (uint64_t i = 0; i < snapshot->recordCount && result == 0; ++i) {
+        const SnapshotRecord* r = &snapshot->records[i];
+        const char* key = heap_string(snapshot, r->key);
+        if (!key || r->type > STRING_ARRAY || read_snapshot_value(snapshot, r, buffer) != 0) {
+            printf("Error: damaged record in snapshot %s\n", filename);
+            result = -1;
+            break;
+        }
+        void* value = r->type == STRING ? *(void**)buffer : buffer;
+        KeyValuePair kv = create_key_value_pair(key, value, (ValueType)r->type, (size_t)r->arraySize);
+        if (!kv.key) {
+            result = -1;
+            break;
+        }
+        config_put_record(cm, &kv);
+    }
+    if (result != 0) {
+        while (cm->size > mark) free_key_value_pair(&cm->records[--cm->size]);
+    }
+    if (bulk && end_config_bulk_load(cm) != 0) {
+        result = -1;
+    }
+
+    free(buffer);
+    close_config_snapshot(snapshot);
+    return result;
+}
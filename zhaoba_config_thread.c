@@ -0,0 +1,135 @@
+#include "zhaoba_config_internal.h"
+#include "zhaoba_config_thread.h"
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// heap-allocated start record so both platforms can use the same void fn(void*) signature
+typedef struct ThreadStart {
+    config_thread_fn fn;
+    void* arg;
+} ThreadStart;
+
+#ifdef _WIN32
+
+static DWORD WINAPI thread_trampoline(LPVOID param) {
+    ThreadStart start = *(ThreadStart*)param;
+    free(param);
+    start.fn(start.arg);
+    return 0;
+}
+
+int config_thread_create(config_thread_t* thread, config_thread_fn fn, void* arg) {
+    ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (!start) {
+        return -1;
+    }
+    start->fn = fn;
+    start->arg = arg;
+
+    *thread = CreateThread(NULL, 0, thread_trampoline, start, 0, NULL);
+    if (!*thread) {
+        free(start);
+        return -1;
+    }
+    return 0;
+}
+
+void config_thread_join(config_thread_t thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+void config_thread_detach(config_thread_t thread) {
+    CloseHandle(thread);
+}
+
+void config_mutex_init(config_mutex_t* mutex) { InitializeSRWLock(mutex); }
+void config_mutex_destroy(config_mutex_t* mutex) { (void)mutex; }
+void config_mutex_lock(config_mutex_t* mutex) { AcquireSRWLockExclusive(mutex); }
+void config_mutex_unlock(config_mutex_t* mutex) { ReleaseSRWLockExclusive(mutex); }
+
+void config_cond_init(config_cond_t* cond) { InitializeConditionVariable(cond); }
+void config_cond_destroy(config_cond_t* cond) { (void)cond; }
+void config_cond_wait(config_cond_t* cond, config_mutex_t* mutex) { SleepConditionVariableSRW(cond, mutex, INFINITE, 0); }
+void config_cond_signal(config_cond_t* cond) { WakeConditionVariable(cond); }
+void config_cond_broadcast(config_cond_t* cond) { WakeAllConditionVariable(cond); }
+
+int config_cond_timedwait(config_cond_t* cond, config_mutex_t* mutex, unsigned int milliseconds) {
+    if (!SleepConditionVariableSRW(cond, mutex, milliseconds, 0)) {
+        return GetLastError() == ERROR_TIMEOUT ? 1 : 0;
+    }
+    return 0;
+}
+
+unsigned int config_cpu_count(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (unsigned int)info.dwNumberOfProcessors : 1;
+}
+
+#else
+
+static void* thread_trampoline(void* param) {
+    ThreadStart start = *(ThreadStart*)param;
+    free(param);
+    start.fn(start.arg);
+    return NULL;
+}
+
+int config_thread_create(config_thread_t* thread, config_thread_fn fn, void* arg) {
+    ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (!start) {
+        return -1;
+    }
+    start->fn = fn;
+    start->arg = arg;
+
+    if (pthread_create(thread, NULL, thread_trampoline, start) != 0) {
+        free(start);
+        return -1;
+    }
+    return 0;
+}
+
+void config_thread_join(config_thread_t thread) {
+    pthread_join(thread, NULL);
+}
+
+void config_thread_detach(config_thread_t thread) {
+    pthread_detach(thread);
+}
+
+void config_mutex_init(config_mutex_t* mutex) { pthread_mutex_init(mutex, NULL); }
+void config_mutex_destroy(config_mutex_t* mutex) { pthread_mutex_destroy(mutex); }
+void config_mutex_lock(config_mutex_t* mutex) { pthread_mutex_lock(mutex); }
+void config_mutex_unlock(config_mutex_t* mutex) { pthread_mutex_unlock(mutex); }
+
+void config_cond_init(config_cond_t* cond) { pthread_cond_init(cond, NULL); }
+void config_cond_destroy(config_cond_t* cond) { pthread_cond_destroy(cond); }
+void config_cond_wait(config_cond_t* cond, config_mutex_t* mutex) { pthread_cond_wait(cond, mutex); }
+void config_cond_signal(config_cond_t* cond) { pthread_cond_signal(cond); }
+void config_cond_broadcast(config_cond_t* cond) { pthread_cond_broadcast(cond); }
+
+int config_cond_timedwait(config_cond_t* cond, config_mutex_t* mutex, unsigned int milliseconds) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += milliseconds / 1000;
+    deadline.tv_nsec += (long)(milliseconds % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return pthread_cond_timedwait(cond, mutex, &deadline) == ETIMEDOUT ? 1 : 0;
+}
+
+unsigned int config_cpu_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (unsigned int)count : 1;
+}
+
+#endif
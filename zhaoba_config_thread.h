@@ -0,0 +1,49 @@
+#ifndef zhaoba_CONFIG_THREAD_H
+#define zhaoba_CONFIG_THREAD_H
+
+// Thin wrappers over Win32 threads and pthreads used by the parallel and background features.
+
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE config_thread_t;
+typedef SRWLOCK config_mutex_t;
+typedef CONDITION_VARIABLE config_cond_t;
+#define CONFIG_MUTEX_INITIALIZER SRWLOCK_INIT
+#define CONFIG_COND_INITIALIZER CONDITION_VARIABLE_INIT
+#else
+#include <pthread.h>
+typedef pthread_t config_thread_t;
+typedef pthread_mutex_t config_mutex_t;
+typedef pthread_cond_t config_cond_t;
+#define CONFIG_MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#define CONFIG_COND_INITIALIZER PTHREAD_COND_INITIALIZER
+#endif
+
+typedef void (*config_thread_fn)(void* arg);
+
+// Start fn(arg) on a new thread. return 0 on success, -1 on failure.
+int config_thread_create(config_thread_t* thread, config_thread_fn fn, void* arg);
+
+// Wait for a thread started by config_thread_create to finish.
+void config_thread_join(config_thread_t thread);
+
+// Let a thread started by config_thread_create clean up on its own when it finishes; it cannot be joined afterwards.
+void config_thread_detach(config_thread_t thread);
+
+void config_mutex_init(config_mutex_t* mutex);
+void config_mutex_destroy(config_mutex_t* mutex);
+void config_mutex_lock(config_mutex_t* mutex);
+void config_mutex_unlock(config_mutex_t* mutex);
+
+void config_cond_init(config_cond_t* cond);
+void config_cond_destroy(config_cond_t* cond);
+void config_cond_wait(config_cond_t* cond, config_mutex_t* mutex);
+// return 0 when signalled, 1 when the timeout elapsed first
+int config_cond_timedwait(config_cond_t* cond, config_mutex_t* mutex, unsigned int milliseconds);
+void config_cond_signal(config_cond_t* cond);
+void config_cond_broadcast(config_cond_t* cond);
+
+// Number of online processors, at least 1
+unsigned int config_cpu_count(void);
+
+#endif // zhaoba_CONFIG_THREAD_H
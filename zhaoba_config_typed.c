@@ -0,0 +1,163 @@
+#include "zhaoba_config_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Typed accessors: one function per ValueType, so a call site names its type at compile time.
+//
+// fetch_value_by_key and store_value_by_key take a void* and switch on the ValueType at run time, and
+// report a missing key or a type mismatch with printf. The functions here look the key up once and touch
+// the one union member of their type; a miss or mismatch is only the -1 return, which hot loops and
+// optional settings can test for free. Getters of strings and arrays return views of the stored value
+// instead of copies, valid until the key is next stored, deleted or reloaded.
+
+
+// Record of key when it holds type, NULL otherwise
+static KeyValuePair* typed_record(ConfigManager* cm, const char* key, ValueType type) {
+    if (!cm || !key) {
+        return NULL;
+    }
+    size_t i = find_record_index(cm, key);
+    if (i == CONFIG_NPOS || cm->records[i].type != type) {
+        return NULL;
+    }
+    return &cm->records[i];
+}
+
+
+int config_get_int(ConfigManager* cm, const char* key, int* valueOut) {
+    KeyValuePair* kv = typed_record(cm, key, INT);
+    if (!kv || !valueOut) {
+        return -1;
+    }
+    *valueOut = kv->value.intValue;
+    return 0;
+}
+
+
+int config_get_float(ConfigManager* cm, const char* key, float* valueOut) {
+    KeyValuePair* kv = typed_record(cm, key, FLOAT);
+    if (!kv || !valueOut) {
+        return -1;
+    }
+    *valueOut = kv->value.floatValue;
+    return 0;
+}
+
+
+int config_get_string(ConfigManager* cm, const char* key, const char** valueOut) {
+    KeyValuePair* kv = typed_record(cm, key, STRING);
+    if (!kv || !valueOut) {
+        return -1;
+    }
+    *valueOut = kv->value.stringValue;
+    return 0;
+}
+
+
+int config_get_int_view(ConfigManager* cm, const char* key, const int** valuesOut, size_t* countOut) {
+    KeyValuePair* kv = typed_record(cm, key, INT_ARRAY);
+    if (!kv || !valuesOut || !countOut) {
+        return -1;
+    }
+    *valuesOut = kv->value.intArrayValue;
+    *countOut = kv->arraySize;
+    return 0;
+}
+
+
+int config_get_float_view(ConfigManager* cm, const char* key, const float** valuesOut, size_t* countOut) {
+    KeyValuePair* kv = typed_record(cm, key, FLOAT_ARRAY);
+    if (!kv || !valuesOut || !countOut) {
+        return -1;
+    }
+    *valuesOut = kv->value.floatArrayValue;
+    *countOut = kv->arraySize;
+    return 0;
+}
+
+
+int config_get_string_view(ConfigManager* cm, const char* key, const char* const** valuesOut, size_t* countOut) {
+    KeyValuePair* kv = typed_record(cm, key, STRING_ARRAY);
+    if (!kv || !valuesOut || !countOut) {
+        return -1;
+    }
+    *valuesOut = (const char* const*)kv->value.stringArrayValue;
+    *countOut = kv->arraySize;
+    return 0;
+}
+
+
+// Position of key for a store of type: the record to update in place, CONFIG_NPOS to append.
+// return -1 (quietly) when key holds another type.
+static int store_position(ConfigManager* cm, const char* key, ValueType type, size_t* posOut) {
+    *posOut = cm->bulkMode ? CONFIG_NPOS : find_record_index(cm, key);
+    return *posOut != CONFIG_NPOS && cm->records[*posOut].type != type ? -1 : 0;
+}
+
+// Store a scalar: assigned in place when the key exists, appended otherwise
+static int set_scalar(ConfigManager* cm, const char* key, ValueType type, Value value) {
+    size_t pos;
+    if (!cm || !key || store_position(cm, key, type, &pos) != 0) {
+        return -1;
+    }
+    if (pos != CONFIG_NPOS) {
+        KeyValuePair* record = &cm->records[pos];
+        record->value = value;
+        record->valueHash = config_hash_value(record);
+        config_record_dirty(record);
+        record->changeStamp = cm->changeCount + 1;
+        return config_notify(cm, record->key, CONFIG_KEY_CHANGED);
+    }
+    KeyValuePair kv = create_key_value_pair(key, &value, type, 0);
+    return kv.key ? config_put_record(cm, &kv) : -1;
+}
+
+// Store a copy of a string or array value, replacing the stored one
+static int set_copy(ConfigManager* cm, const char* key, ValueType type, const void* value, size_t count) {
+    size_t pos;
+    if (!cm || !key || !value || store_position(cm, key, type, &pos) != 0) {
+        return -1;
+    }
+    KeyValuePair kv = create_key_value_pair(key, (void*)value, type, count);
+    if (!kv.key) {
+        return -1;
+    }
+    if (pos != CONFIG_NPOS) {
+        return config_replace_record(cm, pos, &kv);
+    }
+    return config_put_record(cm, &kv);
+}
+
+
+int config_set_int(ConfigManager* cm, const char* key, int value) {
+    Value v;
+    v.intValue = value;
+    return set_scalar(cm, key, INT, v);
+}
+
+
+int config_set_float(ConfigManager* cm, const char* key, float value) {
+    Value v;
+    v.floatValue = value;
+    return set_scalar(cm, key, FLOAT, v);
+}
+
+
+int config_set_string(ConfigManager* cm, const char* key, const char* value) {
+    return set_copy(cm, key, STRING, value, 0);
+}
+
+
+int config_set_ints(ConfigManager* cm, const char* key, const int* values, size_t count) {
+    return set_copy(cm, key, INT_ARRAY, values, count);
+}
+
+
+int config_set_floats(ConfigManager* cm, const char* key, const float* values, size_t count) {
+    return set_copy(cm, key, FLOAT_ARRAY, values, count);
+}
+
+
+int config_set_strings(ConfigManager* cm, const char* key, const char* const* values, size_t count) {
+    return set_copy(cm, key, STRING_ARRAY, values, count);
+}
@@ -0,0 +1,362 @@
+#include "zhaoba_config_internal.h"
+#include "zhaoba_config_thread.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// One published configuration. Readers pin it through refCount, so a version that has been
+// replaced stays alive until the last reader releases it.
+typedef struct ConfigVersion {
+    ConfigManager* cm;
+    size_t refCount;
+    unsigned long number;
+    struct ConfigVersion* next;  // retired versions still pinned by readers
+} ConfigVersion;
+
+// Watches one file and publishes a freshly loaded ConfigManager after every settled change.
+//
+// lock only guards the version pointers and reference counts, never a load,
+// so acquire/release on serving threads cost one short critical section.
+struct ConfigWatcher {
+    char* filename;
+    unsigned int debounceMs;
+    config_mutex_t lock;
+    ConfigVersion* current;
+    ConfigVersion* retired;
+    config_thread_t thread;
+    volatile int stopping;
+#ifdef __linux__
+    int inotifyFd;
+    int stopPipe[2];
+#else
+    config_cond_t stopCond;
+#endif
+};
+
+
+static ConfigVersion* load_version(const char* filename, unsigned long number) {
+    ConfigManager* cm = create_config_manager();
+    if (!cm) {
+        return NULL;
+    }
+    if (load_config_from_file(cm, filename) != 0) {
+        free_config_manager(cm);
+        return NULL;
+    }
+
+    ConfigVersion* version = (ConfigVersion*)malloc(sizeof(ConfigVersion));
+    if (!version) {
+        free_config_manager(cm);
+        return NULL;
+    }
+    version->cm = cm;
+    version->refCount = 0;
+    version->number = number;
+    version->next = NULL;
+    return version;
+}
+
+
+// Load the file into a new manager off the lock, then swap it in
+static void reload_and_publish(ConfigWatcher* w) {
+    config_mutex_lock(&w->lock);
+    unsigned long number = w->current->number + 1;
+    config_mutex_unlock(&w->lock);
+
+    ConfigVersion* version = load_version(w->filename, number);
+    if (!version) {
+        printf("Reload of %s failed, keeping the current configuration.\n", w->filename);
+        return;
+    }
+
+    ConfigVersion* old = NULL;
+    config_mutex_lock(&w->lock);
+    old = w->current;
+    w->current = version;
+    if (old->refCount > 0) {
+        old->next = w->retired;
+        w->retired = old;
+        old = NULL;
+    }
+    config_mutex_unlock(&w->lock);
+
+    if (old) {
+        free_config_manager(old->cm);
+        free(old);
+    }
+}
+
+
+#ifdef __linux__
+
+static const char* base_name(const char* path) {
+    const char* slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+// Editors save through write-in-place, truncate-and-write or write-temp-then-rename,
+// so watch the directory for every event that can leave a new file under our name.
+static void watch_thread(void* arg) {
+    ConfigWatcher* w = (ConfigWatcher*)arg;
+    const char* name = base_name(w->filename);
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int pending = 0;
+
+    while (!w->stopping) {
+        struct pollfd fds[2];
+        fds[0].fd = w->inotifyFd;
+        fds[0].events = POLLIN;
+        fds[1].fd = w->stopPipe[0];
+        fds[1].events = POLLIN;
+
+        int ready = poll(fds, 2, pending ? (int)w->debounceMs : -1);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+        if (ready == 0) {
+            // quiet for a whole debounce window after the last event
+            pending = 0;
+            reload_and_publish(w);
+            continue;
+        }
+
+        ssize_t length = read(w->inotifyFd, buffer, sizeof(buffer));
+        for (char* p = buffer; length > 0 && p < buffer + length; ) {
+            const struct inotify_event* event = (const struct inotify_event*)p;
+            if (event->len > 0 && strcmp(event->name, name) == 0) {
+                pending = 1;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+}
+
+static int start_watching(ConfigWatcher* w) {
+    char* dir = _strdup(w->filename);
+    if (!dir) {
+        return -1;
+    }
+    char* slash = strrchr(dir, '/');
+    if (slash == dir) {
+        slash[1] = '\0';
+    }
+    else if (slash) {
+        *slash = '\0';
+    }
+    else {
+        strcpy(dir, ".");
+    }
+
+    w->inotifyFd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    int ok = w->inotifyFd >= 0
+        && inotify_add_watch(w->inotifyFd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_MODIFY) >= 0
+        && pipe(w->stopPipe) == 0;
+    free(dir);
+    if (!ok) {
+        printf("Error watching file: %s\n", w->filename);
+        if (w->inotifyFd >= 0) close(w->inotifyFd);
+        return -1;
+    }
+    return 0;
+}
+
+static void stop_watching(ConfigWatcher* w) {
+    w->stopping = 1;
+    if (write(w->stopPipe[1], "x", 1) < 0) {
+        // the flag alone still stops the thread at its next wake-up
+    }
+    config_thread_join(w->thread);
+    close(w->stopPipe[0]);
+    close(w->stopPipe[1]);
+    close(w->inotifyFd);
+}
+
+#else
+
+// Without inotify, poll the file stamp (size, modification time to the nanosecond or 100ns, file id)
+// once per debounce window, and reload only after it has stayed the same for a full window.
+static int same_stamp(const ConfigFileStamp* a, const ConfigFileStamp* b) {
+    return a->exists == b->exists && (!a->exists || config_file_stamp_equal(a, b));
+}
+
+static void watch_thread(void* arg) {
+    ConfigWatcher* w = (ConfigWatcher*)arg;
+    ConfigFileStamp stamp, seen;
+    config_file_stamp(w->filename, &seen);
+    int pending = 0;
+
+    config_mutex_lock(&w->lock);
+    while (!w->stopping) {
+        config_cond_timedwait(&w->stopCond, &w->lock, w->debounceMs);
+        if (w->stopping) break;
+        config_mutex_unlock(&w->lock);
+
+        config_file_stamp(w->filename, &stamp);
+        if (!same_stamp(&stamp, &seen)) {
+            seen = stamp;
+            pending = 1;
+        }
+        else if (pending && stamp.exists) {
+            pending = 0;
+            reload_and_publish(w);
+        }
+
+        config_mutex_lock(&w->lock);
+    }
+    config_mutex_unlock(&w->lock);
+}
+
+static int start_watching(ConfigWatcher* w) {
+    config_cond_init(&w->stopCond);
+    return 0;
+}
+
+static void stop_watching(ConfigWatcher* w) {
+    config_mutex_lock(&w->lock);
+    w->stopping = 1;
+    config_cond_signal(&w->stopCond);
+    config_mutex_unlock(&w->lock);
+    config_thread_join(w->thread);
+    config_cond_destroy(&w->stopCond);
+}
+
+#endif
+
+
+// Create a watcher that keeps a published copy of filename up to date
+ConfigWatcher* create_config_watcher(const char* filename, unsigned int debounceMs) {
+    if (!filename) {
+        return NULL;
+    }
+
+    ConfigWatcher* w = (ConfigWatcher*)calloc(1, sizeof(ConfigWatcher));
+    if (!w) {
+        printf("Memory allocation for ConfigWatcher failed.\n");
+        return NULL;
+    }
+    w->filename = _strdup(filename);
+    w->debounceMs = debounceMs > 0 ? debounceMs : 100;
+    w->current = w->filename ? load_version(filename, 1) : NULL;
+    if (!w->current) {
+        free(w->filename);
+        free(w);
+        return NULL;
+    }
+    config_mutex_init(&w->lock);
+
+    if (start_watching(w) != 0) {
+        config_mutex_destroy(&w->lock);
+        free_config_manager(w->current->cm);
+        free(w->current);
+        free(w->filename);
+        free(w);
+        return NULL;
+    }
+    if (config_thread_create(&w->thread, watch_thread, w) != 0) {
+        printf("Error starting watcher thread for %s\n", filename);
+        w->stopping = 1;
+#ifdef __linux__
+        close(w->stopPipe[0]);
+        close(w->stopPipe[1]);
+        close(w->inotifyFd);
+#else
+        config_cond_destroy(&w->stopCond);
+#endif
+        config_mutex_destroy(&w->lock);
+        free_config_manager(w->current->cm);
+        free(w->current);
+        free(w->filename);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+
+// Pin and return the current configuration
+ConfigManager* config_watcher_acquire(ConfigWatcher* w) {
+    if (!w) {
+        return NULL;
+    }
+    config_mutex_lock(&w->lock);
+    ConfigVersion* version = w->current;
+    version->refCount++;
+    config_mutex_unlock(&w->lock);
+    return version->cm;
+}
+
+
+// Unpin a configuration returned by config_watcher_acquire
+void config_watcher_release(ConfigWatcher* w, ConfigManager* cm) {
+    if (!w || !cm) {
+        return;
+    }
+
+    ConfigVersion* unused = NULL;
+    config_mutex_lock(&w->lock);
+    if (w->current->cm == cm) {
+        w->current->refCount--;
+    }
+    else {
+        for (ConfigVersion** link = &w->retired; *link; link = &(*link)->next) {
+            if ((*link)->cm == cm) {
+                if (--(*link)->refCount == 0) {
+                    unused = *link;
+                    *link = unused->next;
+                }
+                break;
+            }
+        }
+    }
+    config_mutex_unlock(&w->lock);
+
+    if (unused) {
+        free_config_manager(unused->cm);
+        free(unused);
+    }
+}
+
+
+// Number of the currently published version, starting at 1 and increasing with every reload
+unsigned long config_watcher_version(ConfigWatcher* w) {
+    if (!w) {
+        return 0;
+    }
+    config_mutex_lock(&w->lock);
+    unsigned long number = w->current->number;
+    config_mutex_unlock(&w->lock);
+    return number;
+}
+
+
+// Stop watching and free every version
+void free_config_watcher(ConfigWatcher* w) {
+    if (!w) {
+        return;
+    }
+    stop_watching(w);
+
+    while (w->retired) {
+        ConfigVersion* next = w->retired->next;
+        free_config_manager(w->retired->cm);
+        free(w->retired);
+        w->retired = next;
+    }
+    free_config_manager(w->current->cm);
+    free(w->current);
+    config_mutex_destroy(&w->lock);
+    free(w->filename);
+    free(w);
+}
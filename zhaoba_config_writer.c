@@ -0,0 +1,451 @@
+#include "zhaoba_config_internal.h"
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Streaming JSON serializer for ConfigManager.
+//
+// By default produces exactly the bytes cJSON_Print would for the tree save_config_to_file used to build,
+// and with CONFIG_SAVE_MINIFIED those of cJSON_PrintUnformatted, but writes them straight from
+// cm->records through one fixed-size buffer. Numbers keep the classic %1.15g/%1.17g text so default files
+// stay byte-compatible with earlier ones, although cJSON's print_number now uses config_format_double.
+// CONFIG_SAVE_SHORTEST_FLOATS switches FLOAT values to config_format_float, the only flag that changes
+// number text.
+//
+// Each record's bytes are kept in KeyValuePair.rendered, so a save after a few changes only renders
+// the dirty records and copies the rest. CONFIG_SAVE_PARALLEL spreads that rendering over worker threads.
+
+
+void config_writer_init(ConfigWriter* w, ConfigWriteCallback write, void* context, unsigned int flags) {
+    w->flags = flags;
+    w->write = write;
+    w->context = context;
+    w->used = 0;
+    w->failed = 0;
+}
+
+
+int config_writer_flush(ConfigWriter* w) {
+    if (w->used > 0 && !w->failed) {
+        if (w->write(w->context, w->buffer, w->used) != 0) {
+            w->failed = 1;
+        }
+    }
+    w->used = 0;
+    return w->failed ? -1 : 0;
+}
+
+
+void config_writer_put(ConfigWriter* w, const char* data, size_t length) {
+    if (length > sizeof(w->buffer) - w->used) {
+        config_writer_flush(w);
+        if (length >= sizeof(w->buffer)) {
+            // larger than the whole buffer, hand it over directly
+            if (!w->failed && w->write(w->context, data, length) != 0) {
+                w->failed = 1;
+            }
+            return;
+        }
+    }
+    memcpy(w->buffer + w->used, data, length);
+    w->used += length;
+}
+
+
+static void writer_putc(ConfigWriter* w, char c) {
+    if (w->used == sizeof(w->buffer)) {
+        config_writer_flush(w);
+    }
+    w->buffer[w->used++] = c;
+}
+
+
+// JSON string with the same escapes as cJSON's print_string_ptr
+void config_write_string(ConfigWriter* w, const char* str) {
+    writer_putc(w, '"');
+    if (str) {
+        const unsigned char* run = (const unsigned char*)str;
+        const unsigned char* p = run;
+        for (; *p; ++p) {
+            if (*p > 31 && *p != '"' && *p != '\\') {
+                continue;
+            }
+
+            config_writer_put(w, (const char*)run, (size_t)(p - run));
+            char escape[8];
+            switch (*p) {
+            case '\\': config_writer_put(w, "\\\\", 2); break;
+            case '"':  config_writer_put(w, "\\\"", 2); break;
+            case '\b': config_writer_put(w, "\\b", 2); break;
+            case '\f': config_writer_put(w, "\\f", 2); break;
+            case '\n': config_writer_put(w, "\\n", 2); break;
+            case '\r': config_writer_put(w, "\\r", 2); break;
+            case '\t': config_writer_put(w, "\\t", 2); break;
+            default:
+                sprintf(escape, "\\u%04x", *p);
+                config_writer_put(w, escape, 6);
+                break;
+            }
+            run = p + 1;
+        }
+        config_writer_put(w, (const char*)run, (size_t)(p - run));
+    }
+    writer_putc(w, '"');
+}
+
+
+static int doubles_equal(double a, double b) {
+    double maxVal = fabs(a) > fabs(b) ? fabs(a) : fabs(b);
+    return fabs(a - b) <= maxVal * DBL_EPSILON;
+}
+
+// Number text as cJSON's print_number rendered it before config_format_double
+void config_write_number(ConfigWriter* w, double d) {
+    char number[32];
+    int length;
+
+    if (isnan(d) || isinf(d)) {
+        length = sprintf(number, "null");
+    }
+    else {
+        int valueint = d >= INT_MAX ? INT_MAX : (d <= (double)INT_MIN ? INT_MIN : (int)d);
+        if (d == (double)valueint) {
+            length = sprintf(number, "%d", valueint);
+        }
+        else {
+            double test = 0.0;
+            length = sprintf(number, "%1.15g", d);
+            if (sscanf(number, "%lg", &test) != 1 || !doubles_equal(test, d)) {
+                length = sprintf(number, "%1.17g", d);
+            }
+        }
+    }
+    config_writer_put(w, number, (size_t)length);
+}
+
+
+void config_write_float(ConfigWriter* w, float value) {
+    if (!(w->flags & CONFIG_SAVE_SHORTEST_FLOATS)) {
+        config_write_number(w, value);
+        return;
+    }
+    char number[CONFIG_NUMBER_BUFFER_SIZE];
+    int length = config_format_float(value, number);
+    config_writer_put(w, number, (size_t)length);
+}
+
+
+static const char* type_name(ValueType type) {
+    switch (type) {
+    case INT: return "INT";
+    case FLOAT: return "FLOAT";
+    case STRING: return "STRING";
+    case INT_ARRAY: return "INT_ARRAY";
+    case FLOAT_ARRAY: return "FLOAT_ARRAY";
+    case STRING_ARRAY: return "STRING_ARRAY";
+    default: return NULL;
+    }
+}
+
+
+// Member separators for the pretty (cJSON_Print) and minified (cJSON_PrintUnformatted) layouts
+static const char* const prettyParts[] = { "{\n\t\t\"key\":\t", ",\n\t\t\"type\":\t", ",\n\t\t\"value\":\t", ",\n\t\t\"arraySize\":\t", "\n\t}", ", " };
+static const char* const minifiedParts[] = { "{\"key\":", ",\"type\":", ",\"value\":", ",\"arraySize\":", "}", "," };
+
+static void put_part(ConfigWriter* w, int part) {
+    const char* text = (w->flags & CONFIG_SAVE_MINIFIED) ? minifiedParts[part] : prettyParts[part];
+    config_writer_put(w, text, strlen(text));
+}
+
+
+// One record object, formatted for nesting inside the top-level array
+void config_write_record(ConfigWriter* w, const KeyValuePair* kv) {
+    put_part(w, 0);
+    config_write_string(w, kv->key);
+    put_part(w, 1);
+    config_write_string(w, type_name(kv->type));
+    put_part(w, 2);
+
+    switch (kv->type) {
+    case INT:
+        config_write_number(w, kv->value.intValue);
+        break;
+    case FLOAT:
+        config_write_float(w, kv->value.floatValue);
+        break;
+    case STRING:
+        config_write_string(w, kv->value.stringValue);
+        break;
+    case INT_ARRAY:
+    case FLOAT_ARRAY:
+    case STRING_ARRAY:
+        writer_putc(w, '[');
+        for (size_t j = 0; j < kv->arraySize; ++j) {
+            if (j > 0) {
+                put_part(w, 5);
+            }
+            if (kv->type == INT_ARRAY) {
+                config_write_number(w, kv->value.intArrayValue[j]);
+            }
+            else if (kv->type == FLOAT_ARRAY) {
+                config_write_float(w, kv->value.floatArrayValue[j]);
+            }
+            else {
+                config_write_string(w, kv->value.stringArrayValue[j]);
+            }
+        }
+        writer_putc(w, ']');
+        break;
+    default:
+        break;
+    }
+
+    if (!(w->flags & CONFIG_SAVE_OMIT_ARRAY_SIZE)) {
+        put_part(w, 3);
+        config_write_number(w, (double)kv->arraySize);
+    }
+    put_part(w, 4);
+}
+
+
+// Growable sink the scratch writer renders one record into
+typedef struct RenderBuffer {
+    char* data;
+    size_t used;
+    size_t capacity;
+} RenderBuffer;
+
+static int render_append(void* context, const char* data, size_t length) {
+    RenderBuffer* b = (RenderBuffer*)context;
+    if (b->used + length > b->capacity) {
+        size_t capacity = b->capacity ? b->capacity : 256;
+        while (capacity < b->used + length) {
+            capacity *= 2;
+        }
+        char* grown = (char*)realloc(b->data, capacity);
+        if (!grown) {
+            return -1;
+        }
+        b->data = grown;
+        b->capacity = capacity;
+    }
+    memcpy(b->data + b->used, data, length);
+    b->used += length;
+    return 0;
+}
+
+
+// Render a dirty record into kv->rendered. On allocation failure the record stays uncached.
+static void render_record(ConfigWriter* scratch, KeyValuePair* kv, unsigned int flags) {
+    RenderBuffer b = { NULL, 0, 0 };
+    config_writer_init(scratch, render_append, &b, flags);
+    config_write_record(scratch, kv);
+    if (config_writer_flush(scratch) != 0) {
+        free(b.data);
+        return;
+    }
+    char* exact = (char*)realloc(b.data, b.used);
+    free(kv->rendered);
+    kv->rendered = exact ? exact : b.data;
+    kv->renderedLength = b.used;
+    kv->renderedFlags = flags & CONFIG_SAVE_LAYOUT_MASK;
+}
+
+
+// One record, copied from its cache when the cache holds this layout
+void config_write_cached_record(ConfigWriter* w, KeyValuePair* kv, ConfigWriter** scratch) {
+    unsigned int layout = w->flags & CONFIG_SAVE_LAYOUT_MASK;
+    if (!kv->rendered || kv->renderedFlags != layout) {
+        if (!*scratch) {
+            *scratch = (ConfigWriter*)malloc(sizeof(ConfigWriter));
+        }
+        if (*scratch) {
+            render_record(*scratch, kv, w->flags);
+        }
+    }
+    if (kv->rendered && kv->renderedFlags == layout) {
+        config_writer_put(w, kv->rendered, kv->renderedLength);
+    }
+    else {
+        config_write_record(w, kv);
+    }
+}
+
+
+// Records [begin, end) of the store, each after a separator unless it is the first one.
+// *scratch is allocated on the first dirty record, the caller frees it.
+static void write_range(ConfigWriter* w, ConfigManager* cm, size_t begin, size_t end, ConfigWriter** scratch) {
+    for (size_t i = begin; i < end && !w->failed; ++i) {
+        if (i > 0) {
+            put_part(w, 5);
+        }
+        config_write_cached_record(w, &cm->records[i], scratch);
+    }
+}
+
+
+// CONFIG_SAVE_PARALLEL: the records are cut into one contiguous range per processor, never fewer than
+// PARALLEL_SAVE_MIN_RECORDS each, and every range is rendered into its own buffer on a worker thread.
+// A shard is exactly the bytes write_range would have produced for its range, so writing the buffers
+// in order gives the serial output. Each record belongs to one shard, the workers fill its cache unshared.
+#define PARALLEL_SAVE_MIN_RECORDS 16384
+
+typedef struct SaveShard {
+    ConfigManager* cm;
+    size_t begin;
+    size_t end;
+    unsigned int flags;
+    RenderBuffer out;
+    int failed;
+} SaveShard;
+
+static void render_shard(void* arg) {
+    SaveShard* shard = (SaveShard*)arg;
+    ConfigWriter* w = (ConfigWriter*)malloc(sizeof(ConfigWriter));
+    ConfigWriter* scratch = NULL;
+    if (!w) {
+        shard->failed = 1;
+        return;
+    }
+    config_writer_init(w, render_append, &shard->out, shard->flags);
+    write_range(w, shard->cm, shard->begin, shard->end, &scratch);
+    shard->failed = config_writer_flush(w) != 0;
+    free(scratch);
+    free(w);
+}
+
+
+// Write finished shard buffers in order. A file descriptor target gets them in a single gather write.
+static void emit_shards(ConfigWriter* w, const ConfigBytes* parts, size_t count) {
+    if (count == 0 || config_writer_flush(w) != 0) {
+        return;
+    }
+    if (w->write == config_fd_write) {
+        if (config_fd_writev(*(int*)w->context, parts, count) != 0) {
+            w->failed = 1;
+        }
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        config_writer_put(w, parts[i].data, parts[i].length);
+    }
+}
+
+
+// return 0 when written, -1 when the shards could not be set up (nothing written yet)
+static int write_shards(ConfigWriter* w, ConfigManager* cm, size_t shardCount) {
+    SaveShard* shards = (SaveShard*)calloc(shardCount, sizeof(SaveShard));
+    config_thread_t* threads = (config_thread_t*)calloc(shardCount, sizeof(config_thread_t));
+    int* started = (int*)calloc(shardCount, sizeof(int));
+    ConfigBytes* parts = (ConfigBytes*)calloc(shardCount, sizeof(ConfigBytes));
+    if (!shards || !threads || !started || !parts) {
+        free(shards);
+        free(threads);
+        free(started);
+        free(parts);
+        return -1;
+    }
+
+    for (size_t s = 0; s < shardCount; ++s) {
+        shards[s].cm = cm;
+        shards[s].begin = cm->size / shardCount * s;
+        shards[s].end = s + 1 < shardCount ? cm->size / shardCount * (s + 1) : cm->size;
+        shards[s].flags = w->flags;
+    }
+    for (size_t s = 1; s < shardCount; ++s) {
+        started[s] = config_thread_create(&threads[s], render_shard, &shards[s]) == 0;
+        if (!started[s]) {
+            render_shard(&shards[s]);
+        }
+    }
+    render_shard(&shards[0]);
+    for (size_t s = 1; s < shardCount; ++s) {
+        if (started[s]) {
+            config_thread_join(threads[s]);
+        }
+    }
+
+    // a shard that ran out of memory is written serially in its place
+    size_t pending = 0;
+    ConfigWriter* scratch = NULL;
+    for (size_t s = 0; s < shardCount; ++s) {
+        if (!shards[s].failed) {
+            parts[pending].data = shards[s].out.data;
+            parts[pending].length = shards[s].out.used;
+            ++pending;
+            continue;
+        }
+        emit_shards(w, parts, pending);
+        pending = 0;
+        write_range(w, cm, shards[s].begin, shards[s].end, &scratch);
+    }
+    emit_shards(w, parts, pending);
+
+    for (size_t s = 0; s < shardCount; ++s) {
+        free(shards[s].out.data);
+    }
+    free(scratch);
+    free(shards);
+    free(threads);
+    free(started);
+    free(parts);
+    return 0;
+}
+
+
+// The whole store as one top-level array
+int config_write_records(ConfigWriter* w, ConfigManager* cm) {
+    size_t shardCount = 1;
+    if (w->flags & CONFIG_SAVE_PARALLEL) {
+        size_t maxShards = cm->size / PARALLEL_SAVE_MIN_RECORDS;
+        shardCount = config_cpu_count();
+        if (shardCount > maxShards) {
+            shardCount = maxShards;
+        }
+    }
+
+    writer_putc(w, '[');
+    if (shardCount < 2 || write_shards(w, cm, shardCount) != 0) {
+        ConfigWriter* scratch = NULL;
+        write_range(w, cm, 0, cm->size, &scratch);
+        free(scratch);
+    }
+    writer_putc(w, ']');
+    return config_writer_flush(w);
+}
+
+
+// Save configuration data through a write callback
+int save_config_to_stream(ConfigManager* cm, ConfigWriteCallback write, void* context, unsigned int flags) {
+    if (!cm || !write || config_bulk_resolve(cm) != 0) {
+        return -1;
+    }
+
+    ConfigWriter* w = (ConfigWriter*)malloc(sizeof(ConfigWriter));
+    if (!w) {
+        printf("Memory allocation for writer failed.\n");
+        return -1;
+    }
+    ConfigCompressor* compressor = NULL;
+    if (flags & CONFIG_SAVE_COMPRESSED) {
+        compressor = config_compressor_create(write, context);
+        if (!compressor) {
+            free(w);
+            return -1;
+        }
+        write = config_compressor_write;
+        context = compressor;
+    }
+
+    config_writer_init(w, write, context, flags);
+    config_mutex_lock(&cm->saveLock);
+    int result = config_write_records(w, cm);
+    config_mutex_unlock(&cm->saveLock);
+    free(w);
+    if (compressor && config_compressor_finish(compressor) != 0) {
+        result = -1;
+    }
+    return result;
+}